@@ -21,7 +21,8 @@ SOURCES +=  main.cpp\
             absframe.cpp \
             container.cpp\
             gmaps.cpp \
-    trimprofile.cpp
+    trimprofile.cpp \
+    mavcodec.cpp
 
 HEADERS  += mainwindow.h\
             qcustomplot.h \
@@ -35,4 +36,5 @@ HEADERS  += mainwindow.h\
             absframe.h \
             container.h \
             gmaps.h \
-    trimprofile.h
+    trimprofile.h \
+    mavcodec.h
@@ -53,7 +53,11 @@ RANGE::RANGE() {
 
 RC_COM::RC_COM() {
     ROL = 0; PIT = 0; YAW = 0; THR = 1100;
+    AUX = 0; MODE = 0; FEC = false;
+    m_iSequence = 0;
     memset(m_cRadioCommand, 0, sizeof(m_cRadioCommand) );
+    memset(m_cRadioCommandV2, 0, sizeof(m_cRadioCommandV2) );
+    memset(m_cMAVLinkCommand, 0, sizeof(m_cMAVLinkCommand) );
     memset(m_cWiFiCommand, 0, sizeof(m_cWiFiCommand) );
 }
 
@@ -104,6 +108,105 @@ QPair<int, char*> RC_COM::cstr_makeRadioCommand() {
     return QPair<int, char*> (8, m_cRadioCommand);
 }
 
+uint8_t RC_COM::calc_crc8(const uint8_t *data, int len) {
+    uint8_t crc = 0x00;
+    for(int i = 0; i < len; i++) {
+        crc ^= data[i];
+        for(int j = 0; j < 8; j++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Multiplication in GF(256) with the polynomial 0x11D
+uint8_t RC_COM::gf_mul(uint8_t a, uint8_t b) {
+    uint8_t res = 0;
+    while(b) {
+        if(b & 1) {
+            res ^= a;
+        }
+        a = a & 0x80 ? (a << 1) ^ 0x1D : a << 1;
+        b >>= 1;
+    }
+    return res;
+}
+
+// Consistent overhead byte stuffing: No zero in the output, so zero is the frame delimiter
+int RC_COM::cobs_encode(const uint8_t *in, int len, char *out) {
+    int code_pos = 0;
+    int out_pos  = 1;
+    uint8_t code = 1;
+    for(int i = 0; i < len; i++) {
+        if(in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = out_pos++;
+            code = 1;
+        }
+        else {
+            out[out_pos++] = in[i];
+            code++;
+        }
+    }
+    out[code_pos] = code;
+    return out_pos;
+}
+
+/*
+ * Bit-packed (LSB first):
+ * Bit 0-9 throttle (us above 1000), 10-17 pitch, 18-25 roll, 26-35 yaw (2 steps per degree, centered in the field),
+ * 36-39 aux switches, 40-41 mode, 42-47 sequence number
+ */
+QPair<int, char*> RC_COM::cstr_makeRadioCommandV2() {
+    const float fDegScale = 2.f;
+    uint64_t iBits = 0;
+    iBits |= static_cast<uint64_t>(qBound(0, qRound(THR) - 1000, 1023) );
+    iBits |= static_cast<uint64_t>(qBound(0, qRound(PIT * fDegScale) + 128, 255) ) << 10;
+    iBits |= static_cast<uint64_t>(qBound(0, qRound(ROL * fDegScale) + 128, 255) ) << 18;
+    iBits |= static_cast<uint64_t>(qBound(0, qRound(YAW * fDegScale) + 512, 1023) ) << 26;
+    iBits |= static_cast<uint64_t>(AUX & 0x0F) << 36;
+    iBits |= static_cast<uint64_t>(MODE & 0x03) << 40;
+    iBits |= static_cast<uint64_t>(m_iSequence & 0x3F) << 42;
+    m_iSequence++;
+
+    uint8_t frame[7];
+    for(int i = 0; i < 6; i++) {
+        frame[i] = (iBits >> (8 * i) ) & 0xFF;
+    }
+    frame[6] = calc_crc8(frame, 6);
+
+    int len = cobs_encode(frame, 7, m_cRadioCommandV2);
+    if(FEC) {
+        // Check bytes over the encoded bytes, so the model corrects before the COBS decoding:
+        // Sum of all bytes = 0 and Horner sum with 2 = 0 (roots 1 and 2)
+        uint8_t s0 = 0, s1 = 0;
+        for(int i = 0; i < len; i++) {
+            s0 ^= static_cast<uint8_t>(m_cRadioCommandV2[i]);
+            s1 = gf_mul(s1, 2) ^ static_cast<uint8_t>(m_cRadioCommandV2[i]);
+        }
+        s1 = gf_mul(s1, 4);                 // weight of the data behind the two check bytes
+        uint8_t p0 = gf_mul(s0 ^ s1, 244);  // 244 = 1 / (1 + 2)
+        m_cRadioCommandV2[len++] = p0;
+        m_cRadioCommandV2[len++] = s0 ^ p0;
+    }
+    m_cRadioCommandV2[len++] = 0;
+    return QPair<int, char*> (len, m_cRadioCommandV2);
+}
+
+QPair<int, char*> RC_COM::cstr_makeMAVLinkCommand() {
+    // Full stick deflection of the firmware (RC_ROL_MAX, RC_PIT_MAX, RC_YAW_MAX) is 500 us from the center
+    const float fRolPitMax = 45.f;
+    const float fYawMax    = 180.f;
+    uint16_t rgPWM[4];
+    rgPWM[0] = qBound(1000, qRound(1500 + ROL * 500.f / fRolPitMax), 2000);
+    rgPWM[1] = qBound(1000, qRound(1500 + PIT * 500.f / fRolPitMax), 2000);
+    rgPWM[2] = qBound(1000, qRound(THR), 2000);
+    rgPWM[3] = qBound(1000, qRound(1500 + YAW * 500.f / fYawMax), 2000);
+
+    int len = MAVCodec::makeRCOverride(rgPWM, m_iSequence++, m_cMAVLinkCommand);
+    return QPair<int, char*> (len, m_cMAVLinkCommand);
+}
+
 DRIFT_CAL::DRIFT_CAL() {
     ROL = 0; PIT = 0;
     memset(m_cWiFiCommand, 0, sizeof(m_cWiFiCommand) );
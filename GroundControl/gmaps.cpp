@@ -1,10 +1,116 @@
 #include "gmaps.h"
 
 
-Maps::Maps(QWidget *parent)
+Maps::Maps(QUdpSocket *pSock, QWidget *parent)
     : QWidget(parent)
 {
+    m_pUdpSock = pSock;
+    m_bFenceCleared = false;
+    m_iEchoCnt = 0;
+    m_iEchoRecvd = 0;
+    m_iFenceTries = 0;
     setupUI();
+
+    connect(&m_fenceTimer, SIGNAL(timeout() ), this, SLOT(sl_resendFence() ) );
+}
+
+void Maps::sendFenceVertex(double fLat, double fLon, int iIdx, int iCnt) {
+    if(!m_pUdpSock) {
+        return;
+    }
+
+    QString com = "";
+    QTextStream stream(&com);
+    stream << "{\"type\":\"fnc\",\"lat_d\":" << qRound(fLat * 10000000.0)
+           << ",\"lon_d\":" << qRound(fLon * 10000000.0)
+           << ",\"alt_cm\":" << m_pCeiling->value() * 100
+           << ",\"idx\":" << iIdx
+           << ",\"cnt\":" << iCnt << "}";
+
+    m_pUdpSock->write(com.toLocal8Bit(), com.length() );
+}
+
+void Maps::sendFence(int iMask) {
+    for(int i = 0; i < m_lFence.size(); i++) {
+        if(iMask & (1 << i) ) {
+            sendFenceVertex(m_lFence.at(i).first, m_lFence.at(i).second, i, m_lFence.size() );
+        }
+    }
+}
+
+void Maps::startFenceUpload() {
+    m_bFenceCleared = false;
+    m_iFenceTries = 0;
+    sendFenceVertex(0, 0, 0, 0);
+    m_fenceTimer.start(FENCE_RETRY_T_MS);
+}
+
+void Maps::sl_submitFence() {
+    RouteF lVertices = getWaypoints();
+    // The model accepts 3 to 8 vertices
+    if(lVertices.size() < 3 || lVertices.size() > 8) {
+        qDebug() << "Warning: A fence needs 3 to 8 vertices!";
+        return;
+    }
+
+    m_lFence = lVertices;
+    startFenceUpload();
+}
+
+void Maps::sl_removeFence() {
+    m_lFence.clear();
+    startFenceUpload();
+    mView->page()->mainFrame()->evaluateJavaScript(QString("deleteFence();") );
+}
+
+void Maps::sl_setFenceState(int iCnt, int iRecvd) {
+    m_iEchoCnt = iCnt;
+    m_iEchoRecvd = iRecvd;
+    if(!m_fenceTimer.isActive() ) {
+        return;
+    }
+
+    if(!m_bFenceCleared) {
+        // The timer repeats the removal
+        if(iCnt != 0) {
+            return;
+        }
+        m_bFenceCleared = true;
+        if(m_lFence.isEmpty() ) {
+            m_fenceTimer.stop();
+            return;
+        }
+        m_iEchoRecvd = 0;
+        sendFence((1 << m_lFence.size() ) - 1);
+        m_fenceTimer.start(FENCE_RETRY_T_MS);
+        return;
+    }
+
+    if(iCnt == m_lFence.size() && iRecvd == (1 << m_lFence.size() ) - 1) {
+        m_fenceTimer.stop();
+        mView->page()->mainFrame()->evaluateJavaScript(QString("drawFence();") );
+    }
+}
+
+void Maps::sl_resendFence() {
+    if(++m_iFenceTries > FENCE_TRIES) {
+        m_fenceTimer.stop();
+        qDebug() << "Warning: The model did not confirm the fence!";
+        return;
+    }
+
+    if(!m_bFenceCleared) {
+        sendFenceVertex(0, 0, 0, 0);
+        return;
+    }
+
+    // The first vertex (or another count) restarts the upload on the model: Then all vertices are needed
+    int iAll = (1 << m_lFence.size() ) - 1;
+    int iMissing = iAll & ~m_iEchoRecvd;
+    if(m_iEchoCnt != m_lFence.size() || (iMissing & 1) ) {
+        iMissing = iAll;
+    }
+    sendFence(iMissing);
 }
 
 void Maps::setupUI()
@@ -21,14 +127,20 @@ void Maps::setupUI()
 
     QPushButton *btnRemoveRoute = new QPushButton( "Remove route", this );
     QPushButton *btnSubmitRoute = new QPushButton( "Submit route", this );
+    QPushButton *btnSubmitFence = new QPushButton( "Submit fence", this );
+    QPushButton *btnRemoveFence = new QPushButton( "Remove fence", this );
 
     QLabel *latitude = new QLabel("Latitude: ");
     QLabel *longitude = new QLabel("Longitude: ");
+    QLabel *ceiling = new QLabel("Ceiling (m): ");
     m_pLat = new QDoubleSpinBox(this);
     m_pLon = new QDoubleSpinBox(this);
+    m_pCeiling = new QSpinBox(this);
 
     m_pLat->setRange(-90, 90);
     m_pLon->setRange(-180, 180);
+    m_pCeiling->setRange(1, 500);
+    m_pCeiling->setValue(50);
 
     connect( btnLeft, SIGNAL(clicked()), this, SLOT(sl_goLeft()) );
     connect( btnRight, SIGNAL(clicked()), this, SLOT(sl_goRight()) );
@@ -36,6 +148,8 @@ void Maps::setupUI()
     connect( btnDown, SIGNAL(clicked()), this, SLOT(sl_goDown()) );
     connect( btnRemoveRoute, SIGNAL(clicked()), this, SLOT(sl_clearRoute()) );
     connect( btnSubmitRoute, SIGNAL(clicked()), this, SLOT(sl_submitRoute()) );
+    connect( btnSubmitFence, SIGNAL(clicked()), this, SLOT(sl_submitFence()) );
+    connect( btnRemoveFence, SIGNAL(clicked()), this, SLOT(sl_removeFence()) );
     connect( m_pLat, SIGNAL(valueChanged(double)), this, SLOT(sl_moveToDxDy(double)) );
     connect( m_pLon, SIGNAL(valueChanged(double)), this, SLOT(sl_moveToDxDy(double)) );
 
@@ -52,6 +166,11 @@ void Maps::setupUI()
     layout->addWidget( btnRemoveRoute, 8, 1 );
     layout->addWidget( btnSubmitRoute, 9, 1 );
 
+    layout->addWidget( ceiling, 10, 1, 1, 1 );
+    layout->addWidget( m_pCeiling, 10, 2, 1, 2 );
+    layout->addWidget( btnRemoveFence, 11, 1 );
+    layout->addWidget( btnSubmitFence, 12, 1 );
+
     //
     // Embedded webpage
     //
@@ -66,6 +185,6 @@ void Maps::setupUI()
     QUrl url = QUrl::fromLocalFile( fileName );
     mView->load( url );
 
-    layout->addWidget( mView, 1, 6, 9, 1 );
+    layout->addWidget( mView, 1, 6, 12, 1 );
     layout->setColumnStretch(6, 1);
 }
@@ -3,6 +3,11 @@
 
 #include <QtWidgets>
 #include <QtWebKitWidgets>
+#include <QUdpSocket>
+
+
+#define FENCE_RETRY_T_MS 1500 // The model echoes the fence upload once per second
+#define FENCE_TRIES 5
 
 
 typedef QPair<double, double> PointF;
@@ -14,7 +19,7 @@ class Maps : public QWidget
     Q_OBJECT
     
 public:
-    Maps(QWidget *parent = 0);
+    Maps(QUdpSocket *pSock, QWidget *parent = 0);
 
 public slots:
     void sl_goLeft() {
@@ -54,6 +59,12 @@ public slots:
         getWaypoints();
     }
 
+    // The markers of the route are the vertices of the fence
+    void sl_submitFence();
+    void sl_removeFence();
+    // Echo of the model: Nr. of vertices and bit mask of the received ones
+    void sl_setFenceState(int iCnt, int iRecvd);
+
     // Returns a list of points: Latitude & Longitude
     RouteF getWaypoints() {
         RouteF lWaypoints;
@@ -81,8 +92,14 @@ public slots:
         sl_goTo(m_pLat->value(), m_pLon->value() );
     }
 
+private slots:
+    void sl_resendFence();
+
 private:
     void setupUI();
+    void sendFenceVertex(double fLat, double fLon, int iIdx, int iCnt);
+    void sendFence(int iMask);
+    void startFenceUpload();
 
     void moveDxDy( int dx, int dy ) {
         mView->page()->mainFrame()->evaluateJavaScript( QString("map.panBy(%1, %2);").arg(dx).arg(dy) );
@@ -90,7 +107,18 @@ private:
 
     QDoubleSpinBox *m_pLat;
     QDoubleSpinBox *m_pLon;
+    QSpinBox *m_pCeiling;
     QWebView *mView;
+    QUdpSocket *m_pUdpSock;
+
+    // The datagrams are not acknowledged: The upload is repeated until the echo of the model matches.
+    // An upload starts with a removal, so vertices of the previous fence never complete the new one.
+    RouteF m_lFence;      // Empty: Removal
+    bool m_bFenceCleared;
+    int m_iEchoCnt;
+    int m_iEchoRecvd;
+    int m_iFenceTries;
+    QTimer m_fenceTimer;
 };
 
 #endif // QMAPS_H
@@ -17,6 +17,7 @@ MainWindow::MainWindow(QSettings *pConf, QWidget *parent)
     m_iCurrentPingSent = 0;
     m_iCurrentPingRecv = 0;
     m_fSLTime_s        = 0.f;
+    m_iMAVSequence     = 0;
 
     m_pStatusBar     = new QStatusBar(this);
     m_pUdpSocket     = new QUdpSocket(this);
@@ -25,7 +26,7 @@ MainWindow::MainWindow(QSettings *pConf, QWidget *parent)
     m_pStatBarStream = new QTextStream(&m_sStatBarSensor);
 
     m_pRCThrottle    = new QProgressBar(this);
-    m_pGMaps         = new Maps(this);
+    m_pGMaps         = new Maps(m_pUdpSocket, this);
 
     m_pPIDConfig     = new QPIDDockWidget("PID Configuration");
     m_pLogger        = new QLogDockWidget("Logger");
@@ -73,6 +74,10 @@ void MainWindow::prepareMenus() {
     m_pOptionMPIDConf   = new QAction(tr("Configurate PIDs"), m_pOptionM);
     m_pOptionRadioEnabled = new QAction(tr("Enable radio"), m_pOptionM);
     m_pOptionRadioEnabled->setCheckable(true);
+    m_pOptionRadioFEC   = new QAction(tr("Radio error correction"), m_pOptionM);
+    m_pOptionRadioFEC->setCheckable(true);
+    m_pOptionRadioMAVLink = new QAction(tr("Radio MAVLink"), m_pOptionM);
+    m_pOptionRadioMAVLink->setCheckable(true);
     m_pOptionTrackingEnabled = new QAction(tr("Enable tracking"), m_pOptionM);
     m_pOptionTrackingEnabled->setCheckable(true);
     m_pOptionPing       = new QAction(tr("Configurate ping timing"), m_pFileM);
@@ -83,6 +88,19 @@ void MainWindow::prepareMenus() {
     m_pOptionRadioEnabled->setChecked(bEnableRadio);
     m_pConf->setValue("UseRadio", bEnableRadio);
 
+    bool bRadioFEC = m_pConf->value("RadioFEC", false).toBool();
+    m_pOptionRadioFEC->setChecked(bRadioFEC);
+    m_pConf->setValue("RadioFEC", bRadioFEC);
+    m_pRCWidget->sl_setRadioFEC(bRadioFEC);
+
+    bool bRadioMAVLink = m_pConf->value("RadioMAVLink", false).toBool();
+    m_pOptionRadioMAVLink->setChecked(bRadioMAVLink);
+    m_pConf->setValue("RadioMAVLink", bRadioMAVLink);
+    m_pRCWidget->sl_setRadioMAVLink(bRadioMAVLink);
+    if(bRadioMAVLink) {
+        m_heartbeatTimer.start(MAV_HEARTBEAT_T_MS);
+    }
+
     bool bEnableTracking = m_pConf->value("GPSTracking", true).toBool();
     m_pOptionTrackingEnabled->setChecked(bEnableTracking);
     m_pConf->setValue("GPSTracking", bEnableTracking);
@@ -97,6 +115,8 @@ void MainWindow::prepareMenus() {
     m_pOptionM->addAction(m_pOptionHost);
     m_pOptionM->addSeparator();
     m_pOptionM->addAction(m_pOptionRadioEnabled);
+    m_pOptionM->addAction(m_pOptionRadioFEC);
+    m_pOptionM->addAction(m_pOptionRadioMAVLink);
     m_pOptionM->addAction(m_pOptionTrackingEnabled);
 
     connect(m_pFileMSave, SIGNAL(triggered() ), this, SLOT(sl_saveLog() ) );
@@ -107,6 +127,8 @@ void MainWindow::prepareMenus() {
     connect(m_pOptionHost, SIGNAL(triggered() ), this, SLOT(sl_configHost() ) );
 
     connect(m_pOptionRadioEnabled, SIGNAL(toggled(bool) ) , this, SLOT(sl_radioToggleChanged(bool) ) );
+    connect(m_pOptionRadioFEC, SIGNAL(toggled(bool) ) , this, SLOT(sl_radioFECToggleChanged(bool) ) );
+    connect(m_pOptionRadioMAVLink, SIGNAL(toggled(bool) ) , this, SLOT(sl_radioMAVLinkToggleChanged(bool) ) );
     connect(m_pOptionTrackingEnabled, SIGNAL(toggled(bool) ), this, SLOT(sl_trackingToggleChanged(bool) ) );
 
     connect(m_pOptionProfiles, SIGNAL(triggered() ), this, SLOT(sl_configProfiles() ) );
@@ -190,6 +212,8 @@ void MainWindow::prepareWidgets() {
 void MainWindow::connectWidgets() {
     connect(&m_pingTimer, SIGNAL(timeout() ), this, SLOT(sl_sendPing() ) );
     connect(m_pUdpSocket, SIGNAL(readyRead() ), this, SLOT(sl_recvCommand() ) );
+    connect(&m_pSerialPort, SIGNAL(readyRead() ), this, SLOT(sl_recvSerial() ) );
+    connect(&m_heartbeatTimer, SIGNAL(timeout() ), this, SLOT(sl_sendHeartbeat() ) );
     connect(&m_plotTimer, SIGNAL(timeout() ), this, SLOT(sl_replotGraphs() ) );
     
     connect(m_pRCWidget, SIGNAL(si_send2Model(QString, QString) ), this, SLOT(sl_updateStatusBar(QString, QString) ) );
@@ -225,6 +249,32 @@ void MainWindow::sl_radioToggleChanged(bool state) {
     m_pRCWidget->sl_setRadioEnabled(state);
 }
 
+void MainWindow::sl_radioFECToggleChanged(bool state) {
+    assert(m_pConf != NULL);
+    m_pConf->setValue("RadioFEC", state);
+    m_pRCWidget->sl_setRadioFEC(state);
+}
+
+void MainWindow::sl_radioMAVLinkToggleChanged(bool state) {
+    assert(m_pConf != NULL);
+    m_pConf->setValue("RadioMAVLink", state);
+    m_pRCWidget->sl_setRadioMAVLink(state);
+    if(state) {
+        m_heartbeatTimer.start(MAV_HEARTBEAT_T_MS);
+    } else {
+        m_heartbeatTimer.stop();
+    }
+}
+
+void MainWindow::sl_sendHeartbeat() {
+    if(!m_pSerialPort.isOpen() ) {
+        return;
+    }
+    char cFrame[9 + MAV_FRAME_OVERHEAD];
+    int iLen = MAVCodec::makeHeartbeat(m_iMAVSequence++, cFrame);
+    m_pSerialPort.write(cFrame, iLen);
+}
+
 bool MainWindow::searchSerialRadio() {
     bool bRes = false;
     // Example use QSerialPortInfo
@@ -459,6 +509,10 @@ void MainWindow::sl_UpdateSensorData(QPair<double, QVariantMap> sensorRead) {
         float fLon = map["lon"].toDouble();
         m_pGMaps->sl_setQuad(fLat, fLon, fHeading);
     }
+    // Fence upload
+    if(map["type"].toString() == "s_fnc") {
+        m_pGMaps->sl_setFenceState(map["cnt"].toInt(), map["rcv"].toInt() );
+    }
     // Battery
     if(map["type"].toString() == "s_bat") {
         m_vBattery_s.append(time_s);
@@ -553,6 +607,17 @@ void MainWindow::sl_recvCommand() {
     sl_UpdateSensorData(QPair<double, QVariantMap>(fTimeElapsed_s, result) );
 }
 
+// MAVLink telemetry from the radio: Decoded into the same maps as the JSON strings
+void MainWindow::sl_recvSerial() {
+    QList<QVariantMap> list = m_MAVCodec.parse(m_pSerialPort.readAll() );
+    foreach(const QVariantMap &map, list) {
+        // The logger shows the messages as JSON, so the log can be loaded again
+        m_udpCurLine = QJsonDocument::fromVariant(map).toJson(QJsonDocument::Compact);
+        double fTimeElapsed_s = ((double)m_tSensorTime.elapsed() / 1000.f) + m_fSLTime_s;
+        sl_UpdateSensorData(QPair<double, QVariantMap>(fTimeElapsed_s, map) );
+    }
+}
+
 void MainWindow::connectToHost(const QString & hostName, quint16 port, QIODevice::OpenMode openMode) {
     if(m_pUdpSocket->state() == QUdpSocket::ConnectedState) {
         m_pUdpSocket->close();
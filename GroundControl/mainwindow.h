@@ -16,9 +16,11 @@
 #include "piddialog.h"
 #include "gmaps.h"
 #include "trimprofile.h"
+#include "mavcodec.h"
 
 
 #define PING_T_MS 250
+#define MAV_HEARTBEAT_T_MS 1000
 
 
 class MainWindow : public QMainWindow {
@@ -32,6 +34,8 @@ private:
     QAction *m_pFileMLoad;
     QAction *m_pOptionMPIDConf;
     QAction *m_pOptionRadioEnabled;
+    QAction *m_pOptionRadioFEC;
+    QAction *m_pOptionRadioMAVLink;
     QAction *m_pOptionTrackingEnabled;
     QAction *m_pOptionPing;
     QAction *m_pOptionHost;
@@ -45,6 +49,12 @@ private:
     QSerialPort m_pSerialPort;
     QSerialPortInfo m_serialPortInfo;
 
+    // MAVLink on the radio: Telemetry is decoded from the serial port,
+    // the heartbeat keeps the port of the model in the MAVLink mode
+    MAVCodec m_MAVCodec;
+    QTimer m_heartbeatTimer;
+    uint8_t m_iMAVSequence;
+
     bool m_bUdpSockCon;
     
     QTimer m_pingTimer;
@@ -103,6 +113,8 @@ private slots:
     void sl_loadLog();
 
     void sl_recvCommand();
+    void sl_recvSerial();
+    void sl_sendHeartbeat();
     void sl_replotGraphs();
     void sl_UpdateSensorData(QPair<double, QVariantMap> map);
 
@@ -111,6 +123,8 @@ private slots:
     
     void sl_sendPing();
     void sl_radioToggleChanged(bool);
+    void sl_radioFECToggleChanged(bool);
+    void sl_radioMAVLinkToggleChanged(bool);
     void sl_trackingToggleChanged(bool);
 
     void sl_changeTab(int);
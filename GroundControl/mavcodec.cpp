@@ -0,0 +1,223 @@
+#include "mavcodec.h"
+#include <QtEndian>
+#include <math.h>
+
+
+MAVCodec::MAVCodec() {
+    m_eState  = IDLE_S;
+    m_iErrors = 0;
+}
+
+uint16_t MAVCodec::crc_accumulate(uint8_t c, uint16_t crc) {
+    uint8_t tmp = c ^ static_cast<uint8_t>(crc & 0xFF);
+    tmp ^= (tmp << 4);
+    return (crc >> 8) ^ (static_cast<uint16_t>(tmp) << 8) ^ (static_cast<uint16_t>(tmp) << 3) ^ (tmp >> 4);
+}
+
+bool MAVCodec::msg_info(uint8_t msgid, uint8_t &len, uint8_t &extra) {
+    switch(msgid) {
+        case MAV_MSG_HEARTBEAT:            len = 9;  extra = 50;  return true;
+        case MAV_MSG_SYS_STATUS:           len = 31; extra = 124; return true;
+        case MAV_MSG_PARAM_REQUEST_LIST:   len = 2;  extra = 159; return true;
+        case MAV_MSG_PARAM_VALUE:          len = 25; extra = 220; return true;
+        case MAV_MSG_PARAM_SET:            len = 23; extra = 168; return true;
+        case MAV_MSG_GPS_RAW_INT:          len = 30; extra = 24;  return true;
+        case MAV_MSG_ATTITUDE:             len = 28; extra = 39;  return true;
+        case MAV_MSG_RC_CHANNELS_RAW:      len = 22; extra = 244; return true;
+        case MAV_MSG_REQUEST_DATA_STREAM:  len = 6;  extra = 148; return true;
+        case MAV_MSG_RC_CHANNELS_OVERRIDE: len = 18; extra = 124; return true;
+        default:                           return false;
+    }
+}
+
+int MAVCodec::errors() const {
+    return m_iErrors;
+}
+
+QList<QVariantMap> MAVCodec::parse(const QByteArray &data) {
+    QList<QVariantMap> list;
+    for(int i = 0; i < data.size(); i++) {
+        uint8_t c = static_cast<uint8_t>(data.at(i) );
+        switch(m_eState) {
+            case IDLE_S:
+                if(c == MAV_STX) {
+                    m_frame.clear();
+                    m_eState = HEADER_S;
+                }
+                break;
+            case HEADER_S:
+                // length, sequence, system, component, message id
+                m_frame.append(c);
+                if(m_frame.size() == 5) {
+                    m_eState = m_frame.at(0) ? PAYLOAD_S : CRC_S;
+                }
+                break;
+            case PAYLOAD_S:
+                m_frame.append(c);
+                if(m_frame.size() == 5 + static_cast<uint8_t>(m_frame.at(0) ) ) {
+                    m_eState = CRC_S;
+                }
+                break;
+            case CRC_S: {
+                m_frame.append(c);
+                if(m_frame.size() < 7 + static_cast<uint8_t>(m_frame.at(0) ) ) {
+                    break;
+                }
+                m_eState = IDLE_S;
+
+                const uchar *pFrame = reinterpret_cast<const uchar *>(m_frame.constData() );
+                uint8_t iLen   = pFrame[0];
+                uint8_t iMsgID = pFrame[4];
+                uint8_t iExpLen, iExtra;
+                if(!msg_info(iMsgID, iExpLen, iExtra) ) {
+                    // Unknown messages are skipped silently
+                    break;
+                }
+                uint16_t iCRC = 0xFFFF;
+                for(int j = 0; j < 5 + iLen; j++) {
+                    iCRC = crc_accumulate(pFrame[j], iCRC);
+                }
+                iCRC = crc_accumulate(iExtra, iCRC);
+                if(iLen != iExpLen || iCRC != qFromLittleEndian<quint16>(pFrame + 5 + iLen) ) {
+                    m_iErrors++;
+                    break;
+                }
+
+                QVariantMap map = decode(iMsgID, pFrame + 5);
+                if(!map.empty() ) {
+                    list.append(map);
+                }
+            } break;
+        }
+    }
+    return list;
+}
+
+QVariantMap MAVCodec::decode(uint8_t msgid, const uchar *payload) const {
+    QVariantMap map;
+    // Fields in the order of the wire format (ordered by size)
+    switch(msgid) {
+        case MAV_MSG_HEARTBEAT:
+            map["type"]  = "m_hbt";
+            map["mode"]  = payload[6];
+            map["state"] = payload[7];
+            map["armed"] = (payload[6] & 0x80) != 0;
+            break;
+
+        case MAV_MSG_SYS_STATUS:
+            map["type"]  = "s_bat";
+            map["hlt"]   = qFromLittleEndian<quint32>(payload + 8);
+            map["V"]     = qFromLittleEndian<quint16>(payload + 14) / 1000.0;
+            map["A"]     = qFromLittleEndian<qint16>(payload + 16) / 100.0;
+            map["lost"]  = qFromLittleEndian<quint16>(payload + 20);
+            map["fixed"] = qFromLittleEndian<quint16>(payload + 22);
+            map["soc"]   = static_cast<int8_t>(payload[30]);
+            break;
+
+        case MAV_MSG_GPS_RAW_INT:
+            map["type"]  = "s_gps";
+            map["lat"]   = qFromLittleEndian<qint32>(payload + 8) / 10000000.0;
+            map["lon"]   = qFromLittleEndian<qint32>(payload + 12) / 10000000.0;
+            map["a_cm"]  = qFromLittleEndian<qint32>(payload + 16) / 10;
+            map["g_cms"] = qFromLittleEndian<quint16>(payload + 24);
+            map["g_cd"]  = qFromLittleEndian<quint16>(payload + 26);
+            map["fix"]   = payload[28];
+            map["sat"]   = payload[29];
+            break;
+
+        case MAV_MSG_ATTITUDE: {
+            float rgAtti[3];
+            for(int i = 0; i < 3; i++) {
+                quint32 iRaw = qFromLittleEndian<quint32>(payload + 4 + 4 * i);
+                memcpy(&rgAtti[i], &iRaw, sizeof(float) );
+            }
+            map["type"]  = "s_att";
+            map["r"]     = rgAtti[0] * 180.0 / M_PI;
+            map["p"]     = rgAtti[1] * 180.0 / M_PI;
+            map["y"]     = rgAtti[2] * 180.0 / M_PI;
+        } break;
+
+        case MAV_MSG_RC_CHANNELS_RAW:
+            map["type"]  = "rc_raw";
+            map["r"]     = qFromLittleEndian<quint16>(payload + 4);
+            map["p"]     = qFromLittleEndian<quint16>(payload + 6);
+            map["t"]     = qFromLittleEndian<quint16>(payload + 8);
+            map["y"]     = qFromLittleEndian<quint16>(payload + 10);
+            break;
+
+        case MAV_MSG_PARAM_VALUE: {
+            quint32 iRaw = qFromLittleEndian<quint32>(payload);
+            float fVal;
+            memcpy(&fVal, &iRaw, sizeof(float) );
+            QString sID = QString::fromLatin1(reinterpret_cast<const char *>(payload + 8), 16);
+            sID.truncate(sID.indexOf(QChar('\0') ) < 0 ? 16 : sID.indexOf(QChar('\0') ) );
+
+            map["type"]  = "param";
+            map["id"]    = sID;
+            map["v"]     = fVal;
+            map["n"]     = qFromLittleEndian<quint16>(payload + 4);
+            map["i"]     = qFromLittleEndian<quint16>(payload + 6);
+
+            // PID gains (e.g. PIT_RATE_IMAX) also with the keys of the PID configuration (p_rimax)
+            QStringList lName = sID.split('_');
+            QMap<QString, QString> axes;
+            axes["PIT"] = "p"; axes["ROL"] = "r"; axes["YAW"] = "y"; axes["THR"] = "t"; axes["ACC"] = "a";
+            QMap<QString, QString> gains;
+            gains["P"] = "kp"; gains["I"] = "ki"; gains["D"] = "kd"; gains["IMAX"] = "imax";
+            if(lName.size() == 3 && axes.contains(lName.at(0) ) && gains.contains(lName.at(2) ) &&
+               (lName.at(1) == "RATE" || lName.at(1) == "STAB") )
+            {
+                QString sKey = axes[lName.at(0)] + "_" + (lName.at(1) == "RATE" ? "r" : "s") + gains[lName.at(2)];
+                map["type"] = "pid_cnf";
+                map[sKey]   = fVal;
+            }
+        } break;
+
+        default:
+            break;
+    }
+    return map;
+}
+
+int MAVCodec::pack(uint8_t msgid, const uint8_t *payload, uint8_t seq, char *out) {
+    uint8_t iLen, iExtra;
+    if(!msg_info(msgid, iLen, iExtra) ) {
+        return 0;
+    }
+
+    uint8_t *pOut = reinterpret_cast<uint8_t *>(out);
+    pOut[0] = MAV_STX;
+    pOut[1] = iLen;
+    pOut[2] = seq;
+    pOut[3] = MAV_GCS_SYSTEM_ID;
+    pOut[4] = MAV_GCS_COMP_ID;
+    pOut[5] = msgid;
+    memcpy(pOut + 6, payload, iLen);
+
+    uint16_t iCRC = 0xFFFF;
+    for(int i = 1; i < 6 + iLen; i++) {
+        iCRC = crc_accumulate(pOut[i], iCRC);
+    }
+    iCRC = crc_accumulate(iExtra, iCRC);
+    pOut[6 + iLen] = iCRC & 0xFF;
+    pOut[7 + iLen] = iCRC >> 8;
+    return iLen + MAV_FRAME_OVERHEAD;
+}
+
+int MAVCodec::makeHeartbeat(uint8_t seq, char *out) {
+    // custom_mode (0), type (MAV_TYPE_GCS), autopilot (MAV_AUTOPILOT_INVALID), base_mode, system_status (MAV_STATE_ACTIVE), mavlink_version
+    const uint8_t payload[9] = { 0, 0, 0, 0, 6, 8, 0, 4, 3 };
+    return pack(MAV_MSG_HEARTBEAT, payload, seq, out);
+}
+
+int MAVCodec::makeRCOverride(const uint16_t *rgPWM, uint8_t seq, char *out) {
+    // chan1_raw .. chan8_raw, target_system, target_component; Zero releases a channel
+    uint8_t payload[18];
+    memset(payload, 0, sizeof(payload) );
+    for(int i = 0; i < 4; i++) {
+        qToLittleEndian<quint16>(rgPWM[i], payload + 2 * i);
+    }
+    payload[16] = MAV_MODEL_SYSTEM_ID;
+    payload[17] = 0;
+    return pack(MAV_MSG_RC_CHANNELS_OVERRIDE, payload, seq, out);
+}
@@ -0,0 +1,65 @@
+#ifndef MAVCODEC_h
+#define MAVCODEC_h
+
+#include <QtWidgets>
+#include <stdint.h>
+
+
+// MAVLink v1 messages of the firmware
+#define MAV_MSG_HEARTBEAT            0
+#define MAV_MSG_SYS_STATUS           1
+#define MAV_MSG_PARAM_REQUEST_LIST   21
+#define MAV_MSG_PARAM_VALUE          22
+#define MAV_MSG_PARAM_SET            23
+#define MAV_MSG_GPS_RAW_INT          24
+#define MAV_MSG_ATTITUDE             30
+#define MAV_MSG_RC_CHANNELS_RAW      35
+#define MAV_MSG_REQUEST_DATA_STREAM  66
+#define MAV_MSG_RC_CHANNELS_OVERRIDE 70
+
+#define MAV_STX                      0xFE
+#define MAV_FRAME_OVERHEAD           8   // Start byte, length, sequence, system, component, message id and CRC
+#define MAV_MODEL_SYSTEM_ID          1   // MAV_SYSTEM_ID of the firmware
+#define MAV_GCS_SYSTEM_ID            255
+#define MAV_GCS_COMP_ID              190
+
+
+/*
+ * Minimal MAVLink v1 encoder and decoder for the messages of the firmware.
+ * Frame: MAV_STX, length, sequence, system id, component id, message id, payload
+ * and the X.25 CRC (seeded with the CRC_EXTRA of the message).
+ */
+class MAVCodec {
+private:
+    enum PARSE_STATE {
+        IDLE_S = 0,
+        HEADER_S,
+        PAYLOAD_S,
+        CRC_S
+    };
+
+    PARSE_STATE m_eState;
+    QByteArray  m_frame;                    // Frame without the start byte
+    int         m_iErrors;                  // Frames with a wrong checksum or length
+
+    static uint16_t crc_accumulate(uint8_t c, uint16_t crc);
+    static bool     msg_info(uint8_t msgid, uint8_t &len, uint8_t &extra);
+
+    QVariantMap decode(uint8_t msgid, const uchar *payload) const;
+
+public:
+    MAVCodec();
+
+    // Feeds received bytes into the parser:
+    // Complete messages are returned as maps with the keys of the JSON strings of the firmware
+    QList<QVariantMap> parse(const QByteArray &data);
+    int errors() const;
+
+    // Frame into out (payload length + MAV_FRAME_OVERHEAD bytes); Returns the length or 0 for unknown messages
+    static int pack(uint8_t msgid, const uint8_t *payload, uint8_t seq, char *out);
+    static int makeHeartbeat(uint8_t seq, char *out);
+    // Channel 1-4: roll, pitch, throttle and yaw in PWM (1000-2000 us)
+    static int makeRCOverride(const uint16_t *rgPWM, uint8_t seq, char *out);
+};
+
+#endif
@@ -6,6 +6,14 @@ void QRCWidget::sl_setRadioEnabled(bool state) {
     m_bRadioEnabled = state;
 }
 
+void QRCWidget::sl_setRadioFEC(bool state) {
+    m_COM.FEC = state;
+}
+
+void QRCWidget::sl_setRadioMAVLink(bool state) {
+    m_bRadioMAVLink = state;
+}
+
 QRCWidget::QRCWidget(QUdpSocket *pSock, QSerialPort *pSerialPort, QWidget *parent) : QAbsFrame(parent) {
     assert(pSock != NULL);
     m_pUdpSock = pSock;
@@ -18,6 +26,8 @@ QRCWidget::QRCWidget(QUdpSocket *pSock, QSerialPort *pSerialPort, QWidget *paren
     setFocusPolicy(Qt::StrongFocus);
 
     m_bRadioEnabled = true;
+    m_bRadioMAVLink = false;
+    m_iMAVLinkTick  = 0;
     m_bAltitudeHold = false;
 
     m_iUpdateTime = 20;
@@ -362,7 +372,14 @@ void QRCWidget::sendJSON2COM(QPair<int, char*> pair) {
 
 void QRCWidget::sl_sendRC2UDP() {
     sendJSON2UDP(m_COM.str_makeWiFiCommand() );
-    if(m_bRadioEnabled) {
-        sendJSON2COM(m_COM.cstr_makeRadioCommand() );
+    if(!m_bRadioEnabled) {
+        return;
+    }
+    if(!m_bRadioMAVLink) {
+        sendJSON2COM(m_COM.cstr_makeRadioCommandV2() );
+    }
+    // The RC override is more than twice as long as a frame v2: Only every second tick fits into 9600 baud
+    else if(m_iMAVLinkTick++ % 2 == 0) {
+        sendJSON2COM(m_COM.cstr_makeMAVLinkCommand() );
     }
 }
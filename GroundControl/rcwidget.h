@@ -38,6 +38,8 @@ private:
     void deactAltihold2UDP();
 
     bool m_bRadioEnabled;
+    bool m_bRadioMAVLink;
+    int  m_iMAVLinkTick;
     bool m_bAltitudeHold;
     
 private slots:
@@ -50,6 +52,8 @@ private slots:
     
 public slots:
     void sl_setRadioEnabled(bool state);
+    void sl_setRadioFEC(bool state);
+    void sl_setRadioMAVLink(bool state);
     void sl_setAttitudeCorr(float fRoll, float fPitch);
     
 signals:
@@ -1,5 +1,44 @@
+#include <AP_Math.h>
+
 #include "BattMonitor.h"
+#include "filter.h"
+
+
+// Resting voltage of a LiPo cell from 0 % to 100 % state of charge in steps of 10 %
+static const float LIPO_CURVE_V[] = { 3.30f, 3.60f, 3.69f, 3.72f, 3.75f, 3.78f, 3.82f, 3.87f, 3.93f, 4.03f, 4.20f };
+static const uint_fast8_t LIPO_CURVE_S = sizeof(LIPO_CURVE_V) / sizeof(LIPO_CURVE_V[0]);
+
+static float lipo_soc_pct(const float fCell_V) {
+  if(fCell_V <= LIPO_CURVE_V[0]) {
+    return 0.f;
+  }
+  for(uint_fast8_t i = 1; i < LIPO_CURVE_S; i++) {
+    if(fCell_V < LIPO_CURVE_V[i]) {
+      float fFrac = (fCell_V - LIPO_CURVE_V[i-1]) / (LIPO_CURVE_V[i] - LIPO_CURVE_V[i-1]);
+      return (i - 1 + fFrac) * 100.f / (LIPO_CURVE_S - 1);
+    }
+  }
+  return 100.f;
+}
+
+BattMonitor::BattMonitor() {
+  _type       = ATTO180;
 
+  _resist_ohm = BATT_R_INIT_OHM;
+  _step_ohm   = 0.f;
+  _last_volt  = 0.f;
+  _last_curr  = 0.f;
+  _load_curr  = 0.f;
+  _rest_volt  = 0.f;
+  _init_volt  = 0.f;
+  _init_soc   = 0.f;
+  _init_mah   = 0.f;
+  _soc        = 0.f;
+  _cells      = 0;
+  _cells_cfg  = 0;
+  _init_cnt   = 0;
+  _steady_cnt = 0;
+}
 
 void BattMonitor::setup_source(int_fast8_t volt_pin,
                         int_fast8_t curr_pin,
@@ -21,6 +60,7 @@ void BattMonitor::setup_source(int_fast8_t volt_pin,
 }
 
 void BattMonitor::setup_source(const int &t) {
+  _type = t;
   switch (t) {
     case ATTO45:
       setup_source(AP_ATTO_VOLT_PIN, AP_ATTO_CURR_PIN, AP_BATT_VOLTDIVIDER_ATTO45, AP_BATT_CURR_AMP_PERVOLT_ATTO45, AP_BATT_CAPACITY_DEFAULT, 0, AP_BATT_MONITOR_VOLTAGE_AND_CURRENT);
@@ -36,3 +76,132 @@ void BattMonitor::setup_source(const int &t) {
     break;
   }
 }
+
+void BattMonitor::set_type(const int_fast8_t t) {
+  _type = t;
+}
+
+int_fast8_t BattMonitor::get_type() const {
+  return _type;
+}
+
+void BattMonitor::set_cells_cfg(const uint_fast8_t n) {
+  if(n == _cells_cfg || n > BATT_CELLS_MAX) {
+    return;
+  }
+  _cells_cfg = n;
+  _cells     = 0;
+  _init_volt = 0.f;
+  _init_cnt  = 0;
+}
+
+uint_fast8_t BattMonitor::get_cells_cfg() const {
+  return _cells_cfg;
+}
+
+uint_fast8_t BattMonitor::detect_cells(const float fVolt) {
+  uint_fast8_t iCells = 0;
+  for(uint_fast8_t i = 1; i <= BATT_CELLS_MAX; i++) {
+    if(fVolt < BATT_CELL_MIN_V * i || fVolt > BATT_CELL_MAX_V * i) {
+      continue;
+    }
+    // e.g. 16.8 V: A full 4S or an empty 5S pack
+    if(iCells != 0) {
+      return 0;
+    }
+    iCells = i;
+  }
+  return iCells;
+}
+
+void BattMonitor::estimate() {
+  float fVolt = voltage();
+  float fCurr = current_amps();
+
+  // Sag model: A current step causes an immediate voltage step (V = V_rest - I * R)
+  float fDCurr  = fCurr - _last_curr;
+  float fDVolt  = fVolt - _last_volt;
+  bool  bSteady = fabs(fDCurr) < BATT_R_STEADY_A && fabs(fDVolt) < BATT_R_STEADY_V;
+  // A step is only learned if the voltage was settled before and stays after it (no single noisy readout)
+  if(_step_ohm > 0.f && bSteady) {
+    _resist_ohm = SFilter::low_pass_filt_f(_step_ohm, _resist_ohm, BATT_R_FILT_f);
+  }
+  _step_ohm = 0.f;
+  if(fabs(fDCurr) >= BATT_R_MIN_DI_A && _steady_cnt >= BATT_R_STEADY_N) {
+    float fResist = -fDVolt / fDCurr;
+    if(fResist > 0.f && fResist < BATT_R_MAX_OHM) {
+      _step_ohm = fResist;
+    }
+  }
+  if(!bSteady) {
+    _steady_cnt = 0;
+  } else if(_steady_cnt < BATT_R_STEADY_N) {
+    _steady_cnt++;
+  }
+  _last_volt = fVolt;
+  _last_curr = fCurr;
+  _load_curr = SFilter::low_pass_filt_f(fCurr, _load_curr, BATT_LOAD_FILT_f);
+  _rest_volt = fVolt + fCurr * _resist_ohm;
+
+  // Initial state of charge: Average of valid readouts
+  if(_init_cnt < BATT_INIT_SAMPLES) {
+    if(_rest_volt <= BATT_MAX_VOLTAGE && _rest_volt >= BATT_MIN_VOLTAGE) {
+      _init_volt += _rest_volt;
+      _init_cnt++;
+    }
+    if(_init_cnt < BATT_INIT_SAMPLES) {
+      return;
+    }
+    _init_volt /= BATT_INIT_SAMPLES;
+    _cells      = _cells_cfg > 0 ? _cells_cfg : detect_cells(_init_volt);
+    // Guessing the count would rate a partly discharged pack as full
+    if(_cells == 0) {
+      return;
+    }
+    _init_soc   = lipo_soc_pct(_init_volt / _cells);
+    _init_mah   = current_total_mah();
+  }
+  if(_cells == 0) {
+    return;
+  }
+
+  // Coulomb counting
+  float fUsed = _pack_capacity > 0 ? (current_total_mah() - _init_mah) * 100.f / _pack_capacity : 0.f;
+  _soc = constrain_float(_init_soc - fUsed, 0.f, 100.f);
+}
+
+bool BattMonitor::estimate_ok() const {
+  return _init_cnt >= BATT_INIT_SAMPLES && _cells > 0;
+}
+
+float BattMonitor::resistance_ohm() const {
+  return _resist_ohm;
+}
+
+float BattMonitor::resting_voltage() const {
+  return _rest_volt;
+}
+
+float BattMonitor::initial_voltage() const {
+  return _init_volt;
+}
+
+float BattMonitor::load_voltage() const {
+  return _rest_volt - _load_curr * _resist_ohm;
+}
+
+float BattMonitor::soc_pct() const {
+  return _soc;
+}
+
+float BattMonitor::remaining_s() const {
+  if(!estimate_ok() || _load_curr < BATT_MIN_LOAD_A) {
+    return -1.f;
+  }
+  // mAh / A = 3.6 s
+  return _soc / 100.f * _pack_capacity / _load_curr * 3.6f;
+}
+
+uint_fast8_t BattMonitor::cells() const {
+  return _cells;
+}
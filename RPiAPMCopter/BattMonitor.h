@@ -3,6 +3,8 @@
 
 #include <AP_BattMonitor.h>
 
+#include "config.h"
+
 
 #if CONFIG_HAL_BOARD == HAL_BOARD_APM2
   // Pins for AttoPilot sensor modules for APM 2
@@ -40,7 +42,30 @@ enum BATT_SENSOR_TYPE {
  * AP_Param independent version of the battery monitor
  */
 class BattMonitor : public AP_BattMonitor {
+private:
+  int_fast8_t _type;                      // BATT_SENSOR_TYPE of the last setup_source(const int &) call
+
+  // State of charge estimation
+  float        _resist_ohm;               // Internal resistance, learned from current steps
+  float        _step_ohm;                 // Resistance of the last current step; Learned if the voltage stays settled
+  float        _last_volt;
+  float        _last_curr;
+  float        _load_curr;                // Low pass filtered current
+  float        _rest_volt;                // Voltage without load
+  float        _init_volt;                // Resting voltage at the start
+  float        _init_soc;                 // State of charge at the start (from the discharge curve)
+  float        _init_mah;                 // Consumption at the start
+  float        _soc;                      // State of charge in percent
+  uint_fast8_t _cells;                    // Zero if unknown
+  uint_fast8_t _cells_cfg;                // Configured nr. of cells; Zero: detected from the initial voltage
+  uint_fast8_t _init_cnt;
+  uint_fast8_t _steady_cnt;               // Nr. of readouts without a current or voltage step
+
+  static uint_fast8_t detect_cells(const float fVolt); // Zero if the voltage fits no or several cell counts
+
 public:
+  BattMonitor();
+
   /*
    * Changes source of battery monitor
    * Makes usage of AP_Param unnecessary
@@ -57,6 +82,32 @@ public:
    * If no proper source can be recognized, the standard settings (3DR power module) are used.
    */
   void setup_source(const int &t = ATTO180);
+
+  // Sensor type: set_type() only saves the type for a later setup_source(get_type() )
+  void set_type(const int_fast8_t t);
+  int_fast8_t get_type() const;
+
+  // Nr. of cells (0: detection); A change restarts the estimation of the initial state of charge
+  void set_cells_cfg(const uint_fast8_t n);
+  uint_fast8_t get_cells_cfg() const;
+
+  /*
+   * Must be called after each read().
+   * The initial state of charge is looked up from the discharge curve of a LiPo cell,
+   * afterwards the consumption is counted. Without a configured nr. of cells the count is detected from the initial voltage:
+   * A voltage which fits several counts is rejected, so there is no estimate until the nr. of cells is configured. The voltage sag is modelled with an internal resistance,
+   * which is learned from the voltage change of current steps between settled readouts.
+   */
+  void  estimate();
+  bool  estimate_ok() const;              // Initial state of charge and nr. of cells are known
+
+  float resistance_ohm() const;
+  float resting_voltage() const;
+  float initial_voltage() const;          // Reference for the motor compensation
+  float load_voltage() const;             // Expected voltage under the average load (no feedback of the throttle noise)
+  float soc_pct() const;
+  float remaining_s() const;              // Flight time at the average load; Negative if unknown
+  uint_fast8_t cells() const;
 };
 
 #endif
@@ -55,9 +55,19 @@ inline void load_settings();
 inline void main_loop();
 inline void inav_loop();
 inline void batt_loop();
+inline void baro_loop();
+inline void comp_loop();
+inline void gps_loop();
+inline void rf_loop();
+inline void param_loop();
 
 Task taskINAV(&inav_loop, INAV_T_MS, 1);
 Task taskRBat(&batt_loop, BATT_T_MS, 1);
+Task taskBaro(&baro_loop, BARO_T_MS, 1);
+Task taskComp(&comp_loop, COMPASS_UPDATE_T, 1);
+Task taskGPS (&gps_loop,  GPS_T_MS, 1);
+Task taskRF  (&rf_loop,   RF_T_MS, 1);
+Task taskParm(&param_loop, PARAM_T_MS, 1);
 
 // Read the battery. 
 // The voltage is used for adjusting the motor speed,
@@ -66,14 +76,33 @@ void batt_loop() {
   _HAL_BOARD.read_bat();
 }
 
+// Each sensor is read by its own task at its own rate.
+// The results are cached with a time stamp in the device,
+// so the telemetry and the controllers never trigger a readout
+void baro_loop() {
+  _HAL_BOARD.read_baro();
+}
+
+void comp_loop() {
+  _HAL_BOARD.read_comp_deg();
+}
+
+void gps_loop() {
+  _HAL_BOARD.read_gps();
+}
+
+void rf_loop() {
+  _HAL_BOARD.read_rf_cm();
+}
+
 
 // Attitude-, Altitude and Navigation control loop
 void main_loop() {
   // Limit on APM 2.5 the update rate if the 3DR radio is used,
   // Otherwise the packets are corrupted often?!
   // TODO: Maybe try out different buffer sizes on begin() at setup()
-  static uint_fast16_t timer = 0;
-  uint_fast16_t time = _HAL_BOARD.m_pHAL->scheduler->millis();
+  static uint32_t timer = 0;
+  uint32_t time = _HAL_BOARD.m_pHAL->scheduler->millis();
   
   if(time - timer >= _HAL_BOARD.get_refr_rate() ) {
     _MODEL.run();
@@ -84,81 +113,152 @@ void main_loop() {
 // Altitude estimation and AHRS system (yaw correction with GPS, barometer, ..)
 void inav_loop() {  
   _HAL_BOARD.update_inav();
-  _HAL_BOARD.read_rf_cm();
+  // Geofence check with the new position
+  _RECVR.update_fence();
+  // Gyrometer drift with the board temperature
+  _HAL_BOARD.update_gyro_tcomp();
 }
 
+// Lazy write-back of changed settings into the EEPROM
+void param_loop() {
+  _PARAM.update();
+}
+
+// PIDs, trims, battery type, compass offsets and accelerometer calibration
 void load_settings() {
-  if (!_COMP._learn.load() ) { }
-  // change the default for the AHRS_GPS_GAIN for ArduCopter
-  // if it hasn't been set by the user
-  if (!_AHRS.gps_gain.load() ) { }
-  // Setup different AHRS gains for ArduCopter than the default
-  // but allow users to override in their config
-  if (!_AHRS._kp.load() ) { }
-  if (!_AHRS._kp_yaw.load() ) { }
+  if(!_PARAM.load() ) {
+    hal.console->printf_P(PSTR("No valid settings in EEPROM: Use defaults\n"));
+  }
 }
 
-void setup() {
-  // Prepare scheduler for the main loop ..
+#if BENCH_OUT
+// Compares the ArduPilot PID class with PIDCtrl in CPU cycles per call
+void bench_pids() {
+  const uint_fast16_t iCalls       = 1000;
+  const uint32_t      iCyclesPerUs = 16;    // ATmega2560 @ 16 MHz
+  volatile float fOut = 0.f;
+
+  PID pidAP;
+  pidAP.kP(0.65); pidAP.kI(0.35); pidAP.kD(0.015); pidAP.imax(50);
+  PIDCtrl pidCtrl(0.65, 0.35, 0.015, 50);
+
+  uint32_t t32Start = hal.scheduler->micros();
+  for(uint_fast16_t i = 0; i < iCalls; i++) {
+    fOut = pidAP.get_pid(static_cast<float>(i % 64) - 32.f, 1);
+  }
+  uint32_t iAP_us = hal.scheduler->micros() - t32Start;
+
+  t32Start = hal.scheduler->micros();
+  for(uint_fast16_t i = 0; i < iCalls; i++) {
+    fOut = pidCtrl.get_pid(static_cast<float>(i % 64) - 32.f, 0.006f, 0.f, i % 2);
+  }
+  uint32_t iCtrl_us = hal.scheduler->micros() - t32Start;
+
+  hal.console->printf_P(PSTR("Benchmark - PID: %lu cycles/call, PIDCtrl: %lu cycles/call\n"),
+                      iAP_us * iCyclesPerUs / iCalls, iCtrl_us * iCyclesPerUs / iCalls);
+}
+
+// Compares the former float projection of both positions with the cached tangent plane:
+// CPU cycles per projection and maximum deviation within +/- 2 km of the origin
+void bench_nav() {
+  const uint_fast16_t iCalls       = 441;   // 21 x 21 grid
+  const uint32_t      iCyclesPerUs = 16;    // ATmega2560 @ 16 MHz
+  const int32_t       iLat0        = 480000000;  // 48 deg north
+  const int32_t       iLon0        = 110000000;  // 11 deg east
+  const float         fPerimeter_m = 40074000.f;
+  volatile float fOut = 0.f;
+
+  NavOrigin origin;
+  origin.set(iLat0, iLon0);
+
+  // Former method: Distance of both positions to the equator and to greenwich in float
+  float fMaxErr_cm = 0.f;
+  uint32_t iFloat_us = 0, iOrig_us = 0;
+  for(uint_fast16_t i = 0; i < iCalls; i++) {
+    // Grid with a spacing of ~200 m
+    int32_t iLat = iLat0 + (static_cast<int32_t>(i % 21) - 10) * 18000;
+    int32_t iLon = iLon0 + (static_cast<int32_t>(i / 21) - 10) * 27000;
+
+    uint32_t t32Start = hal.scheduler->micros();
+    float fLat0 = iLat0 / 10000000.f, fLon0 = iLon0 / 10000000.f;
+    float fLat  = iLat  / 10000000.f, fLon  = iLon  / 10000000.f;
+    float fX0   = fPerimeter_m * cos(ToRad(fLat0) ) / 360.f * fLon0;
+    float fY0   = fPerimeter_m / 360.f * fLat0;
+    float fX    = fPerimeter_m * cos(ToRad(fLat) ) / 360.f * fLon;
+    float fY    = fPerimeter_m / 360.f * fLat;
+    fOut = fX - fX0 + fY - fY0;
+    iFloat_us += hal.scheduler->micros() - t32Start;
+
+    int32_t iN_cm, iE_cm;
+    t32Start = hal.scheduler->micros();
+    origin.to_cm(iLat, iLon, iN_cm, iE_cm);
+    iOrig_us += hal.scheduler->micros() - t32Start;
+
+    float fErr_cm = fabs( (fY - fY0) * 100.f - iN_cm) + fabs( (fX - fX0) * 100.f - iE_cm);
+    fMaxErr_cm = fErr_cm > fMaxErr_cm ? fErr_cm : fMaxErr_cm;
+  }
+
+  hal.console->printf_P(PSTR("Benchmark - float projection: %lu cycles/call, NavOrigin: %lu cycles/call, max. deviation: %.1f cm\n"),
+                      iFloat_us * iCyclesPerUs / iCalls, iOrig_us * iCyclesPerUs / iCalls, fMaxErr_cm);
+}
+#endif
+
+// These tasks need initialized sensors and are added by the boot sequence
+void add_sensor_tasks() {
   _SCHED.add_task(&taskINAV, 0);  // Inertial, GPS, Compass, Barometer sensor fusions (slow) ==> running at 50 Hz
   _SCHED.add_task(&taskRBat, 0);
-  // .. and the sensor output functions
+  _SCHED.add_task(&taskBaro, 0);
+  _SCHED.add_task(&taskComp, 0);
+  _SCHED.add_task(&taskGPS,  0);
+  _SCHED.add_task(&taskRF,   0);
+  // .. and the sensor output functions (only reading the cached values)
   _SCHED.add_task(&outAtti,  50);
   _SCHED.add_task(&outBaro,  500);
   _SCHED.add_task(&outBat,   750);
   _SCHED.add_task(&outGPS,   1000);
   _SCHED.add_task(&outComp,  1500);
+  _SCHED.add_task(&outLoop,  0);
+}
+
+void setup() {
+  // Prepare scheduler: These tasks work without sensors ..
+  _SCHED.add_task(&taskParm, 0);
   _SCHED.add_task(&outPIDAtt,2000);
   _SCHED.add_task(&outPIDAlt,2000);
+#if USE_MAVLINK
+  _SCHED.add_task(&outMAV,   0);   // MAVLink streams and parameters of both ports
+#endif
 
-  // Wait for one second
-  hal.scheduler->delay(1000);
   // Set baud rate when connected to RPi
   hal.uartA->begin(BAUD_RATE_A, 256, 256);  // USB
   hal.uartB->begin(BAUD_RATE_B, 256, 16);   // GPS
   hal.uartC->begin(BAUD_RATE_C, 128, 128);  // RADIO
+#if USE_MAVLINK
+  _MAVCOM.init();
+#endif
   
-  hal.console->printf("Setup device ..\n");
+  hal.console->printf_P(PSTR("Setup device ..\n"));
 
-  // Enable the motors and set at 490Hz update
-  hal.console->printf("%.1f%%: Set ESC refresh rate to 490 Hz\n", progress_f(1, 10) );
+  // Enable the motors and set the ESC refresh rate
+  hal.console->printf_P(PSTR("Set ESC refresh rate to %d Hz\n"), MOTOR_PWM_HZ);
   for(uint_fast16_t i = 0; i < 8; i++) {
     hal.rcout->enable_ch(i);
   }
-  hal.rcout->set_freq(0xFF, 490);
+  hal.rcout->set_freq(0xFF, MOTOR_PWM_HZ);
 
   // PID Configuration
-  hal.console->printf("%.1f%%: Set PID configuration\n", progress_f(2, 10) );
+  hal.console->printf_P(PSTR("Set PID configuration\n"));
   _HAL_BOARD.init_pids();
+#if BENCH_OUT
+  bench_pids();
+  bench_nav();
+#endif
 
   // Load settings from EEPROM
-  hal.console->printf("%.1f%%: Load settings from EEPROM\n", progress_f(3, 10) );
-  //load_settings();
-  
-  hal.console->printf("%.1f%%: Init barometer\n", progress_f(4, 10) );
-  _HAL_BOARD.init_barometer();
-
-  hal.console->printf("%.1f%%: Init inertial sensor\n", progress_f(5, 10) );
-  _HAL_BOARD.init_inertial();
-
-  // Compass initializing
-  hal.console->printf("\n%.1f%%: Init compass: ", progress_f(6, 10) );
-  _HAL_BOARD.init_compass();
-
-  // GPS initializing
-  hal.console->printf("%.1f%%: Init GPS", progress_f(7, 10) );
-  //_HAL_BOARD.init_gps();
+  hal.console->printf_P(PSTR("Load settings from EEPROM\n"));
+  load_settings();
 
-  // battery monitor initializing
-  hal.console->printf("\n%.1f%%: Init battery monitor\n", progress_f(8, 10) );
-  _HAL_BOARD.init_batterymon();
-
-  // battery monitor initializing
-  hal.console->printf("%.1f%%: Init range finder\n", progress_f(9, 10) );
-  //_HAL_BOARD.init_rf();
-
-  hal.console->printf("%.1f%%: Init inertial navigation\n", progress_f(10, 10) );
-  _HAL_BOARD.init_inertial_nav();
+  // The sensors are initialized by the boot sequence in loop()
 }
 
 void loop() {
@@ -166,6 +266,14 @@ void loop() {
   _RECVR.try_any();
   // send some json formatted information about the model over serial port
   _SCHED.run(); // Wrote my own small and absolutely fair scheduler
+
+  // Staged boot: The motors stay off until all sensors are ready
+  if(_BOOT.get_state() != BootSeq::READY_S) {
+    if(_BOOT.run() ) {
+      add_sensor_tasks();
+    }
+    return;
+  }
   // Don't use the scheduler for the time critical main loop (~20% faster)
   main_loop();
 }
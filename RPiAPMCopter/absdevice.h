@@ -20,7 +20,8 @@ public:
     VOLTAGE_LOW_F     = 1 << 7, // 128
     CURRENT_HIGH_F    = 1 << 8, // 256
     CURRENT_LOW_F     = 1 << 9, // 512
-    UART_TIMEOUT_F    = 1 << 10 // 1024
+    UART_TIMEOUT_F    = 1 << 10,// 1024
+    GEOFENCE_F        = 1 << 11 // 2048
   };
 
 protected:
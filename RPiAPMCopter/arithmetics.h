@@ -4,12 +4,32 @@
 #include "config.h"
 
 
-inline bool in_range(int_fast16_t iMin, int_fast16_t iMax, int_fast16_t iVal) {
-  return iVal > iMax ? false : iVal < iMin ? false : true;
+/*
+ * Time differences of the 32 bit micros() counter.
+ * The unsigned subtraction stays valid across the overflow (every ~71.6 min),
+ * as long as the interval is shorter than the overflow period.
+ *
+ * Integrators, filters and the take down timers use micros() (the time stamp of the sensor frame).
+ * The time-outs which measure "time since the last event" stay on millis() on purpose:
+ * - Receiver: m_iSParseTimer*, last_parse_*_t32(), m_t32RadioV2, m_t32FenceOut
+ * - Device::update_health() and mark_update()
+ * - MAVCom::is_active() and stream_due()
+ * Such an interval is unbounded (e.g. a sensor which never recovers, a link which never came up),
+ * so with micros() it would wrap after ~71.6 min and an old event would look fresh again.
+ * millis() wraps after ~49.7 days, and a resolution of 1 ms is enough for time-outs of 100 ms and more.
+ * Periodic jobs which don't integrate anything (barometer calibration, learning of the gyrometer offsets,
+ * debug output) also stay on millis().
+ */
+inline uint32_t dt_us(uint32_t t32Now_us, uint32_t t32Last_us) {
+  return t32Now_us - t32Last_us;
+}
+
+inline float dt_s(uint32_t t32Now_us, uint32_t t32Last_us) {
+  return static_cast<float>(t32Now_us - t32Last_us) / 1000000.f;
 }
 
-inline double progress_f(uint_fast8_t iStep, uint_fast8_t iMax) {
-  return static_cast<double>(iStep) * 100.f / static_cast<double>(iMax);
+inline bool in_range(int_fast16_t iMin, int_fast16_t iMax, int_fast16_t iVal) {
+  return iVal > iMax ? false : iVal < iMin ? false : true;
 }
 
 inline int add_flag(int flag, int mask) {
@@ -82,4 +102,31 @@ inline float bigger_f(float value, float bias) {
   return value > bias ? value : bias;
 }
 
+// CRC-16-CCITT (polynomial 0x1021), bitwise to save flash
+inline uint_fast16_t crc16_ccitt(const uint8_t *pData, size_t iLen, uint_fast16_t iCRC = 0xFFFF) {
+  for(size_t i = 0; i < iLen; i++) {
+    iCRC ^= static_cast<uint_fast16_t>(pData[i]) << 8;
+    for(uint_fast8_t j = 0; j < 8; j++) {
+      iCRC = iCRC & 0x8000 ? (iCRC << 1) ^ 0x1021 : iCRC << 1;
+    }
+  }
+  return iCRC & 0xFFFF;
+}
+
+// Multiplication with the generator 2 in GF(256) (polynomial 0x11D)
+inline uint8_t gf256_mul2(const uint8_t iVal) {
+  return iVal & 0x80 ? (iVal << 1) ^ 0x1D : iVal << 1;
+}
+
+// CRC-8 (polynomial 0x07), bitwise to save flash
+inline uint8_t crc8(const uint8_t *pData, size_t iLen, uint8_t iCRC = 0x00) {
+  for(size_t i = 0; i < iLen; i++) {
+    iCRC ^= pData[i];
+    for(uint_fast8_t j = 0; j < 8; j++) {
+      iCRC = iCRC & 0x80 ? (iCRC << 1) ^ 0x07 : iCRC << 1;
+    }
+  }
+  return iCRC;
+}
+
 #endif
@@ -0,0 +1,61 @@
+#include "boot.h"
+#include "device.h"
+
+
+BootSeq::BootSeq(Device *pDev) {
+  m_pHalBoard = pDev;
+  m_eState    = BARO_INIT_S;
+  m_t32Ready  = 0;
+}
+
+bool BootSeq::run() {
+  switch(m_eState) {
+    case BARO_INIT_S:
+      m_pHalBoard->m_pHAL->console->printf_P(PSTR("Boot: Init barometer\n"));
+      m_pHalBoard->init_barometer();
+      m_eState = INERT_INIT_S;
+      break;
+    case INERT_INIT_S:
+      m_pHalBoard->m_pHAL->console->printf_P(PSTR("Boot: Init inertial sensor\n"));
+      m_pHalBoard->init_inertial();
+      m_eState = COMP_INIT_S;
+      break;
+    case COMP_INIT_S:
+      m_pHalBoard->m_pHAL->console->printf_P(PSTR("Boot: Init compass\n"));
+      m_pHalBoard->init_compass();
+      m_eState = BATT_INIT_S;
+      break;
+    case BATT_INIT_S:
+      m_pHalBoard->m_pHAL->console->printf_P(PSTR("Boot: Init battery monitor\n"));
+      m_pHalBoard->init_batterymon();
+      // GPS and range finder are not in use yet
+      //m_pHalBoard->init_gps();
+      //m_pHalBoard->init_rf();
+      m_eState = CALIBRATE_S;
+      break;
+    case CALIBRATE_S:
+      // Both calibrations must get their slice in every call
+      if(m_pHalBoard->calib_barometer() & m_pHalBoard->calib_gyrometer() ) {
+        m_eState = INAV_INIT_S;
+      }
+      break;
+    case INAV_INIT_S:
+      m_pHalBoard->m_pHAL->console->printf_P(PSTR("Boot: Init inertial navigation\n"));
+      m_pHalBoard->init_inertial_nav();
+      m_t32Ready = m_pHalBoard->m_pHAL->scheduler->millis();
+      m_pHalBoard->m_pHAL->console->printf_P(PSTR("Boot: Ready after %lu ms\n"), static_cast<unsigned long>(m_t32Ready) );
+      m_eState = READY_S;
+      break;
+    case READY_S:
+      break;
+  }
+  return m_eState == READY_S;
+}
+
+BootSeq::BOOT_STATE BootSeq::get_state() const {
+  return m_eState;
+}
+
+uint_fast32_t BootSeq::get_ready_ms() const {
+  return m_t32Ready;
+}
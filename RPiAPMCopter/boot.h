@@ -0,0 +1,44 @@
+#ifndef BOOT_h
+#define BOOT_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+
+class Device;
+
+
+/*
+ * Non-blocking boot sequence:
+ * Each call of run() executes only one small slice,
+ * so the receiver and the telemetry keep working while the sensors come up.
+ */
+class BootSeq {
+public:
+  enum BOOT_STATE {
+    BARO_INIT_S = 0,
+    INERT_INIT_S,
+    COMP_INIT_S,
+    BATT_INIT_S,
+    CALIBRATE_S,                      // Barometer and gyrometer are calibrated side by side
+    INAV_INIT_S,
+    READY_S
+  };
+
+private:
+  Device       *m_pHalBoard;
+  BOOT_STATE    m_eState;
+  uint_fast32_t m_t32Ready;           // Time from power-on until READY_S in ms
+
+public:
+  BootSeq(Device *);
+
+  // Executes one slice of the boot sequence. Returns true if all sensors are ready
+  bool          run();
+
+  BOOT_STATE    get_state() const;
+  uint_fast32_t get_ready_ms() const;
+};
+
+#endif /*BOOT_h*/
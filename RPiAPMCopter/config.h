@@ -34,13 +34,44 @@
 #define BATT_MAX_VOLTAGE     25.2   // 6 cells @ 3.7 V
 #define BATT_T_MS            100
 
+// State of charge estimation: Coulomb counting with a sag model (resting voltage = voltage + current * internal resistance)
+#define BATT_INIT_SAMPLES    25     // Nr. of valid readouts for the initial resting voltage and the initial state of charge
+#define BATT_R_INIT_OHM      0.02f  // Internal resistance until it is learned in flight
+#define BATT_R_MAX_OHM       0.25f  // Larger resistance samples are rejected (noise)
+#define BATT_R_MIN_DI_A      2.f    // Minimum current step between two readouts for learning the resistance
+#define BATT_R_STEADY_A      0.5f   // Readouts with a smaller current change ..
+#define BATT_R_STEADY_V      0.05f  // .. and a smaller voltage change are settled
+#define BATT_R_STEADY_N      3      // Nr. of settled readouts before a current step (and one after it) for learning the resistance
+#define BATT_R_FILT_f        0.1f   // Filter constant of the internal resistance
+#define BATT_LOAD_FILT_f     0.05f  // Filter constant of the average current (~2 s at BATT_T_MS)
+#define BATT_MIN_LOAD_A      1.f    // Below this current no remaining flight time is predicted
+#define BATT_CELL_MAX_V      4.25f  // For the detection of the nr. of cells
+#define BATT_CELL_MIN_V      3.3f   // Lowest resting voltage per cell at the start (0 % state of charge)
+#define BATT_CELLS_MAX       6      // Packs which fit two cell counts (e.g. a full 4S or an empty 5S) must be configured (BAT#type,cells)
+#define BATT_CELL_LOW_V      3.5f   // Resting voltage per cell for VOLTAGE_LOW_F
+#define BATT_SOC_CRIT_PCT    10.f   // State of charge for CURRENT_LOW_F (model is taken down)
+#define BATT_RESERVE_S       30.f   // Remaining flight time for CURRENT_LOW_F
+#define BATT_COMP_MAX        1.3f   // Maximum throttle compensation of the voltage sag
+#define TILT_COMP_MAX        1.5f   // Maximum throttle compensation of the measured tilt (~48 deg bank)
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Parameter storage (EEPROM)
+//////////////////////////////////////////////////////////////////////////////////////////
+#define PARAM_EEPROM_OFFS    2048   // Start of the parameter block in the 4 kB EEPROM; The lower half is left to AP_Param
+#define PARAM_MAGIC          0x5250 // "RP"
+#define PARAM_VERSION        7      // Increment if the layout of ParamData changes. Old blocks are then rejected
+#define PARAM_VERSION_PID_ID 6      // Same layout as version 7, loaded without the I and D gains of the attitude and altitude PIDs
+#define PARAM_T_MS           20     // Write-back tick: At most one EEPROM byte is written per tick (~3.4 ms per byte on the ATmega2560)
+#define PARAM_CMP_PER_T      32     // Maximum number of bytes compared with the EEPROM per tick
+#define PARAM_CHECK_T_MS     1000   // Interval for looking up changed settings
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // General settings
 //////////////////////////////////////////////////////////////////////////////////////////
 #define DEBUG_OUT            0
 #define BENCH_OUT            0
 
-#define NR_OF_PIDS           10
+#define NR_OF_PIDS           12
 // PID indices
 #define PID_PIT_RATE         0      // From Dr. Owen..
 #define PID_ROL_RATE         1
@@ -53,6 +84,13 @@
 #define PID_THR_STAB         7      // For my altitude hold implementation
 #define PID_ACC_RATE         8      // For my altitude hold implementation
 #define PID_ACC_STAB         9      // For my altitude hold implementation
+// GPS navigation
+#define PID_NAV_RATE         10     // Horizontal velocity error (cm/s) to acceleration (cm/s^2); Gains shared by the north and east axis
+#define PID_NAV_STAB         11     // Horizontal position error (cm) to velocity (cm/s); Only kP is used
+
+#define PID_D_FILT_HZ        20.f   // Default cut-off frequency of the derivative low pass filter
+#define PID_MAX_DT_S         1.f    // Longer time steps reset the integrator (e.g. first call after landing)
+
 
 // Motor numbers definitions for X configuration
 #define MOTOR_FR             0      // Front right  (CW)
@@ -60,12 +98,22 @@
 #define MOTOR_FL             2      // Front left   (CCW)
 #define MOTOR_BR             3      // back right   (CCW)
 
+// ESC output
+#define MOTOR_CNT            4      // The motors use the output channels 0 .. MOTOR_CNT-1 and are written with one call
+#define MOTOR_PWM_HZ         490    // ESC refresh rate; The period must be longer than the longest pulse (RC_THR_MAX)
+#define MOTOR_SYNC_EDGE      1      // APM2 only: Start a new PWM period right after the motors were written, instead of waiting for the running one
+#define MOTOR_THR_LIN        1      // Thrust linearization with the per motor curves in thrustlut.h (fitted by misc/thrust_stand/ThrustFit.py)
+
 // Radio min/max values for each stick for my radio (worked out at beginning of article)
 #define RC_THR_OFF           1000   // Motors completely off
 #define RC_THR_ACRO          1225   // Minimum throttle to begin with stabilization
 #define RC_THR_MAX           2000   // Maximum throttle bias
 #define RC_THR_80P           1675   // Maximum allowed throttle value, settable by user
 
+#if 1000000UL / MOTOR_PWM_HZ <= RC_THR_MAX
+  #error "MOTOR_PWM_HZ is too high: The PWM period must be longer than RC_THR_MAX"
+#endif
+
 // Degree range for remote control
 #define RC_YAW_MIN           -180
 #define RC_YAW_MAX           +180
@@ -87,7 +135,11 @@
 #define MAIN_T_MS            0      // Update frequency of the main loop: ~150.0-160 Hz is the current maximum
 #define FALB_T_MS            15     // Update frequency of the main loop: ~66,6 Hz
 #define INAV_T_MS            20     // Update frequency: 50 Hz - Only important for auto navigation system
+#define BARO_T_MS            50     // Barometer readout: 20 Hz (the MS5611 accumulates at ~50 Hz in the timer process)
+#define GPS_T_MS             20     // GPS parser: 50 Hz to keep the 16 byte receive buffer of uartB from overflowing
+#define RF_T_MS              50     // Range finder readout: 20 Hz
 #define INERT_TIMEOUT        10     // in ms
+#define LOOP_STATS_T_MS      1000   // Window of the loop timing statistics
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Scheduler module
@@ -103,6 +155,13 @@
 #define RC_YAW               3
 
 #define RADIO_MAX_OFFS       7      // Maximum length of command message via radio without stop bit
+#define RADIO_V2_PAYLOAD     6      // Frame v2: 10 bit throttle, 8 bit pitch and roll, 10 bit yaw, 4 aux switches, 2 mode bits, 6 bit sequence number
+#define RADIO_V2_LEN         8      // Frame v2 as received: COBS overhead byte, payload and CRC-8, without the zero delimiter
+#define RADIO_V2_DEG_SCALE   2      // Frame v2: Channel steps per degree of pitch, roll and yaw (centered in the range of the field)
+#define RADIO_V2_SEQ_BITS    6      // Frame v2: Must not wrap within COM_PKT_TIMEOUT at the line rate, so lost frames are counted exactly
+#define RADIO_V2_LOCK_MS     1000   // Frames v1 are ignored for this time after a valid frame v2
+#define RADIO_V2_FEC         1      // Also accept frames v2 with two Reed-Solomon check bytes: One corrupted byte is corrected (the sender chooses; At the line rate the two bytes cost more frames than they save)
+#define RADIO_V2_FEC_LEN     10     // Frame v2 with check bytes as received: COBS encoded frame and two check bytes over it, without the zero delimiter
 #define APM_IOCHAN_CNT 	     8
 
 #define USE_RCIN             0      // This firmware is not using any PPM radio as default
@@ -110,20 +169,63 @@
 #define USE_UART_C           1      // And this is the fall-back option (3DR Radio 433 or 900 MHz)
 
 #define COM_PKT_TIMEOUT      500    // Time-out in ms; If the time-out is triggered the machine will go down
+#if BAUD_RATE_C / 10 * COM_PKT_TIMEOUT / 1000 / (RADIO_V2_LEN + 1) >= (1 << RADIO_V2_SEQ_BITS)
+  #error "RADIO_V2_SEQ_BITS is too small: The sequence number of frame v2 wraps within COM_PKT_TIMEOUT"
+#endif
 #define RCIN_TIMEOUT         200    // Time-out of the ppm radio in ms; If time-out is triggered the firmware tries to receive packets via the USB port on uartA
 #define UART_A_TIMEOUT       250    // Time-out of the console serial port in ms; If time-out is triggered the firmware tries to receive packets via the 3DR radio on uartC
 
-#define PID_ARGS             6      // Nr of arguments for PID configuration
+#define RC_SETP_CNT          4      // Nr. of interpolated channels: roll, pitch, throttle and yaw
+#define RC_SETP_MODE         1      // Set points between two RC packets: 0 = last packet (staircase), 1 = interpolated (delayed by one packet), 2 = extrapolated
+#define RC_SETP_HORIZON_MS   20     // Maximum prediction of the extrapolation
+#define RC_SETP_MAX_GAP_MS   100    // Packets further apart are not interpolated, but the set point jumps
+#define RC_SETP_SMOOTH_f     0.5f   // Low pass filter constant of the set points (1.0 = off)
+
+#define RC_EXPO_AXES         2      // Stick curves for roll/pitch and yaw
+#define RC_EXPO_LUT_S        17     // Nr. of points of a stick curve (16 linear interpolated segments)
+#define RC_EXPO_ONE          1024   // Full stick deflection in the tables
+#define RC_SUPER_MAX         90     // Maximum super rate in percent
+
+#define PID_ARGS             7      // Nr of arguments for PID configuration (the last group, navigation, is optional)
+#define EXPO_ARGS            4      // Nr. of arguments for the stick curves
 #define PID_BUFFER_S         5
 
 #define COMP_ARGS            4      // Nr. of arguments for on-flight drift compensation
 #define GPSP_ARGS            4      // Nr. of arguments for GPSPosition structure
+#define MISN_ARGS            6      // Nr. of arguments for a mission item: GPSPosition plus index and length of the mission
+#define FENC_ARGS            5      // Nr. of arguments for a geofence vertex: latitude, longitude, ceiling, index and nr. of vertices
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// MAVLink telemetry
+//////////////////////////////////////////////////////////////////////////////////////////
+#define USE_MAVLINK          1      // MAVLink v1 on uartA and uartC: A port switches into the MAVLink mode with the first HEARTBEAT of a ground station
+#define MAV_CHAN_CNT         2      // MAVLINK_COMM_0 (uartA) and MAVLINK_COMM_1 (uartC)
+#define MAV_SYSTEM_ID        1      // System id of the model
+#define MAV_COMP_ID          1      // MAV_COMP_ID_AUTOPILOT1
+#define MAV_LOCK_MS          3000   // A port falls back to the text and radio commands after this time without a MAVLink message
+#define MAV_T_MS             10     // Interval of the stream task
+#define MAV_RATE_MAX_HZ      50     // Highest stream rate which can be requested
+#define MAV_RATE_STATUS_HZ   2      // Default rates of the streams (changed by REQUEST_DATA_STREAM)
+#define MAV_RATE_RC_HZ       2
+#define MAV_RATE_ATTI_HZ     10
+#define MAV_PID_GAINS        6      // Parameters per PID: P, I, D, FF, FILT, IMAX
+#define MAV_PARAM_CNT        (NR_OF_PIDS * MAV_PID_GAINS + 2) // PID gains and the trims of roll and pitch
+
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Device module
 //////////////////////////////////////////////////////////////////////////////////////////
 #define INERT_FUSION_RATE    4.5f   // Sensor fusion rate: higher => faster annealing
 
+#define BAROM_CAL_T_MS       100    // Interval between two barometer readouts during the calibration
+#define BAROM_CAL_SAMPLES    15     // Nr. of readouts until the ground pressure is set (the MS5611 needs ~1 s to settle)
+#define INERT_GYRO_CAL_S     200    // Nr. of gyrometer samples per calibration window (1 s at 200 Hz)
+#define INERT_GYRO_CAL_TOL   0.1f   // Maximum difference (deg/s) of two calibration windows; Otherwise the model was moved
+#define INERT_TCOMP_BINS     8      // Nr. of board temperature bins for the learned gyrometer offsets (max. 8, see bit mask)
+#define INERT_TCOMP_MIN_DEG  0.f    // Lower bound of the first temperature bin in degree Celsius
+#define INERT_TCOMP_STEP_DEG 5.f    // Width of a temperature bin in degree Celsius
+#define INERT_TCOMP_T_MS     1000   // Update interval of the in-flight temperature compensation
+
 #define BAROM_LOWPATH_FILT_f 0.35f  // Filter constant for the barometer
 #define COMPA_LOWPATH_FILT_f 0.25f  // Filter constant for the compass
 #define INERT_LOWPATH_FILT_f 0.15f  // Filter constant for the accelerometer
@@ -134,8 +236,19 @@
 
 #define INERT_G_CONST        9.81f
 
+// Altitude Kalman filter: altitude, climb rate and accelerometer bias
+#define ALT_KF_ACC_SIGMA     50.f   // Noise of the vertical acceleration in cm/s
+#define ALT_KF_BIAS_SIGMA    2.f    // Random walk of the accelerometer bias in cm/s per sqrt(s)
+#define ALT_KF_BARO_SIGMA    60.f   // Noise of the barometer altitude in cm
+#define ALT_KF_RF_SIGMA      5.f    // Noise of the range finder in cm
+#define ALT_KF_RF_FADE_CM    500    // Above this distance the range finder is faded out until AP_RANGE_FINDER_MAXSONARI2CXL_MAX_DISTANCE
+#define ALT_KF_OFFS_FILT_f   0.05f  // Filter constant of the barometer offset, learned while the range finder is usable
+#define ALT_KF_GATE          5.f    // Innovations larger than ALT_KF_GATE sigma are rejected as outliers
+#define ALT_KF_REJECT_MAX    10     // After this nr. of consecutive outliers the filter follows the sensor again
+#define ALT_KF_MAX_DT_S      0.1f   // Longer time steps are not predicted
+
 #define SIGM_FOR_ATTITUDE    1      // A little bit slower than standard method, but anneals faster to accelerometer in valid angle range (0-60)
-#define COMPASS_UPDATE_T     100
+#define COMPASS_UPDATE_T     100    // Compass readout: 10 Hz
 
 #define RANGE_FINDER_PIN     13
 #define RANGE_FINDER_SCALE   1.0f
@@ -150,15 +263,42 @@
 #define THR_MIN_STEP_S       25.f
 #define MAX_FALL_SPEED_MS    0.833f
 
+// Sensor health monitor: A sensor is faulty without updates (stale) or if the value does not change anymore (frozen)
+#define HLT_RATE_T_MS        1000   // Window of the update rate statistics
+#define HLT_CLEAR_MS         1000   // A fault flag is cleared after this time without new faults (hysteresis)
+#define HLT_INERT_STALE_MS   100
+#define HLT_INERT_FROZEN_MS  500    // The gyrometer noise changes the readout in every sample
+#define HLT_BARO_STALE_MS    500
+#define HLT_BARO_FROZEN_MS   2000
+#define HLT_COMP_STALE_MS    500
+#define HLT_GPS_STALE_MS     1500   // Time without a new fix
+#define HLT_BATT_STALE_MS    1000
+#define HLT_RF_STALE_MS      500
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Auto navigation
 //////////////////////////////////////////////////////////////////////////////////////////
-#define MAX_YAW              15
-#define MAX_PIT              15
-#define YAW_ZERO_SLOPE       25.f
-#define YAW_ZERO_MOD         5.0f
-#define YAW_CTRL_SLOPE       5.0f
-#define YAW_CTRL_MOD         1.0f
-#define YAW_ERROR_RATE       5.0f
+#define MAX_YAW              15     // Maximum yaw rate of the navigation (deg/s)
+#define MAX_PIT              15     // Maximum pitch and roll set point of the position controller
+// Jerk limited set points (S-curves)
+#define YAW_ACC_MAX          30.f   // Heading: deg/s^2
+#define YAW_JERK_MAX         120.f  // Heading: deg/s^3
+#define ALT_VEL_MAX_CMS      100.f  // Altitude hold: Climb/sink rate towards a new target altitude
+#define ALT_ACC_MAX_CMSS     100.f
+#define ALT_JERK_MAX_CMSSS   400.f
+
+#define MISSION_MAX_WP       12     // Size of the way point table (30 byte per way point)
+#define MISSION_ARRIVE_CM    300    // Way point reached if the remaining distance along the leg is smaller
+#define MISSION_XTRACK_DEG_M 2.f    // Course correction in degree per meter distance to the leg
+#define MISSION_XTRACK_MAX   45.f   // Maximum course correction in degree
+#define MISSION_MAX_ERR_DEG  10.f   // No speed along the leg if the heading error is larger
+
+#define NAV_VEL_MAX_CMS      500.f  // Maximum horizontal speed
+#define NAV_ACC_MAX_CMSS     200.f  // Acceleration along the leg (braking towards the last way point)
+#define NAV_JERK_MAX_CMSSS   400.f
+
+#define FENCE_MAX_PTS        8      // Maximum nr. of polygon vertices (16 byte per vertex)
+#define FENCE_NEAR_CM        300    // Edges closer than this are re-evaluated at each check; Must be larger than the distance flown in INAV_T_MS
+#define FENCE_HOLD_MS        3000   // After a breach the model must be inside for this time before the take down ends (no toggling at the edge or the ceiling)
 
 #endif /*DEFS_h*/
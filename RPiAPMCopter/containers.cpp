@@ -7,6 +7,12 @@ BaroData::BaroData() {
   temperature_deg  = 0;
   climb_rate_cms   = 0;
   pressure_samples = 0;
+  timestamp_ms     = 0;
+}
+
+CompData::CompData() {
+  heading_deg      = 0.f;
+  timestamp_ms     = 0;
 }
 
 GPSData::GPSData() {
@@ -22,6 +28,7 @@ GPSData::GPSData() {
   gcourse_cd  = 0;
   time_week   = 0;
   time_week_s = 0.f;
+  timestamp_ms = 0;
 }
 
 GPSPosition::GPSPosition() {
@@ -46,4 +53,42 @@ BattData::BattData() {
   current_A    = 0.f;
   consumpt_mAh = 0.f;
   power_W      = 0.f;
+  rest_V       = 0.f;
+  resist_Ohm   = 0.f;
+  load_V       = 0.f;
+  soc_pct      = 0.f;
+  remain_s     = -1.f;
+  timestamp_ms = 0;
+}
+
+SensorFrame::SensorFrame() {
+  atti_deg       = Vector3f(0.f, 0.f, 0.f);
+  gyro_deg       = Vector3f(0.f, 0.f, 0.f);
+  accel_g        = Vector3f(0.f, 0.f, 0.f);
+  altitude_cm    = 0.f;
+  climb_rate_cms = 0.f;
+  heading_deg    = 0.f;
+  voltage_V      = 0.f;
+  refVoltage_V   = 0.f;
+  loadVoltage_V  = 0.f;
+  valid          = NOTHING_F;
+  timestamp_us   = 0;
+  dt_s           = 0.f;
+}
+
+LoopStats::LoopStats() {
+  min_us         = 0;
+  max_us         = 0;
+  avg_us         = 0;
+  iterations     = 0;
+}
+
+SensorHealth::SensorHealth() {
+  update_ms      = 0;
+  change_ms      = 0;
+  fault_ms       = 0;
+  updates        = 0;
+  changes        = 0;
+  update_hz      = 0;
+  change_hz      = 0;
 }
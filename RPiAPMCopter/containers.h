@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <AP_Math.h>
+
 
 // barometer data container
 struct BaroData {
@@ -12,10 +14,19 @@ struct BaroData {
   float         temperature_deg;
   int_fast16_t  climb_rate_cms;
   uint_fast8_t  pressure_samples;
+  uint_fast32_t timestamp_ms; // time of the last valid readout
 
   BaroData();
 };
 
+// compass data container
+struct CompData {
+  float         heading_deg;
+  uint_fast32_t timestamp_ms; // time of the last valid readout
+
+  CompData();
+};
+
 // gps data container
 struct GPSData {
   uint_fast8_t  satelites;
@@ -30,6 +41,7 @@ struct GPSData {
   int_fast32_t  gcourse_cd;   // ground course in degree
   uint_fast16_t time_week;
   float  time_week_s;
+  uint_fast32_t timestamp_ms; // time of the last readout with fix
 
   GPSData();
 };
@@ -59,8 +71,68 @@ struct BattData {
   float current_A;
   float power_W;
   float consumpt_mAh;
+  // Estimation (BattMonitor::estimate())
+  float rest_V;               // Voltage without load
+  float resist_Ohm;           // Internal resistance
+  float load_V;               // Expected voltage under the average load
+  float soc_pct;              // State of charge
+  float remain_s;             // Remaining flight time at the average load; Negative if unknown
+  uint_fast32_t timestamp_ms; // time of the last readout
 
   BattData();
 };
 
+// Snapshot of all sensor values needed by the controllers.
+// Published once per iteration of the main loop by Device::update_frame(),
+// so all consumers work with the same values of the same iteration
+struct SensorFrame {
+  enum VALID_FLAGS {
+    NOTHING_F  = 0,
+    ATTITUDE_F = 1 << 0,  // Attitude and rates from a healthy inertial sensor
+    ACCEL_F    = 1 << 1,  // Attitude within INERT_ANGLE_BIAS, so accel_g is usable
+    ALTITUDE_F = 1 << 2,  // altitude_cm is usable
+    COMPASS_F  = 1 << 3,  // heading_deg is usable
+    BATTERY_F  = 1 << 4   // Reference voltage is determined
+  };
+
+  // x = pitch, y = roll, z = yaw
+  Vector3f      atti_deg;        // Fused attitude with trims
+  Vector3f      gyro_deg;        // Rates with trims
+  Vector3f      accel_g;         // Low pass filtered acceleration without G-const. in g
+  float         altitude_cm;
+  float         climb_rate_cms;
+  float         heading_deg;
+  float         voltage_V;
+  float         refVoltage_V;
+  float         loadVoltage_V;   // Expected voltage under the average load
+  uint_fast8_t  valid;           // VALID_FLAGS
+  uint32_t      timestamp_us;    // micros() at the time of the publication
+  float         dt_s;            // Time since the previous frame
+
+  SensorFrame();
+};
+
+// Timing of the main loop
+struct LoopStats {
+  uint32_t      min_us;          // Shortest iteration of the last window (LOOP_STATS_T_MS)
+  uint32_t      max_us;          // Longest iteration of the last window
+  uint32_t      avg_us;          // Mean duration of an iteration
+  uint_fast16_t iterations;      // Nr. of iterations in the last window
+
+  LoopStats();
+};
+
+// Update statistics of one sensor for the health monitor (Device::update_health())
+struct SensorHealth {
+  uint32_t      update_ms;       // Last update of the sensor
+  uint32_t      change_ms;       // Last change of the readout
+  uint32_t      fault_ms;        // Last fault (reported by the driver, stale or frozen)
+  uint16_t      updates;         // Nr. of updates in the current window (HLT_RATE_T_MS)
+  uint16_t      changes;         // Nr. of changes in the current window
+  uint8_t       update_hz;       // Update rate of the last window
+  uint8_t       change_hz;       // Rate of the changes of the last window
+
+  SensorHealth();
+};
+
 #endif
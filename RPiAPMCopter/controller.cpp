@@ -0,0 +1,122 @@
+#include <AP_Math.h>
+
+#include "controller.h"
+#include "arithmetics.h"
+
+
+///////////////////////////////////////////////////////////
+// PIDCtrl
+///////////////////////////////////////////////////////////
+PIDCtrl::PIDCtrl(const float fKP, const float fKI, const float fKD, const int16_t iIMax) {
+  m_fKP         = fKP;
+  m_fKI         = fKI;
+  m_fKD         = fKD;
+  m_fKFF        = 0.f;
+  m_fDFilt_hz   = PID_D_FILT_HZ;
+  m_iIMax       = iIMax;
+
+  m_fIntegrator = 0.f;
+  m_fLastError  = 0.f;
+  m_fDerivative = 0.f;
+  m_bReset      = true;
+}
+
+float PIDCtrl::get_pid(const float fError, const float fDT_s, const float fTarget, const bool bSaturated) {
+  float fOutput = m_fKP * fError + m_fKFF * fTarget;
+
+  // A missing or too long time step would corrupt the integrator and the derivative
+  if(fDT_s <= 0.f || fDT_s > PID_MAX_DT_S) {
+    reset_I();
+    return fOutput + m_fIntegrator;
+  }
+
+  // Derivative with a first order low pass filter
+  if(m_fKD != 0.f) {
+    if(m_bReset) {
+      m_fDerivative = 0.f;
+    } else {
+      float fDerivative = (fError - m_fLastError) / fDT_s;
+      if(m_fDFilt_hz > 0.f) {
+        float fRC     = 1.f / (2.f * M_PI * m_fDFilt_hz);
+        m_fDerivative = m_fDerivative + (fDT_s / (fRC + fDT_s) ) * (fDerivative - m_fDerivative);
+      } else {
+        m_fDerivative = fDerivative;
+      }
+    }
+    fOutput += m_fKD * m_fDerivative;
+  }
+  m_fLastError = fError;
+  m_bReset     = false;
+
+  // Conditional integration: If the motors are saturated, only integrate towards zero
+  if(m_fKI != 0.f) {
+    float fDelta = fError * m_fKI * fDT_s;
+    if(!bSaturated || fDelta * m_fIntegrator < 0.f) {
+      m_fIntegrator = constrain_float(m_fIntegrator + fDelta, -m_iIMax, m_iIMax);
+    }
+    fOutput += m_fIntegrator;
+  }
+
+  return fOutput;
+}
+
+void PIDCtrl::reset_I() {
+  m_fIntegrator = 0.f;
+  m_fDerivative = 0.f;
+  m_bReset      = true;
+}
+
+float PIDCtrl::get_integrator() const {
+  return m_fIntegrator;
+}
+
+/*
+ * Linear near zero, otherwise the value which still allows to stop with fLimit
+ */
+inline float sqrt_ctrl_f(const float fError, const float fK, const float fLimit) {
+  const float fLinear = fLimit / (fK * fK);
+  if(fabs(fError) <= fLinear) {
+    return fError * fK;
+  }
+  return sign_f(fError) * sqrt(2.f * fLimit * (fabs(fError) - fLinear / 2.f) );
+}
+
+///////////////////////////////////////////////////////////
+// SCurve
+///////////////////////////////////////////////////////////
+SCurve::SCurve(const float fVelMax, const float fAccMax, const float fJerkMax, const bool bWrap180) {
+  m_fVelMax  = fVelMax;
+  m_fAccMax  = fAccMax;
+  m_fJerkMax = fJerkMax;
+  m_bWrap180 = bWrap180;
+
+  reset(0.f);
+}
+
+void SCurve::reset(const float fPos, const float fVel) {
+  m_fPos = m_bWrap180 ? wrap180_f(fPos) : fPos;
+  m_fVel = constrain_float(fVel, -m_fVelMax, m_fVelMax);
+  m_fAcc = 0.f;
+}
+
+void SCurve::update(const float fTarget, const float fDT_s) {
+  if(fDT_s <= 0.f) {
+    return;
+  }
+
+  // The acceleration settles within ~A/J; The position loop is four times slower, so there is no overshoot
+  const float fKAcc = m_fJerkMax / m_fAccMax;
+  const float fKVel = fKAcc / 4.f;
+
+  float fError  = m_bWrap180 ? wrap180_f(fTarget - m_fPos) : fTarget - m_fPos;
+  float fVelSet = constrain_float(sqrt_ctrl_f(fError, fKVel, m_fAccMax), -m_fVelMax, m_fVelMax);
+  float fAccSet = constrain_float(sqrt_ctrl_f(fVelSet - m_fVel, fKAcc, m_fJerkMax), -m_fAccMax, m_fAccMax);
+
+  float fJerk   = m_fJerkMax * fDT_s;
+  m_fAcc += constrain_float(fAccSet - m_fAcc, -fJerk, fJerk);
+  m_fVel  = constrain_float(m_fVel + m_fAcc * fDT_s, -m_fVelMax, m_fVelMax);
+  m_fPos += m_fVel * fDT_s;
+  if(m_bWrap180) {
+    m_fPos = wrap180_f(m_fPos);
+  }
+}
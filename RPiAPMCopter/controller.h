@@ -0,0 +1,92 @@
+#ifndef CONTROLLER_h
+#define CONTROLLER_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+
+
+///////////////////////////////////////////////////////////
+// PID controller with:
+// * the real time step of the main loop
+// * a low pass filter on the derivative
+// * conditional integration if the motors are saturated (anti-windup)
+// * feed-forward of the set point
+// The getters/setters are compatible with the ArduPilot PID class
+///////////////////////////////////////////////////////////
+class PIDCtrl {
+private:
+  float   m_fKP;
+  float   m_fKI;
+  float   m_fKD;
+  float   m_fKFF;                     // Feed-forward of the set point
+  float   m_fDFilt_hz;                // Cut-off frequency of the derivative; Zero disables the filter
+  int16_t m_iIMax;
+
+  float   m_fIntegrator;
+  float   m_fLastError;
+  float   m_fDerivative;              // Filtered derivative of the error
+  bool    m_bReset;                   // No derivative after a reset (no last error)
+
+public:
+  PIDCtrl(const float fKP = 0.f, const float fKI = 0.f, const float fKD = 0.f, const int16_t iIMax = 0);
+
+  /*
+   * fError:     Set point minus measurement
+   * fDT_s:      Time since the last call in seconds
+   * fTarget:    Set point for the feed-forward in the units of the output (e.g. a rate for a rate output);
+   *             Zero if the controller has no such set point
+   * bSaturated: The motors were saturated in the last iteration.
+   *             The integrator is then only allowed to shrink.
+   */
+  float   get_pid(const float fError, const float fDT_s, const float fTarget = 0.f, const bool bSaturated = false);
+  void    reset_I();
+  float   get_integrator() const;
+
+  float   kP() const        { return m_fKP; }
+  float   kI() const        { return m_fKI; }
+  float   kD() const        { return m_fKD; }
+  float   kFF() const       { return m_fKFF; }
+  float   filt_hz() const   { return m_fDFilt_hz; }
+  int16_t imax() const      { return m_iIMax; }
+
+  void    kP(const float v)      { m_fKP = v; }
+  void    kI(const float v)      { m_fKI = v; }
+  void    kD(const float v)      { m_fKD = v; }
+  void    kFF(const float v)     { m_fKFF = v; }
+  void    filt_hz(const float v) { m_fDFilt_hz = v; }
+  void    imax(const int16_t v)  { m_iIMax = v < 0 ? -v : v; }
+};
+
+///////////////////////////////////////////////////////////
+// Jerk limited set point generator (S-curve):
+// Follows a (moving) target with bounded velocity, acceleration and jerk.
+// Each update is O(1): Square root controllers for the position and the velocity
+// give the stopping distance, the jerk limits the change of the acceleration.
+// The loop gains follow from the limits, so there is nothing else to tune.
+///////////////////////////////////////////////////////////
+class SCurve {
+private:
+  float m_fVelMax;
+  float m_fAccMax;
+  float m_fJerkMax;
+  bool  m_bWrap180;                   // Angle in degrees: Takes the shortest way and keeps the set point in [-180, 180]
+
+  float m_fPos;
+  float m_fVel;
+  float m_fAcc;
+
+public:
+  SCurve(const float fVelMax, const float fAccMax, const float fJerkMax, const bool bWrap180 = false);
+
+  // Starts from a measured state, so engaging causes no step
+  void  reset(const float fPos, const float fVel = 0.f);
+  void  update(const float fTarget, const float fDT_s);
+
+  float get_pos() const { return m_fPos; }
+  float get_vel() const { return m_fVel; }
+  float get_acc() const { return m_fAcc; }
+};
+
+#endif /*CONTROLLER_h*/
@@ -19,6 +19,30 @@
 // create board led object
 AP_BoardLED board_led;
 
+/*
+ * Health monitor:
+ * Error flags of the sensor, time-out without updates (stale), time-out without changes (frozen, 0 = not monitored)
+ * and whether the flags are latched.
+ * Latched flags take the model down (FS_DEVICE_DOWN_S), so they are never cleared by the monitor:
+ * Only Exception::dev_take_down() resets them once the motors stopped.
+ * The battery monitor and the range finder have no error flag, they are only part of the health bitmap.
+ */
+struct HealthRule {
+  uint_fast16_t flags;
+  uint16_t      stale_ms;
+  uint16_t      frozen_ms;
+  bool          latch;
+};
+
+static const HealthRule HEALTH_TABLE[Device::HLT_NR_OF_SENSORS] = {
+  { AbsErrorDevice::GYROMETER_F | AbsErrorDevice::ACCELEROMETR_F, HLT_INERT_STALE_MS, HLT_INERT_FROZEN_MS, true  },
+  { AbsErrorDevice::BAROMETER_F,                                  HLT_BARO_STALE_MS,  HLT_BARO_FROZEN_MS,  false },
+  { AbsErrorDevice::COMPASS_F,                                    HLT_COMP_STALE_MS,  0,                   false },
+  { AbsErrorDevice::GPS_F,                                        HLT_GPS_STALE_MS,   0,                   false },
+  { 0,                                                            HLT_BATT_STALE_MS,  0,                   false },
+  { 0,                                                            HLT_RF_STALE_MS,    0,                   false }
+};
+
 /*
  * Gaussian bell function
  */
@@ -41,37 +65,44 @@ inline float atti_f(float fX, float fSlope) {
 ///////////////////////////////////////////////////////////
 void DeviceInit::init_pids() {
   // Rate PIDs
+  // The former ArduPilot PID copies never applied the I and D terms (P only): They stay off until they are tuned
   m_rgPIDS[PID_PIT_RATE].kP(0.65);
-  m_rgPIDS[PID_PIT_RATE].kI(0.35);
-  m_rgPIDS[PID_PIT_RATE].kD(0.015);
+  m_rgPIDS[PID_PIT_RATE].kI(0.0f);
+  m_rgPIDS[PID_PIT_RATE].kD(0.0f);
   m_rgPIDS[PID_PIT_RATE].imax(50);
 
   m_rgPIDS[PID_ROL_RATE].kP(0.65);
-  m_rgPIDS[PID_ROL_RATE].kI(0.35);
-  m_rgPIDS[PID_ROL_RATE].kD(0.015);
+  m_rgPIDS[PID_ROL_RATE].kI(0.0f);
+  m_rgPIDS[PID_ROL_RATE].kD(0.0f);
   m_rgPIDS[PID_ROL_RATE].imax(50);
 
   m_rgPIDS[PID_YAW_RATE].kP(0.75);
-  m_rgPIDS[PID_YAW_RATE].kI(0.15);
+  m_rgPIDS[PID_YAW_RATE].kI(0.0f);
   m_rgPIDS[PID_YAW_RATE].kD(0.0f);
   m_rgPIDS[PID_YAW_RATE].imax(50);
 
   m_rgPIDS[PID_THR_RATE].kP(0.75);  // For altitude hold
-  m_rgPIDS[PID_THR_RATE].kI(0.25);  // For altitude hold
+  m_rgPIDS[PID_THR_RATE].kI(0.0f);  // For altitude hold
   m_rgPIDS[PID_THR_RATE].kD(0.0f);  // For altitude hold
   m_rgPIDS[PID_THR_RATE].imax(100); // For altitude hold
 
   m_rgPIDS[PID_ACC_RATE].kP(1.50);  // For altitude hold
-  m_rgPIDS[PID_ACC_RATE].kI(0.75);  // For altitude hold
+  m_rgPIDS[PID_ACC_RATE].kI(0.0f);  // For altitude hold
   m_rgPIDS[PID_ACC_RATE].kD(0.0f);  // For altitude hold
   m_rgPIDS[PID_ACC_RATE].imax(100); // For altitude hold
 
+  m_rgPIDS[PID_NAV_RATE].kP(2.00);  // For GPS navigation
+  m_rgPIDS[PID_NAV_RATE].kI(0.50);  // For GPS navigation
+  m_rgPIDS[PID_NAV_RATE].kD(0.0f);  // For GPS navigation
+  m_rgPIDS[PID_NAV_RATE].imax(100); // For GPS navigation
+
   // STAB PIDs
   m_rgPIDS[PID_PIT_STAB].kP(4.25);
   m_rgPIDS[PID_ROL_STAB].kP(4.25);
   m_rgPIDS[PID_YAW_STAB].kP(4.25);
   m_rgPIDS[PID_THR_STAB].kP(5.50);  // For altitude hold
   m_rgPIDS[PID_ACC_STAB].kP(15.50); // For altitude hold
+  m_rgPIDS[PID_NAV_STAB].kP(1.00);  // For GPS navigation
 }
 
 void DeviceInit::init_rf() {
@@ -91,58 +122,209 @@ void DeviceInit::init_inertial_nav() {
   m_pInertNav->setup_home_position();
   m_pInertNav->set_altitude(0.f);
 
-  m_t32Compass = m_t32Inertial = m_t32InertialNav = m_pHAL->scheduler->millis();
+  m_t32Inertial = m_t32InertialNav = m_pHAL->scheduler->micros();
+  m_iInitFlags |= INIT_INERT_NAV_F;
 }
 
 void DeviceInit::init_barometer() {
+  // The calibration is done by calib_barometer()
   m_pBaro->init();
-  m_pBaro->calibrate();
 
 #ifdef APM2_HARDWARE
   // we need to stop the barometer from holding the SPI bus
   m_pHAL->gpio->pinMode(40, GPIO_OUTPUT);
   m_pHAL->gpio->write(40, HIGH);
 #endif
+
+  m_iBaroCalCnt  = 0;
+  m_t32Barometer = m_pHAL->scheduler->millis();
+}
+
+bool DeviceInit::calib_barometer() {
+  if(m_iInitFlags & INIT_BAROMETER_F) {
+    return true;
+  }
+
+  uint_fast32_t t32CurrentTime = m_pHAL->scheduler->millis();
+  if(t32CurrentTime - m_t32Barometer < BAROM_CAL_T_MS) {
+    return false;
+  }
+  m_t32Barometer = t32CurrentTime;
+
+  m_pBaro->read();
+  // Count only valid readouts
+  if(!m_pBaro->healthy || ++m_iBaroCalCnt < BAROM_CAL_SAMPLES) {
+    return false;
+  }
+
+  // Ground pressure and temperature from the last readout
+  m_pBaro->update_calibration();
+  m_iInitFlags |= INIT_BAROMETER_F;
+  return true;
 }
 
 void DeviceInit::init_compass() {
   if(!m_pComp->init() ) {
-    m_pHAL->console->printf("Init compass failed!\n");
+    m_pHAL->console->printf_P(PSTR("Init compass failed!\n"));
   }
 
   m_pComp->accumulate();
   m_pComp->motor_compensation_type(1);                              // throttle
-  m_pComp->set_and_save_offsets(0, 0, 0, 0);                        // set offsets to account for surrounding interference
+  // Offsets to account for surrounding interference are restored from the EEPROM (see Parameters)
   m_pComp->set_declination(ToRad(0.f) );                            // set local difference between magnetic north and true north
 
-  m_pHAL->console->print("Compass auto-detected as: ");
+  m_pHAL->console->print_P(PSTR("Compass auto-detected as: "));
   switch( m_pComp->product_id ) {
   case AP_COMPASS_TYPE_HIL:
-    m_pHAL->console->printf("HIL\n");
+    m_pHAL->console->printf_P(PSTR("HIL\n"));
     break;
   case AP_COMPASS_TYPE_HMC5843:
-    m_pHAL->console->printf("HMC5843\n");
+    m_pHAL->console->printf_P(PSTR("HMC5843\n"));
     break;
   case AP_COMPASS_TYPE_HMC5883L:
-    m_pHAL->console->printf("HMC5883L\n");
+    m_pHAL->console->printf_P(PSTR("HMC5883L\n"));
     break;
   case AP_COMPASS_TYPE_PX4:
-    m_pHAL->console->printf("PX4\n");
+    m_pHAL->console->printf_P(PSTR("PX4\n"));
     break;
   default:
-    m_pHAL->console->printf("unknown\n");
+    m_pHAL->console->printf_P(PSTR("unknown\n"));
     break;
   }
 
-  m_t32Compass = m_pHAL->scheduler->millis();
+  m_iInitFlags |= INIT_COMPASS_F;
 }
 
 void DeviceInit::init_inertial() {
   // Turn on MPU6050
-  m_pInert->init(AP_InertialSensor::COLD_START, AP_InertialSensor::RATE_200HZ);
+  // A cold start would block until the gyrometer is calibrated, calib_gyrometer() does this in slices
+  m_pInert->init(AP_InertialSensor::WARM_START, AP_InertialSensor::RATE_200HZ);
+
+  m_iGyroCalCnt = 0;
+  m_vGyroCalSum.zero();
+  m_vGyroCalLast.zero();
 
-  // Calibrate the inertial
-  m_t32Inertial = m_pHAL->scheduler->millis();
+  m_t32Inertial = m_pHAL->scheduler->micros();
+}
+
+bool DeviceInit::calib_gyrometer() {
+  if(m_iInitFlags & INIT_INERTIAL_F) {
+    return true;
+  }
+
+  // Warm start: Skip the calibration if the offsets for this board temperature are known
+  Vector3f vOffs;
+  if(m_pBaro->healthy && calc_gyro_tcomp(m_pBaro->get_temperature(), vOffs) ) {
+    m_pHAL->console->printf_P(PSTR("Use learned gyrometer offsets\n"));
+    m_pInert->set_gyro_offsets(vOffs);
+    m_t32Inertial = m_pHAL->scheduler->micros();
+    m_t32GyroTComp = m_pHAL->scheduler->millis();
+    m_iInitFlags |= INIT_INERTIAL_F;
+    return true;
+  }
+
+  // Don't wait for a new sample
+  if(!m_pInert->wait_for_sample(0) ) {
+    return false;
+  }
+
+  m_pInert->update();
+  m_vGyroCalSum += m_pInert->get_gyro();
+  if(++m_iGyroCalCnt < INERT_GYRO_CAL_S) {
+    return false;
+  }
+
+  Vector3f vMean = m_vGyroCalSum / static_cast<float>(INERT_GYRO_CAL_S);
+  Vector3f vDiff = vMean - m_vGyroCalLast;
+  m_vGyroCalLast = vMean;
+  m_vGyroCalSum.zero();
+  m_iGyroCalCnt  = 0;
+
+  // The model was moved (or this is the first window): Try again
+  if(vDiff.length() > ToRad(INERT_GYRO_CAL_TOL) ) {
+    return false;
+  }
+
+  // get_gyro() is already corrected by the current offsets
+  m_pInert->set_gyro_offsets(m_pInert->get_gyro_offsets() + vMean);
+  if(m_pBaro->healthy) {
+    learn_gyro_tcomp(m_pBaro->get_temperature(), m_pInert->get_gyro_offsets() );
+  }
+  m_t32Inertial = m_pHAL->scheduler->micros();
+  m_t32GyroTComp = m_pHAL->scheduler->millis();
+  m_iInitFlags |= INIT_INERTIAL_F;
+  return true;
+}
+
+void DeviceInit::learn_gyro_tcomp(const float fTemp_deg, const Vector3f &vOffs) {
+  float fPos = (fTemp_deg - INERT_TCOMP_MIN_DEG) / INERT_TCOMP_STEP_DEG;
+  if(fPos < 0.f || fPos >= INERT_TCOMP_BINS) {
+    return;
+  }
+
+  uint_fast8_t iBin = static_cast<uint_fast8_t>(fPos);
+  // Average with older calibrations of this bin
+  if(m_iGyroTCompMask & (1 << iBin) ) {
+    m_rgGyroTComp[iBin] = SFilter::low_pass_filt_V3f(vOffs, m_rgGyroTComp[iBin], 0.5f);
+  } else {
+    m_rgGyroTComp[iBin] = vOffs;
+  }
+  m_iGyroTCompMask |= 1 << iBin;
+}
+
+bool DeviceInit::calc_gyro_tcomp(const float fTemp_deg, Vector3f &vOffs) const {
+  float fPos = (fTemp_deg - INERT_TCOMP_MIN_DEG) / INERT_TCOMP_STEP_DEG;
+  if(fPos < 0.f || fPos >= INERT_TCOMP_BINS) {
+    return false;
+  }
+
+  int_fast8_t iBin = static_cast<int_fast8_t>(fPos);
+  if(!(m_iGyroTCompMask & (1 << iBin) ) ) {
+    return false;
+  }
+  vOffs = m_rgGyroTComp[iBin];
+
+  // Interpolate linearly between the bin centers if the neighbour bin was learned too
+  float fFrac  = fPos - iBin - 0.5f;
+  int_fast8_t iNext = fFrac < 0.f ? iBin - 1 : iBin + 1;
+  if(iNext >= 0 && iNext < INERT_TCOMP_BINS && (m_iGyroTCompMask & (1 << iNext) ) ) {
+    vOffs += (m_rgGyroTComp[iNext] - vOffs) * fabs(fFrac);
+  }
+  return true;
+}
+
+void DeviceInit::update_gyro_tcomp() {
+  if(!(m_iInitFlags & INIT_INERTIAL_F) || !m_pBaro->healthy) {
+    return;
+  }
+
+  uint_fast32_t t32CurrentTime = m_pHAL->scheduler->millis();
+  if(t32CurrentTime - m_t32GyroTComp < INERT_TCOMP_T_MS) {
+    return;
+  }
+  m_t32GyroTComp = t32CurrentTime;
+
+  // Keep the current offsets outside of the learned temperature range
+  Vector3f vOffs;
+  if(calc_gyro_tcomp(m_pBaro->get_temperature(), vOffs) ) {
+    m_pInert->set_gyro_offsets(vOffs);
+  }
+}
+
+bool DeviceInit::get_gyro_tcomp(const uint_fast8_t iBin, Vector3f &vOffs) const {
+  if(iBin >= INERT_TCOMP_BINS) {
+    return false;
+  }
+  vOffs = m_rgGyroTComp[iBin];
+  return m_iGyroTCompMask & (1 << iBin);
+}
+
+void DeviceInit::set_gyro_tcomp(const uint_fast8_t iBin, const Vector3f &vOffs, const bool bValid) {
+  if(iBin >= INERT_TCOMP_BINS) {
+    return;
+  }
+  m_rgGyroTComp[iBin] = vOffs;
+  m_iGyroTCompMask    = bValid ? m_iGyroTCompMask | (1 << iBin) : m_iGyroTCompMask & ~(1 << iBin);
 }
 
 void DeviceInit::init_gps() {
@@ -154,7 +336,9 @@ void DeviceInit::init_gps() {
 
 void DeviceInit::init_batterymon() {
   // initialise the battery monitor for ATTO180 sensor by default :D
-  m_pBat->setup_source(ATTO180);
+  // or the sensor type restored from the EEPROM
+  m_pBat->setup_source(m_pBat->get_type() );
+  m_iInitFlags |= INIT_BATTMON_F;
 }
 
 DeviceInit::DeviceInit( const AP_HAL::HAL *pHAL, AP_InertialSensor *pInert, Compass *pComp, AP_Baro *pBar, AP_GPS *pGPS, BattMonitor *pBat, RangeFinder *pRF, AP_AHRS_DCM *pAHRS, AP_InertialNav *pInertNav ) 
@@ -169,22 +353,33 @@ DeviceInit::DeviceInit( const AP_HAL::HAL *pHAL, AP_InertialSensor *pInert, Comp
   m_pAHRS             = pAHRS;
   m_pInertNav         = pInertNav;
   m_iUpdateRate       = MAIN_T_MS;
+  m_iInitFlags        = INIT_NOTHING_F;
   m_eErrors           = NOTHING_F;
-  m_t32Compass = m_t32InertialNav = m_t32Inertial = m_pHAL->scheduler->millis();
-  // PIDs
-  memset(m_rgPIDS, 0, sizeof(m_rgPIDS) );
+  m_iBaroCalCnt       = 0;
+  m_iGyroCalCnt       = 0;
+  m_iGyroTCompMask    = 0;
+  m_t32InertialNav = m_t32Inertial = m_pHAL->scheduler->micros();
+  m_t32Barometer = m_t32GyroTComp = m_pHAL->scheduler->millis();
 }
 
-PID DeviceInit::get_pid(uint_fast8_t index) const {
+PIDCtrl &DeviceInit::get_pid(uint_fast8_t index) {
   if(index >= NR_OF_PIDS) {
     return m_rgPIDS[NR_OF_PIDS-1];
   }
   return m_rgPIDS[index];
 }
 
-void DeviceInit::set_pid(uint_fast8_t index, PID pid) {
+const PIDCtrl &DeviceInit::get_pid(uint_fast8_t index) const {
+  if(index >= NR_OF_PIDS) {
+    return m_rgPIDS[NR_OF_PIDS-1];
+  }
+  return m_rgPIDS[index];
+}
+
+void DeviceInit::set_pid(uint_fast8_t index, const PIDCtrl &pid) {
   if(index >= NR_OF_PIDS) {
     m_rgPIDS[NR_OF_PIDS-1] = pid;
+    return;
   }
   m_rgPIDS[index] = pid;
 }
@@ -197,6 +392,10 @@ uint_fast8_t DeviceInit::get_refr_rate() const {
   return m_iUpdateRate;
 }
 
+bool DeviceInit::is_initialized(const uint_fast8_t flags) const {
+  return (m_iInitFlags & flags) == flags;
+}
+
 ///////////////////////////////////////////////////////////
 // Device
 ///////////////////////////////////////////////////////////
@@ -205,11 +404,11 @@ void Device::update_attitude() {
 
 #if BENCH_OUT
   static int iBCounter = 0;
-  static int iTimer = 0;
-  int iBCurTime = m_pHAL->scheduler->millis();
+  static uint32_t iTimer = 0;
+  uint32_t iBCurTime = m_pHAL->scheduler->millis();
   ++iBCounter;
   if(iBCurTime - iTimer >= 1000) {
-    m_pHAL->console->printf("Benchmark - update_attitude(): %d Hz\n", iBCounter);
+    m_pHAL->console->printf_P(PSTR("Benchmark - update_attitude(): %d Hz\n"), iBCounter);
     iBCounter = 0;
     iTimer = iBCurTime;
   }
@@ -220,8 +419,8 @@ void Device::update_attitude() {
   //m_pInert->update();
 
   // Calculate time (in s) passed
-  uint_fast32_t t32CurrentTime = m_pHAL->scheduler->millis();
-  float dT = static_cast<float>((t32CurrentTime - m_t32Inertial) ) / 1000.f;
+  uint32_t t32CurrentTime = m_pHAL->scheduler->micros();
+  float dT = dt_s(t32CurrentTime, m_t32Inertial);
   m_t32Inertial = t32CurrentTime;
 
   // Calculate attitude from relative gyrometer changes
@@ -233,13 +432,13 @@ void Device::update_attitude() {
   Vector3f vRef_deg = read_accl_deg();
 
   #if DEBUG_OUT
-  static int iDTimer = 0;
-  int iDCurTime = m_pHAL->scheduler->millis();
+  static uint32_t iDTimer = 0;
+  uint32_t iDCurTime = m_pHAL->scheduler->millis();
   if(iDCurTime - iDTimer >= 35) {
     iDTimer = iDCurTime;
   
-    m_pHAL->console->printf("Attitude - x: %.3f/%.3f, y: %.3f/%.3f, z: %.1f\n", m_vAtti_deg.x, vRef_deg.x, m_vAtti_deg.y, vRef_deg.y, m_vAtti_deg.z);
-    //m_pHAL->console->printf("Acceleration - x: %.3f, y: %.3f, z: %.3f\n", m_vAccelPG_cmss.x, m_vAccelPG_cmss.y, m_vAccelPG_cmss.z);
+    m_pHAL->console->printf_P(PSTR("Attitude - x: %.3f/%.3f, y: %.3f/%.3f, z: %.1f\n"), m_vAtti_deg.x, vRef_deg.x, m_vAtti_deg.y, vRef_deg.y, m_vAtti_deg.z);
+    //m_pHAL->console->printf_P(PSTR("Acceleration - x: %.3f, y: %.3f, z: %.3f\n"), m_vAccelPG_cmss.x, m_vAccelPG_cmss.y, m_vAccelPG_cmss.z);
   }
   #endif
  
@@ -249,7 +448,7 @@ void Device::update_attitude() {
       abs(vRef_deg.y)        > INERT_ANGLE_BIAS)          // Out of range (pitch > 60°)
   {
     #if DEBUG_OUT
-    m_pHAL->console->printf("Attitude estimation out of range or free fall: Don't anneal to accelerometer.\n");
+    m_pHAL->console->printf_P(PSTR("Attitude estimation out of range or free fall: Don't anneal to accelerometer.\n"));
     #endif
     return;
   }
@@ -275,14 +474,27 @@ DeviceInit(pHAL, pInert, pComp, pBar, pGPS,  pBat, pRF, pAHRS, pInertNav)
   m_vAtti_deg.y       = 0.f;
   m_vAtti_deg.z       = 0.f;
 
-  m_fCmpH             = 0.f;
   m_fGpsH             = 0.f;
+
+  m_t32LoopWin        = m_pHAL->scheduler->micros();
+  m_iLoopMin_us       = 0xFFFFFFFFUL;
+  m_iLoopMax_us       = 0;
+  m_iLoopSum_us       = 0;
+  m_iLoopCnt          = 0;
+
+  m_iHealthMap        = 0;
+  m_t32HealthWin      = m_pHAL->scheduler->millis();
 }
 
 int_fast32_t Device::read_rf_cm() {
   m_pRF->update();
+  // Out of range is not a fault: The range finder is then just stale
   if(m_pRF->healthy() ) {
-    m_iAltitude_cm = m_pRF->distance_cm();
+    int_fast32_t iAltitude_cm = m_pRF->distance_cm();
+    mark_update(HLT_RANGEFNDR, m_pHAL->scheduler->millis(), iAltitude_cm != m_iAltitude_cm);
+    m_iAltitude_cm = iAltitude_cm;
+    // The range finder measures along the z-axis of the model
+    m_AltKF.update_rf(m_iAltitude_cm * m_pAHRS->cos_roll() * m_pAHRS->cos_pitch() );
   }
   return m_iAltitude_cm;
 }
@@ -296,6 +508,14 @@ void Device::set_trims(float fRoll_deg, float fPitch_deg) {
   m_fInertPitCor = fPitch_deg;
 }
 
+float Device::get_trim_rol_deg() const {
+  return m_fInertRolCor;
+}
+
+float Device::get_trim_pit_deg() const {
+  return m_fInertPitCor;
+}
+
 Vector3f Device::get_atti_cor_deg() {
   return Vector3f(m_vAtti_deg.x - m_fInertPitCor, // Pitch correction for inbalances
                   m_vAtti_deg.y - m_fInertRolCor, // Roll correction for inbalances
@@ -331,12 +551,11 @@ void Device::update_inav() {
     return;
   }
 
-  read_gps();
-  read_comp_deg();
+  // GPS and compass are read by their own tasks
   //m_pAHRS->update(); // AHRS system is already updated at 100 Hz in the attitude update function
 
-  uint_fast32_t t32CurrentTime = m_pHAL->scheduler->millis();
-  float fTime_s = (t32CurrentTime - m_t32InertialNav) / 1000.f;
+  uint32_t t32CurrentTime = m_pHAL->scheduler->micros();
+  float fTime_s = dt_s(t32CurrentTime, m_t32InertialNav);
   m_pInertNav->update(fTime_s);
   m_t32InertialNav = t32CurrentTime;
 }
@@ -346,11 +565,13 @@ void Device::update_inav() {
  */
 Vector3f Device::read_gyro_deg() {
   if(!m_pInert->healthy() ) {
-    m_pHAL->console->printf("read_gyro_deg(): Inertial not healthy\n");
+    m_pHAL->console->printf_P(PSTR("read_gyro_deg(): Inertial not healthy\n"));
     m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, GYROMETER_F) );
+    mark_fault(HLT_INERTIAL, m_pHAL->scheduler->millis() );
     return m_vGyro_deg;
   }
 
+  Vector3f vGyroLast_deg = m_vGyro_deg;
   m_vGyro_deg = m_pInert->get_gyro();
   // Save values
   float fRol = ToDeg(m_vGyro_deg.x); // in comparison to the accelerometer data swapped
@@ -361,6 +582,7 @@ Vector3f Device::read_gyro_deg() {
   m_vGyro_deg.y = fRol; // ROLL
   m_vGyro_deg.z = fYaw; // YAW
 
+  mark_update(HLT_INERTIAL, m_pHAL->scheduler->millis(), m_vGyro_deg != vGyroLast_deg);
   return m_vGyro_deg;
 }
 
@@ -370,8 +592,9 @@ Vector3f Device::read_gyro_deg() {
  */
 Vector3f Device::read_accl_deg() {
   if(!m_pInert->healthy() ) {
-    m_pHAL->console->printf("read_accl_deg(): Inertial not healthy\n");
+    m_pHAL->console->printf_P(PSTR("read_accl_deg(): Inertial not healthy\n"));
     m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, ACCELEROMETR_F) );
+    mark_fault(HLT_INERTIAL, m_pHAL->scheduler->millis() );
     return m_vAccel_deg;
   }
 
@@ -392,6 +615,14 @@ Vector3f Device::read_accl_deg() {
   return m_vAccel_deg;
 }
 
+float Device::read_accel_ef_z_cmss() {
+  const Matrix3f &dcm = m_pAHRS->get_dcm_matrix();
+  const Vector3f &vAccel_mss = m_pInert->get_accel();
+  // Rotate into the earth frame: NED, so at rest the sensor measures -G
+  float fAccZ_mss = dcm.c.x * vAccel_mss.x + dcm.c.y * vAccel_mss.y + dcm.c.z * vAccel_mss.z;
+  return -(fAccZ_mss + INERT_G_CONST) * 100.f;
+}
+
 Vector3f Device::get_accel_mg_cmss() {
   return m_vAccelMG_cmss;
 }
@@ -407,23 +638,21 @@ Vector3f Device::get_accel_pg_cmss() {
  */
 float Device::read_comp_deg() {
   if (!m_pComp->use_for_yaw() ) {
-    //m_pHAL->console->printf("read_comp_deg(): Compass not healthy\n");
+    //m_pHAL->console->printf_P(PSTR("read_comp_deg(): Compass not healthy\n"));
     m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, COMPASS_F) );
-    return m_fCmpH;
-  }
-
-  // Update the compass readout maximally ten times a second
-  if(m_pHAL->scheduler->millis() - m_t32Compass <= COMPASS_UPDATE_T) {
-    return m_fCmpH;
+    mark_fault(HLT_COMPASS, m_pHAL->scheduler->millis() );
+    return m_ContComp.heading_deg;
   }
 
   m_pComp->read();
 
-  m_fCmpH = m_pComp->calculate_heading(m_pAHRS->get_dcm_matrix() );
-  m_fCmpH = ToDeg(m_fCmpH);
+  float fHeading_deg      = ToDeg(m_pComp->calculate_heading(m_pAHRS->get_dcm_matrix() ) );
+  m_ContComp.timestamp_ms = m_pHAL->scheduler->millis();
+  mark_update(HLT_COMPASS, m_ContComp.timestamp_ms, fHeading_deg != m_ContComp.heading_deg);
+  m_ContComp.heading_deg  = fHeading_deg;
   m_pComp->learn_offsets();
 
-  return m_fCmpH;
+  return m_ContComp.heading_deg;
 }
 
 GPSData Device::read_gps() {
@@ -435,6 +664,13 @@ GPSData Device::read_gps() {
   m_ContGPS.status = static_cast<uint_fast32_t>(m_pGPS->status() );
   
   if(m_ContGPS.status > AP_GPS::NO_FIX) {
+    // Only a new fix is an update: A frozen fix keeps the GPS time
+    float fTimeWeek_s     = m_pGPS->time_week_ms() / 1000.0;
+    if(fTimeWeek_s != m_ContGPS.time_week_s) {
+      bool bChanged = m_pGPS->location().lat != m_ContGPS.latitude || m_pGPS->location().lng != m_ContGPS.longitude;
+      mark_update(HLT_GPS, m_pHAL->scheduler->millis(), bChanged);
+    }
+
     m_ContGPS.latitude    = m_pGPS->location().lat;
     m_ContGPS.longitude   = m_pGPS->location().lng;
     m_ContGPS.altitude_cm = m_pGPS->location().alt;
@@ -444,10 +680,12 @@ GPSData Device::read_gps() {
     m_ContGPS.gcourse_cd  = m_pGPS->ground_course_cd();
     m_ContGPS.satelites   = m_pGPS->num_sats();
     m_ContGPS.time_week   = m_pGPS->time_week();
-    m_ContGPS.time_week_s = m_pGPS->time_week_ms() / 1000.0;
+    m_ContGPS.time_week_s = fTimeWeek_s;
+    m_ContGPS.timestamp_ms = m_pHAL->scheduler->millis();
   } else {
-    //m_pHAL->console->printf("read_gps(): GPS not healthy\n");
+    //m_pHAL->console->printf_P(PSTR("read_gps(): GPS not healthy\n"));
     m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, GPS_F) );
+    mark_fault(HLT_GPS, m_pHAL->scheduler->millis() );
   }
 
   return m_ContGPS;
@@ -455,13 +693,15 @@ GPSData Device::read_gps() {
 
 BaroData Device::read_baro() {
   if (!m_pBaro->healthy) {
-    m_pHAL->console->printf("read_baro(): Barometer not healthy\n");
+    m_pHAL->console->printf_P(PSTR("read_baro(): Barometer not healthy\n"));
     m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, BAROMETER_F) );
+    mark_fault(HLT_BAROMETER, m_pHAL->scheduler->millis() );
     return m_ContBaro;
   }
 
   m_pBaro->read();
 
+  float fPressureLast_pa      = m_ContBaro.pressure_pa;
   m_ContBaro.pressure_pa      = SFilter::low_pass_filt_f(m_pBaro->get_pressure(), m_ContBaro.pressure_pa, BAROM_LOWPATH_FILT_f);
   m_ContBaro.temperature_deg  = SFilter::low_pass_filt_f(m_pBaro->get_temperature(), m_ContBaro.temperature_deg, BAROM_LOWPATH_FILT_f);
 
@@ -469,46 +709,70 @@ BaroData Device::read_baro() {
   m_ContBaro.climb_rate_cms   = static_cast<int_fast32_t>(SFilter::low_pass_filt_f(m_pBaro->get_climb_rate(), m_ContBaro.climb_rate_cms, BAROM_LOWPATH_FILT_f) * 100);
 
   m_ContBaro.pressure_samples = m_pBaro->get_pressure_samples();
+  m_ContBaro.timestamp_ms     = m_pHAL->scheduler->millis();
+  // A stuck sample count means the timer process does not read the sensor anymore
+  if(m_ContBaro.pressure_samples > 0) {
+    mark_update(HLT_BAROMETER, m_ContBaro.timestamp_ms, m_ContBaro.pressure_pa != fPressureLast_pa);
+    // The filter needs the ground pressure and does its own filtering
+    if(m_iInitFlags & INIT_BAROMETER_F) {
+      m_AltKF.update_baro(m_pBaro->get_altitude() * 100.f);
+    }
+  }
 
   return m_ContBaro;
 }
 
 BattData Device::read_bat() {
-  const unsigned int iRefVoltSamples = 25;
-  static unsigned int iRefVoltCounter = 0;
-  static float fRefVolt_V = 0.f;
-
   m_pBat->read();
+  m_pBat->estimate();
 
+  float fVoltageLast_V   = m_ContBat.voltage_V;
   m_ContBat.voltage_V    = m_pBat->voltage();
   m_ContBat.current_A    = m_pBat->current_amps();
   m_ContBat.power_W      = m_ContBat.voltage_V * m_ContBat.current_A;
   m_ContBat.consumpt_mAh = m_pBat->current_total_mah();
+  m_ContBat.timestamp_ms = m_pHAL->scheduler->millis();
+  mark_update(HLT_BATTMON, m_ContBat.timestamp_ms, m_ContBat.voltage_V != fVoltageLast_V);
+
+  m_ContBat.rest_V       = m_pBat->resting_voltage();
+  m_ContBat.resist_Ohm   = m_pBat->resistance_ohm();
+  m_ContBat.load_V       = m_pBat->load_voltage();
+  m_ContBat.soc_pct      = m_pBat->soc_pct();
+  m_ContBat.remain_s     = m_pBat->remaining_s();
 
-  if(m_ContBat.voltage_V < BATT_MIN_VOLTAGE) {
-    m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, VOLTAGE_LOW_F) );
-  }
   if(m_ContBat.voltage_V > BATT_MAX_VOLTAGE) {
     m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, VOLTAGE_HIGH_F) );
   }
-
-  // Collect samples (iRefVoltSamples) for reference voltage (but only if readouts are valid)
-  if(iRefVoltCounter < iRefVoltSamples) {
-    if(m_ContBat.voltage_V <= BATT_MAX_VOLTAGE && m_ContBat.voltage_V >= BATT_MIN_VOLTAGE) {
-      iRefVoltCounter++;
-      fRefVolt_V += m_ContBat.voltage_V;
+  if(!m_pBat->estimate_ok() ) {
+    if(m_ContBat.voltage_V < BATT_MIN_VOLTAGE) {
+      m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, VOLTAGE_LOW_F) );
     }
-  } 
-  // Only update reference voltage if necessary
-  else if(m_ContBat.refVoltage_V < 0) {
-    m_ContBat.refVoltage_V = fRefVolt_V / iRefVoltSamples;
+    return m_ContBat;
+  }
+
+  // Reference voltage for the motor compensation
+  m_ContBat.refVoltage_V = m_pBat->initial_voltage();
+
+  // The resting voltage does not drop with the throttle, so short bursts don't trigger the failsafe
+  if(m_ContBat.rest_V / m_pBat->cells() < BATT_CELL_LOW_V) {
+    m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, VOLTAGE_LOW_F) );
+  }
+  // Battery is at the end: The exception handler takes the model down
+  if( m_ContBat.soc_pct < BATT_SOC_CRIT_PCT ||
+     (m_ContBat.remain_s >= 0.f && m_ContBat.remain_s < BATT_RESERVE_S) )
+  {
+    m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(add_flag(m_eErrors, CURRENT_LOW_F) );
   }
   
   return m_ContBat;
 }
 
 float Device::get_comp_deg() {
-  return m_fCmpH;
+  return m_ContComp.heading_deg;
+}
+
+CompData Device::get_comp() {
+  return m_ContComp;
 }
 
 BaroData Device::get_baro() {
@@ -523,88 +787,153 @@ BattData Device::get_bat() {
   return m_ContBat;
 }
 
-float Device::get_altitude_cm(Device *pDev, bool &bOK) {
-  bOK = true;
-  if(!pDev) {
-    bOK = false;
-    return 0.f;
-  }
+const SensorFrame &Device::get_frame() const {
+  return m_Frame;
+}
 
-  float fAltitude_cm = 0.f;
-  // Barometer and GPS usable
-  if(pDev->m_pInertNav->altitude_ok() ) {
-    fAltitude_cm = static_cast<float>(pDev->m_pInertNav->get_altitude() );
-  }
+LoopStats Device::get_loop_stats() const {
+  return m_ContLoop;
+}
+
+uint_fast8_t Device::get_health() const {
+  return m_iHealthMap;
+}
+
+const SensorHealth &Device::get_health(const uint_fast8_t iSensor) const {
+  return m_rgHealth[iSensor < HLT_NR_OF_SENSORS ? iSensor : HLT_INERTIAL];
+}
 
-  // Use the range finder for smaller altitudes
-  if(!pDev->m_pRF->healthy() ) {
-    bOK = false;
-    return fAltitude_cm;
+void Device::mark_update(const uint_fast8_t iSensor, const uint32_t t32Now_ms, const bool bChanged) {
+  SensorHealth &health = m_rgHealth[iSensor];
+  health.update_ms = t32Now_ms;
+  health.updates++;
+  // The first update counts as change, otherwise a sensor would be frozen since the start
+  if(bChanged || health.change_ms == 0) {
+    health.change_ms = t32Now_ms;
+    health.changes++;
   }
-  
-  float iAltitudeRF_cm = static_cast<float>(pDev->get_rf_cm() );
-  return iAltitudeRF_cm <= AP_RANGE_FINDER_MAXSONARI2CXL_MAX_DISTANCE ? iAltitudeRF_cm : fAltitude_cm;
 }
 
-float Device::get_accel_x_g(Device *pDev, bool &bOK) {
-  static float fGForce = 0.f;
+void Device::mark_fault(const uint_fast8_t iSensor, const uint32_t t32Now_ms) {
+  m_rgHealth[iSensor].fault_ms = t32Now_ms;
+}
+
+void Device::update_health() {
+  uint32_t t32CurrentTime = m_pHAL->scheduler->millis();
+  uint32_t iWindow_ms     = t32CurrentTime - m_t32HealthWin;
+  bool     bNewWindow     = iWindow_ms >= HLT_RATE_T_MS;
 
-  bOK = false;
-  // Break when no device was found
-  if(!pDev) {
-    return fGForce;
+  uint_fast16_t iRaise = 0;
+  uint_fast16_t iClear = 0;
+  for(uint_fast8_t i = 0; i < HLT_NR_OF_SENSORS; i++) {
+    SensorHealth     &health = m_rgHealth[i];
+    const HealthRule &rule   = HEALTH_TABLE[i];
+
+    // A sensor is monitored after its first update, so missing hardware is not flagged
+    if(health.update_ms > 0) {
+      bool bStale  = t32CurrentTime - health.update_ms > rule.stale_ms;
+      bool bFrozen = rule.frozen_ms > 0 && t32CurrentTime - health.change_ms > rule.frozen_ms;
+      if(bStale || bFrozen) {
+        health.fault_ms = t32CurrentTime;
+      }
+    }
+
+    // Hysteresis: A sensor is only healthy again after HLT_CLEAR_MS without faults
+    if(health.fault_ms > 0 && t32CurrentTime - health.fault_ms < HLT_CLEAR_MS) {
+      iRaise       |= rule.flags;
+      m_iHealthMap &= ~(1 << i);
+    } else if(health.update_ms > 0) {
+      iClear       |= rule.latch ? 0 : rule.flags;
+      m_iHealthMap |= 1 << i;
+    }
+
+    if(bNewWindow) {
+      uint32_t iUpdate_hz = health.updates * 1000UL / iWindow_ms;
+      uint32_t iChange_hz = health.changes * 1000UL / iWindow_ms;
+      health.update_hz = iUpdate_hz > 255 ? 255 : iUpdate_hz;
+      health.change_hz = iChange_hz > 255 ? 255 : iChange_hz;
+      health.updates   = 0;
+      health.changes   = 0;
+    }
   }
-  // Sanity check
-  if(abs(pDev->get_atti_raw_deg().x) > INERT_ANGLE_BIAS || abs(pDev->get_atti_raw_deg().y) > INERT_ANGLE_BIAS) {
-    return fGForce;
+  if(bNewWindow) {
+    m_t32HealthWin = t32CurrentTime;
   }
 
-  float fCFactor = 100.f * INERT_G_CONST;
-  float fG       = pDev->get_accel_mg_cmss().x / fCFactor;
-  fGForce        = SFilter::low_pass_filt_f(fG, fGForce, ACCEL_LOWPATH_FILT_f);
-
-  bOK = true;
-  return fGForce;
+  // A raised flag always wins
+  uint_fast16_t iErrors = rem_flag(add_flag(m_eErrors, iRaise), iClear & ~iRaise);
+  m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(iErrors != 0 ? iErrors : NOTHING_F);
 }
 
-float Device::get_accel_y_g(Device *pDev, bool &bOK) {
-  static float fGForce = 0.f;
+void Device::update_loop_stats(const uint32_t iPeriod_us) {
+  m_iLoopMin_us  = iPeriod_us < m_iLoopMin_us ? iPeriod_us : m_iLoopMin_us;
+  m_iLoopMax_us  = iPeriod_us > m_iLoopMax_us ? iPeriod_us : m_iLoopMax_us;
+  m_iLoopSum_us += iPeriod_us;
+  m_iLoopCnt++;
 
-  bOK = false;
-  // Break when no device was found
-  if(!pDev) {
-    return fGForce;
+  // Publish the statistics of the window and start a new one
+  if(dt_us(m_Frame.timestamp_us, m_t32LoopWin) < LOOP_STATS_T_MS * 1000UL) {
+    return;
   }
-  // Sanity check
-  if(abs(pDev->get_atti_raw_deg().x) > INERT_ANGLE_BIAS || abs(pDev->get_atti_raw_deg().y) > INERT_ANGLE_BIAS) {
-    return fGForce;
+  m_ContLoop.min_us     = m_iLoopMin_us;
+  m_ContLoop.max_us     = m_iLoopMax_us;
+  m_ContLoop.avg_us     = m_iLoopSum_us / m_iLoopCnt;
+  m_ContLoop.iterations = m_iLoopCnt;
+
+  m_t32LoopWin  = m_Frame.timestamp_us;
+  m_iLoopMin_us = 0xFFFFFFFFUL;
+  m_iLoopMax_us = 0;
+  m_iLoopSum_us = 0;
+  m_iLoopCnt    = 0;
+}
+
+void Device::update_frame() {
+  uint32_t t32CurrentTime = m_pHAL->scheduler->micros();
+  uint32_t iPeriod_us     = dt_us(t32CurrentTime, m_Frame.timestamp_us);
+  bool     bFirst         = m_Frame.timestamp_us == 0;
+  m_Frame.timestamp_us    = t32CurrentTime;
+  // The first frame has no predecessor
+  if(!bFirst) {
+    m_Frame.dt_s = static_cast<float>(iPeriod_us) / 1000000.f;
+    update_loop_stats(iPeriod_us);
   }
+  m_Frame.valid          = SensorFrame::NOTHING_F;
 
-  float fCFactor = 100.f * INERT_G_CONST;
-  float fG       = pDev->get_accel_mg_cmss().y / fCFactor;
-  fGForce        = SFilter::low_pass_filt_f(fG, fGForce, ACCEL_LOWPATH_FILT_f);
-
-  bOK = true;
-  return fGForce;
-}
+  m_Frame.atti_deg       = get_atti_cor_deg();
+  m_Frame.gyro_deg       = get_gyro_cor_deg();
+  if(m_pInert->healthy() ) {
+    m_Frame.valid |= SensorFrame::ATTITUDE_F;
+  }
 
-float Device::get_accel_z_g(Device *pDev, bool &bOK) {
-  static float fGForce = 0.f;
+  // Acceleration in g: Only usable if the model is not tilted too much
+  if(fabs(m_vAtti_deg.x) <= INERT_ANGLE_BIAS && fabs(m_vAtti_deg.y) <= INERT_ANGLE_BIAS) {
+    const float fCFactor = 100.f * INERT_G_CONST;
+    Vector3f vAccel_g    = Vector3f(m_vAccelMG_cmss.x, m_vAccelMG_cmss.y, -m_vAccelMG_cmss.z) / fCFactor;
+    m_Frame.accel_g      = SFilter::low_pass_filt_V3f(vAccel_g, m_Frame.accel_g, ACCEL_LOWPATH_FILT_f);
+    m_Frame.valid       |= SensorFrame::ACCEL_F;
+  }
 
-  bOK = false;
-  // Break when no device was found
-  if(!pDev) {
-    return fGForce;
+  // Altitude estimation in cm: The barometer and the range finder correct the filter in their tasks
+  if(!bFirst && (m_Frame.valid & SensorFrame::ATTITUDE_F) ) {
+    m_AltKF.predict(read_accel_ef_z_cmss(), m_Frame.dt_s);
   }
-  // Sanity check
-  if(abs(pDev->get_atti_raw_deg().x) > INERT_ANGLE_BIAS || abs(pDev->get_atti_raw_deg().y) > INERT_ANGLE_BIAS) {
-    return fGForce;
+  if(m_AltKF.is_initialized() ) {
+    m_Frame.valid |= SensorFrame::ALTITUDE_F;
   }
+  m_Frame.altitude_cm    = m_AltKF.get_altitude_cm();
+  m_Frame.climb_rate_cms = m_AltKF.get_climb_rate_cms();
 
-  float fCFactor = 100.f * INERT_G_CONST;
-  float fG       = -pDev->get_accel_mg_cmss().z / fCFactor;
-  fGForce        = SFilter::low_pass_filt_f(fG, fGForce, ACCEL_LOWPATH_FILT_f);
+  m_Frame.heading_deg    = m_ContComp.heading_deg;
+  if(m_ContComp.timestamp_ms > 0) {
+    m_Frame.valid |= SensorFrame::COMPASS_F;
+  }
 
-  bOK = true;
-  return fGForce;
+  m_Frame.voltage_V      = m_ContBat.voltage_V;
+  m_Frame.refVoltage_V   = m_ContBat.refVoltage_V;
+  m_Frame.loadVoltage_V  = m_ContBat.load_V;
+  if( m_ContBat.refVoltage_V > 0.f &&
+      in_range(BATT_MIN_VOLTAGE, BATT_MAX_VOLTAGE, m_ContBat.voltage_V) )
+  {
+    m_Frame.valid |= SensorFrame::BATTERY_F;
+  }
 }
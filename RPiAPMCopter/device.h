@@ -5,9 +5,10 @@
 #include <stddef.h>
 
 #include <AP_Math.h>
-#include <PID.h>
 
 #include "containers.h"
+#include "controller.h"
+#include "filter.h"
 #include "absdevice.h"
 #include "config.h"
 
@@ -26,18 +27,43 @@ class BaroData;
 class BattData;
 class GPSData;
 
-class PID;
-
 
 class DeviceInit : public AbsErrorDevice {
+public:
+  // Set if the initialization (and calibration) of a sensor is complete
+  enum INIT_FLAGS {
+    INIT_NOTHING_F    = 0,
+    INIT_BAROMETER_F  = 1 << 0,
+    INIT_INERTIAL_F   = 1 << 1,
+    INIT_COMPASS_F    = 1 << 2,
+    INIT_BATTMON_F    = 1 << 3,
+    INIT_INERT_NAV_F  = 1 << 4,
+    INIT_COMPLETE_F   = (1 << 5) - 1
+  };
+
 protected:
   // PID configuration and remote contro
-  PID m_rgPIDS[NR_OF_PIDS];
+  PIDCtrl m_rgPIDS[NR_OF_PIDS];
 
-  uint_fast32_t m_t32Inertial;      // For calculating the derivative of the angular changes
-  uint_fast32_t m_t32InertialNav;
-  uint_fast32_t m_t32Compass;
+  uint32_t      m_t32Inertial;      // For calculating the derivative of the angular changes (in us)
+  uint32_t      m_t32InertialNav;   // in us
   uint_fast8_t  m_iUpdateRate;      // Suggested update rate of the main loop, dependent on the usage of the 3DR radio on uartC
+  uint_fast8_t  m_iInitFlags;       // INIT_FLAGS
+
+  // State of the non-blocking calibrations
+  uint_fast32_t m_t32Barometer;
+  uint_fast8_t  m_iBaroCalCnt;
+  uint_fast16_t m_iGyroCalCnt;
+  Vector3f      m_vGyroCalSum;
+  Vector3f      m_vGyroCalLast;
+
+  // Gyrometer offsets learned per board temperature bin
+  Vector3f      m_rgGyroTComp[INERT_TCOMP_BINS];
+  uint_fast8_t  m_iGyroTCompMask;   // Bit set if the bin was learned
+  uint_fast32_t m_t32GyroTComp;
+
+  void         learn_gyro_tcomp(const float fTemp_deg, const Vector3f &vOffs);
+  bool         calc_gyro_tcomp (const float fTemp_deg, Vector3f &vOffs) const;  // False if the bin of the temperature was not learned yet
 
 public /*objects*/: 
   // Hardware abstraction library interface
@@ -70,9 +96,22 @@ public /*functions*/:
   void         init_batterymon();
   void         init_rf();
   void         init_inertial_nav();
+
+  // Non-blocking calibrations: Must be called repeatedly after the init function until they return true
+  bool         calib_barometer();   // Sets the ground pressure after the barometer settled
+  bool         calib_gyrometer();   // Averages the gyrometer until two windows match (model not moved) or uses the learned offsets for the board temperature
+
+  // Temperature compensation of the gyrometer: Applies the learned offsets for the current board temperature
+  void         update_gyro_tcomp();
+  bool         get_gyro_tcomp(const uint_fast8_t iBin, Vector3f &vOffs) const;
+  void         set_gyro_tcomp(const uint_fast8_t iBin, const Vector3f &vOffs, const bool bValid);
+
+  bool         is_initialized(const uint_fast8_t flags) const;
   
-  PID          get_pid(uint_fast8_t) const;
-  void         set_pid(uint_fast8_t, PID);
+  // Reference to the controller, so the state (integrator, derivative) is kept between the calls
+  PIDCtrl       &get_pid(uint_fast8_t);
+  const PIDCtrl &get_pid(uint_fast8_t) const;
+  void         set_pid(uint_fast8_t, const PIDCtrl &);
   
   // Suggests an update rate in ms for the main loop
   // The rate is linked with the usage of the 3DR radio
@@ -85,6 +124,18 @@ public /*functions*/:
 // Container for sensor data and sensor configuration
 ///////////////////////////////////////////////////////////
 class Device : public DeviceInit {
+public:
+  // Sensors of the health monitor; Also the bit positions of the health bitmap
+  enum HEALTH_SENSORS {
+    HLT_INERTIAL = 0,
+    HLT_BAROMETER,
+    HLT_COMPASS,
+    HLT_GPS,
+    HLT_BATTMON,
+    HLT_RANGEFNDR,
+    HLT_NR_OF_SENSORS
+  };
+
 private /*variables*/:
   // Used with low path filter
   Vector3f m_vAccelPG_cmss;         // acceleration readout
@@ -94,13 +145,17 @@ private /*variables*/:
   float m_fInertPitCor;             // +/-: left to right or right to left
   float m_fInertRolCor;             // +/-: front to back or back to front
   
-  float m_fCmpH;                    // Compass heading
   float m_fGpsH;                    // GPS heading  
 
 private /*functions*/:
   // Not updating the inertial, to avoid double updates on other spots in the code
   Vector3f     read_gyro_deg();        // converts sensor relative readout to absolute attitude in degrees and saves in m_vGyro_deg
   Vector3f     read_accl_deg();        // converts sensor relative readout to absolute attitude and saves in m_vAccel_deg
+  float        read_accel_ef_z_cmss(); // Upwards acceleration in the earth frame without G-const.
+
+  // Called by the read functions: Cheap book keeping for the health monitor
+  void         mark_update(const uint_fast8_t iSensor, const uint32_t t32Now_ms, const bool bChanged);
+  void         mark_fault (const uint_fast8_t iSensor, const uint32_t t32Now_ms);
   
 protected /*variables*/:
   // x = pitch, y = roll, z = yaw
@@ -109,9 +164,27 @@ protected /*variables*/:
   Vector3f     m_vAtti_deg;
   int_fast16_t m_iAltitude_cm;
   // misc
+  CompData     m_ContComp;
   BaroData     m_ContBaro;
   GPSData      m_ContGPS;
   BattData     m_ContBat;
+  // Altitude fusion of barometer, accelerometer and range finder
+  AltitudeKF   m_AltKF;
+  // Published once per iteration of the main loop
+  SensorFrame  m_Frame;
+  // Timing of the main loop
+  LoopStats    m_ContLoop;          // Statistics of the last complete window
+  uint32_t     m_t32LoopWin;        // Start of the current window (in us)
+  uint32_t     m_iLoopMin_us;
+  uint32_t     m_iLoopMax_us;
+  uint32_t     m_iLoopSum_us;
+  uint_fast16_t m_iLoopCnt;
+  // Sensor health monitor
+  SensorHealth m_rgHealth[HLT_NR_OF_SENSORS];
+  uint_fast8_t m_iHealthMap;        // Bit set if the sensor (HEALTH_SENSORS) is healthy
+  uint32_t     m_t32HealthWin;      // Start of the current rate window (in ms)
+
+  void         update_loop_stats(const uint32_t iPeriod_us);
   
 public:
   // Accepts pointers to abstract base classes to handle different sensor types
@@ -119,11 +192,21 @@ public:
 
   // Setter and getter for inertial adjustments
   void         set_trims(float fRoll_deg, float fPitch_deg);
+  float        get_trim_rol_deg() const;
+  float        get_trim_pit_deg() const;
   
   void         update_inav();       // Update inertial navigation (accelerometer, barometer, GPS sensor fusion)
   void         update_attitude();   // Calls: read_gyro_deg() and read_accl_deg() and saves results to m_vAtti_deg, m_vGyro_deg and m_vAccel_deg
-
-  // updating the sensors
+  void         update_frame();      // Publishes the sensor frame: Must be called once per iteration after update_attitude()
+  /*
+   * Sensor health monitor: Must be called once per iteration.
+   * Raises the error flags of stale or frozen sensors
+   * and clears them again if there was no fault for HLT_CLEAR_MS (hysteresis).
+   * The flags of the inertial sensor stay set until the motors stopped.
+   */
+  void         update_health();
+
+  // updating the sensors: Only called by the sensor tasks, everything else reads the cached values (get_*)
   BaroData     read_baro();
   float        read_comp_deg();
   GPSData      read_gps();
@@ -143,16 +226,17 @@ public:
   Vector3f     get_accel_mg_cmss();  // Acceleration without the G-const (filtered out)
 
   float        get_comp_deg();       // Just return the last estimated compass
+  CompData     get_comp();           // Just return the last estimated compass with time stamp
   BaroData     get_baro();           // Just return the filtered barometer data
   GPSData      get_gps();            // Just return the last estimated gps data
   BattData     get_bat();            // Just return the last estimated battery data
   int_fast32_t get_rf_cm();          // Altitude estimate using range finder
 
-  // Altitude estimation in cm with support for sonar
-  static float get_altitude_cm(Device *pDev, bool &bOK);
-  static float get_accel_x_g  (Device *pDev, bool &bOK);
-  static float get_accel_y_g  (Device *pDev, bool &bOK);
-  static float get_accel_z_g  (Device *pDev, bool &bOK);
+  // Consistent view on the sensors for the controllers, the exception handler and the telemetry
+  const SensorFrame &get_frame() const;
+  LoopStats    get_loop_stats() const;
+  uint_fast8_t get_health() const;   // Bitmap of the healthy sensors (HEALTH_SENSORS)
+  const SensorHealth &get_health(const uint_fast8_t iSensor) const;
 };
 
 #endif
@@ -7,6 +7,7 @@
 #include "receiver.h"
 #include "device.h"
 #include "absdevice.h"
+#include "arithmetics.h"
 
 
 /*
@@ -67,19 +68,81 @@ void ExeptionDevice::dsbl_gpsnav_recvr() {
 ///////////////////////////////////////////////////////////////////////////////////////
 // Exception
 ///////////////////////////////////////////////////////////////////////////////////////
+/*
+ * Fault table:
+ * - Gyrometer/accelerometer: The attitude estimate is unreliable, go down straight
+ * - Battery at the end: Go down straight
+ * - Receiver time-out: Go down until a packet arrives
+ * - Geofence breached: Go down until the model was inside for FENCE_HOLD_MS (or landed);
+ *   There is no way back: After a horizontal breach the model lands outside of the fence
+ * - Barometer: The height calculation would be likely unreliable (GPS probably not stable)
+ * - Compass or GPS: The GPS navigation shouldn't be used at all
+ */
+static const Exception::FaultRule FAULT_TABLE[] = {
+  { AbsErrorDevice::GYROMETER_F,    Exception::FS_DEVICE_DOWN_S, Exception::FS_NOTHING_F },
+  { AbsErrorDevice::ACCELEROMETR_F, Exception::FS_DEVICE_DOWN_S, Exception::FS_NOTHING_F },
+  { AbsErrorDevice::CURRENT_LOW_F,  Exception::FS_DEVICE_DOWN_S, Exception::FS_NOTHING_F },
+  { AbsErrorDevice::UART_TIMEOUT_F, Exception::FS_RCVR_DOWN_S,   Exception::FS_NOTHING_F },
+  { AbsErrorDevice::GEOFENCE_F,     Exception::FS_FENCE_S,       Exception::FS_NOTHING_F },
+  { AbsErrorDevice::BAROMETER_F,    Exception::FS_DEGRADED_S,    Exception::FS_DSBL_ALTHLD_F },
+  { AbsErrorDevice::COMPASS_F,      Exception::FS_DEGRADED_S,    Exception::FS_DSBL_GPSNAV_F },
+  { AbsErrorDevice::GPS_F,          Exception::FS_DEGRADED_S,    Exception::FS_DSBL_GPSNAV_F }
+};
+
 Exception::Exception(Device *pDevice, Receiver *pReceiver) : ExeptionDevice(pDevice, pReceiver) {
+  m_eState       = FS_NONE_S;
+  m_iActions     = FS_NOTHING_F;
   m_bPauseTD     = false;
   m_iPauseTDTime = 0;
+  m_fStepC       = 15.f;   // Default step size
+
+  m_t32Now = m_t32Pause = m_t32Altitude = m_t32Device = m_pHalBoard->m_pHAL->scheduler->micros();
+}
+
+Exception::FAILSAFE_STATE Exception::get_state() const {
+  return m_eState;
+}
+
+Exception::FAILSAFE_STATE Exception::resolve(const uint_fast16_t iMask, uint_fast8_t &iActions) const {
+  FAILSAFE_STATE eState = FS_NONE_S;
+  iActions = FS_NOTHING_F;
+
+  for(uint_fast8_t i = 0; i < sizeof(FAULT_TABLE) / sizeof(FAULT_TABLE[0]); i++) {
+    if(!(iMask & FAULT_TABLE[i].mask) ) {
+      continue;
+    }
+    eState    = FAULT_TABLE[i].state > eState ? FAULT_TABLE[i].state : eState;
+    iActions |= FAULT_TABLE[i].actions;
+  }
+  return eState;
+}
 
-  m_t32Pause = m_t32Altitude = m_t32Device = m_pHalBoard->m_pHAL->scheduler->millis();
+void Exception::enter(const FAILSAFE_STATE eState) {
+  #if DEBUG_OUT and !BENCH_OUT
+  m_pHalBoard->m_pHAL->console->printf_P(PSTR("Failsafe state: %d -> %d\n"), m_eState, eState);
+  #endif
+
+  // Give the control back to the receiver, if a take down ended
+  if(eState < FS_FENCE_S) {
+    write_recvr();
+    if(m_eState >= FS_FENCE_S && m_pReceiver->get_waypoint()->mode == GPSPosition::CONTRLD_DOWN_F) {
+      m_pReceiver->get_waypoint()->mode = GPSPosition::NOTHING_F;
+    }
+  }
+  // Each take down starts with the current throttle and without pause.
+  // A change between the take down states (e.g. receiver -> device) keeps the saved channels,
+  // so the reduction time and the pauses carry over and the throttle continues to fall from where it is.
+  if(eState >= FS_FENCE_S && m_eState < FS_FENCE_S) {
+    m_t32Device    = m_t32Now;
+    m_bPauseTD     = false;
+    m_iPauseTDTime = 0;
+  }
+  m_eState = eState;
 }
 
 void Exception::dev_take_down() {
-  static bool bInertTimer = false;
-  
   // If motors do not spin: reset & return
   if(m_pReceiver->get_channel(RC_THR) == RC_THR_OFF) {
-    bInertTimer = false;
     m_pHalBoard->set_errors(AbsErrorDevice::NOTHING_F);
     m_pReceiver->get_waypoint()->mode = GPSPosition::NOTHING_F;
     write_recvr();
@@ -94,14 +157,9 @@ void Exception::dev_take_down() {
     return;
   }
 
-  // Set timer one time, to calculate how much the motors should be reduced
-  if(bInertTimer == false) {
-    m_t32Device = m_pHalBoard->m_pHAL->scheduler->millis();
-    bInertTimer = true;
-  }
   // Override the receiver, no matter what happens
   if(read_recvr() ) {
-    reduce_thr(m_pHalBoard->m_pHAL->scheduler->millis() - m_t32Device - m_iPauseTDTime);
+    reduce_thr(dt_us(m_t32Now, m_t32Device) / 1000.f - m_iPauseTDTime);
   }
 }
 
@@ -125,95 +183,86 @@ void Exception::rcvr_take_down() {
   }
   // Remove the override if there was a new package within the interval
   if(read_recvr() ) {
-    reduce_thr(packet_t - COM_PKT_TIMEOUT - m_iPauseTDTime);
+    reduce_thr(dt_us(m_t32Now, m_t32Device) / 1000.f - m_iPauseTDTime);
+  }
+}
+
+void Exception::fence_take_down() {
+  // If motors do not spin: reset & return
+  if(m_pReceiver->get_channel(RC_THR) == RC_THR_OFF) {
+    m_pReceiver->get_waypoint()->mode = GPSPosition::NOTHING_F;
+    write_recvr();
+    return;
+  } else {
+    // Set the flag that copter is in controlled take down mode
+    m_pReceiver->get_waypoint()->mode = GPSPosition::CONTRLD_DOWN_F;
+  }
+
+  // Don't reduce speed of the motors if pause set
+  if(m_bPauseTD == true) {
+    return;
+  }
+
+  // Override the receiver until the model is inside again
+  if(read_recvr() ) {
+    reduce_thr(dt_us(m_t32Now, m_t32Device) / 1000.f - m_iPauseTDTime);
   }
 }
 
 bool Exception::handle() {
-  //////////////////////////////////////////////////////////////////////////////////////////
-  // Device handler
-  //////////////////////////////////////////////////////////////////////////////////////////
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::GYROMETER_F) {     // Gyrometer was not healthy: Go down straight
-    #if DEBUG_OUT and !BENCH_OUT
-    m_pHalBoard->m_pHAL->console->printf("Inertial exception - Taking model down\n");
-    #endif
-    
-    dev_take_down();
-    return true;
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::ACCELEROMETR_F) {  // Accelerometer was not healthy: Go down straight
-    #if DEBUG_OUT and !BENCH_OUT
-    m_pHalBoard->m_pHAL->console->printf("Inertial exception - Taking model down\n");
-    #endif
-    
-    dev_take_down();
-    return true;
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::BAROMETER_F) {     // If barometer is not working, the height calculation would be likely unreliable (GPS probably not stable)
-    #if DEBUG_OUT and !BENCH_OUT
-    m_pHalBoard->m_pHAL->console->printf("barometer exception - disable hold altitude\n");
-    #endif
-    
-    dsbl_althld_recvr();
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::COMPASS_F) {       // If Compass not working, the GPS navigation shouldn't be used
-    dsbl_gpsnav_recvr();
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::GPS_F) {           // And if GPS not working, the GPS navigation shouldn't be used at all :D
-    dsbl_gpsnav_recvr();
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::VOLTAGE_HIGH_F) {
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::VOLTAGE_LOW_F) {
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::CURRENT_HIGH_F) {
-  }
-  if(m_pHalBoard->get_errors() & AbsErrorDevice::CURRENT_LOW_F) {   // Battery is at the end: Go down straight
-    #if DEBUG_OUT and !BENCH_OUT
-    m_pHalBoard->m_pHAL->console->printf("current exception - Taking model down\n");
-    #endif
-    
-    dev_take_down();
-    return true;
-  }
-
-  //////////////////////////////////////////////////////////////////////////////////////////
-  // Remote control handler
-  //////////////////////////////////////////////////////////////////////////////////////////
-  if(m_pReceiver->get_errors() & AbsErrorDevice::UART_TIMEOUT_F) {
-    #if DEBUG_OUT
-    m_pHalBoard->m_pHAL->console->printf("No signal from receiver for more than %d ms\n", COM_PKT_TIMEOUT);
-    #endif
-    
-    rcvr_take_down();
-    return true;
-  }
-
-  return false;
+  // All timers of this iteration use the time stamp of the sensor frame
+  m_t32Now = m_pHalBoard->get_frame().timestamp_us;
+
+  // Single read of the combined error mask: The flags of the device and the receiver don't overlap
+  uint_fast16_t iMask = m_pHalBoard->get_errors() | m_pReceiver->get_errors();
+
+  FAILSAFE_STATE eState = resolve(iMask, m_iActions);
+  if(eState != m_eState) {
+    enter(eState);
+  }
+
+  switch(m_eState) {
+    case FS_DEVICE_DOWN_S:
+      dev_take_down();
+      return true;
+    case FS_RCVR_DOWN_S:
+      rcvr_take_down();
+      return true;
+    case FS_FENCE_S:
+      fence_take_down();
+      return true;
+    case FS_DEGRADED_S:
+      if(m_iActions & FS_DSBL_ALTHLD_F) {
+        dsbl_althld_recvr();
+      }
+      if(m_iActions & FS_DSBL_GPSNAV_F) {
+        dsbl_gpsnav_recvr();
+      }
+      return false;
+    default:
+      return false;
+  }
 }
 
 void Exception::reduce_thr(float fTime) {
-  static float fStepC = 15.f;   // Default step size
-
   // The speed of decreasing the throttle is dependent on the height
-  uint_fast32_t iAltitudeTime = m_pHalBoard->m_pHAL->scheduler->millis() - m_t32Altitude;
-  if(iAltitudeTime > INAV_T_MS) {
-    bool bOK = false;
-    float fAlti_m = Device::get_altitude_cm(m_pHalBoard, bOK) / 100.f;
-    if(bOK == true) {
-      fStepC = go_down_t(fAlti_m, m_rgChannelsRC[RC_THR]);
-      fStepC = fStepC < THR_MIN_STEP_S ? THR_MIN_STEP_S : fStepC;
+  if(dt_us(m_t32Now, m_t32Altitude) > INAV_T_MS * 1000UL) {
+    const SensorFrame &frame = m_pHalBoard->get_frame();
+    float fAlti_m = frame.altitude_cm / 100.f;
+    if(frame.valid & SensorFrame::ALTITUDE_F) {
+      m_fStepC = go_down_t(fAlti_m, m_rgChannelsRC[RC_THR]);
+      m_fStepC = m_fStepC < THR_MIN_STEP_S ? THR_MIN_STEP_S : m_fStepC;
     }
     // Save some variables and set timer
-    m_t32Altitude   = m_pHalBoard->m_pHAL->scheduler->millis();
+    m_t32Altitude   = m_t32Now;
   }
   
   // Calculate how much to reduce throttle
-  float fTConst = (THR_MOD_STEP_S * (fTime / fStepC) );
+  float fTConst = (THR_MOD_STEP_S * (fTime / m_fStepC) );
   int_fast16_t fThr = m_rgChannelsRC[RC_THR] - static_cast<int_fast16_t>(fTConst);
 
   #if DEBUG_OUT
-  m_pHalBoard->m_pHAL->console->printf("Reduce throttle - fStepC: %f, fThr: %d\n", fStepC, fThr);
+  m_pHalBoard->m_pHAL->console->printf_P(PSTR("Reduce throttle - fStepC: %f, fThr: %d\n"), m_fStepC, fThr);
   #endif
   
   // reduce throttle..
@@ -225,8 +274,11 @@ void Exception::reduce_thr(float fTime) {
 }
 
 void Exception::pause_take_down() {
+  if(m_bPauseTD == true) {
+    return;
+  }
   m_bPauseTD = true;
-  m_t32Pause = m_pHalBoard->m_pHAL->scheduler->millis();
+  m_t32Pause = m_t32Now;
 }
 
 void Exception::cont_take_down() {
@@ -235,5 +287,5 @@ void Exception::cont_take_down() {
   }
 
   m_bPauseTD = false;
-  m_iPauseTDTime += m_pHalBoard->m_pHAL->scheduler->millis() - m_t32Pause;
+  m_iPauseTDTime += dt_us(m_t32Now, m_t32Pause) / 1000UL;
 }
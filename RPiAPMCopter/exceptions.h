@@ -35,14 +35,56 @@ public:
   ExeptionDevice(Device *, Receiver *);
 };
 
+/*
+ * Failsafe state machine:
+ * All error flags of the device and the receiver are read once per iteration
+ * and resolved by a table (see exceptions.cpp) into the state with the highest priority.
+ * Each state has its own action, which is executed in every iteration.
+ */
 class Exception : public ExeptionDevice {
+public:
+  // Ordered by priority: If several faults occur, the highest state wins
+  enum FAILSAFE_STATE {
+    FS_NONE_S = 0,                                             // Everything fine
+    FS_DEGRADED_S,                                             // Altitude hold and/or GPS navigation disabled
+    FS_FENCE_S,                                                // Outside of the geofence: Take the model down until it is inside again
+    FS_RCVR_DOWN_S,                                            // No RC packets: Take the model down until a packet arrives
+    FS_DEVICE_DOWN_S                                           // Inertial sensor or battery broken: Take the model down until the motors stopped
+  };
+
+  // Actions in the degraded state
+  enum FAILSAFE_ACTION {
+    FS_NOTHING_F      = 0,
+    FS_DSBL_ALTHLD_F  = 1 << 0,
+    FS_DSBL_GPSNAV_F  = 1 << 1
+  };
+
+  // One row of the fault table
+  struct FaultRule {
+    uint_fast16_t  mask;                                       // AbsErrorDevice::DEVICE_ERROR_FLAGS
+    FAILSAFE_STATE state;
+    uint_fast8_t   actions;                                    // FAILSAFE_ACTION
+  };
+
 private:
+  FAILSAFE_STATE m_eState;
+  uint_fast8_t   m_iActions;
+  uint32_t       m_t32Now;                                     // Time stamp of the current iteration (sensor frame, in us)
+
   bool m_bPauseTD;
-  uint_fast32_t m_t32Pause;
-  uint_fast32_t m_iPauseTDTime;
+  uint32_t      m_t32Pause;                                    // in us
+  uint_fast32_t m_iPauseTDTime;                                // in ms
 
-  uint_fast32_t m_t32Device;                                   // Timer for calculating the reduction of the throttle
-  uint_fast32_t m_t32Altitude;                                 // Timer for reading the current altitude
+  uint32_t      m_t32Device;                                   // Start of the take down for calculating the reduction of the throttle (in us)
+  uint32_t      m_t32Altitude;                                 // Timer for reading the current altitude (in us)
+  float         m_fStepC;                                      // Current step size of the throttle reduction
+
+  /*
+   * Resolves the combined error mask into the state with the highest priority
+   * and collects the actions of all active faults
+   */
+  FAILSAFE_STATE resolve(const uint_fast16_t iMask, uint_fast8_t &iActions) const;
+  void enter(const FAILSAFE_STATE eState);                     // Transition actions
 
   /*
    * This reduces the throttle.
@@ -66,9 +108,18 @@ protected:
    */
   void rcvr_take_down();  // Calls reduce_thr()
 
+  /*
+   * Like dev_take_down(), but the control is given back
+   * as soon as the model is inside of the geofence again (e.g. below the ceiling).
+   * Receiver::update_fence() holds the breach for FENCE_HOLD_MS, so the timer isn't restarted at the edge.
+   * The model only descends: After a horizontal breach it lands outside of the fence (intended, no fly back).
+   */
+  void fence_take_down(); // Calls reduce_thr()
+
 public:
   Exception(Device *, Receiver *);
-  bool handle();
+  bool handle();                                               // Returns true if the model is taken down
+  FAILSAFE_STATE get_state() const;
 
   void pause_take_down();
   void cont_take_down();
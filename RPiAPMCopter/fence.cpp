@@ -0,0 +1,225 @@
+#include <AP_Math.h>
+#include <math.h>
+#include <float.h>
+
+#include "fence.h"
+#include "arithmetics.h"
+
+#define FENCE_BOUND_MAX     0x7FFFFFFFL
+
+
+///////////////////////////////////////////////////////////
+// Geofence
+///////////////////////////////////////////////////////////
+Geofence::Geofence() {
+  clear();
+}
+
+void Geofence::clear() {
+  m_iCount     = 0;
+  m_iRecvd     = 0;
+  m_iAltMax_cm = 0;
+  m_iOrient    = 1;
+  m_bValid     = false;
+  m_bTracking  = false;
+  m_bInside    = true;
+}
+
+bool Geofence::is_enabled() const {
+  return m_bValid;
+}
+
+uint_fast8_t Geofence::get_count() const {
+  return m_iCount;
+}
+
+uint16_t Geofence::get_received() const {
+  return m_iRecvd;
+}
+
+bool Geofence::set_vertex(const uint_fast8_t iItem, const uint_fast8_t iCount, const int32_t iN_cm, const int32_t iE_cm, const int32_t iAltMax_cm) {
+  if(iCount < 3 || iCount > FENCE_MAX_PTS || iItem >= iCount) {
+    return false;
+  }
+  // A new polygon: The first vertex or a new vertex count restarts the upload,
+  // so the fence is never enabled with vertices (or the ceiling) of the previous polygon
+  if(iItem == 0 || iCount != m_iCount) {
+    clear();
+    m_iCount = iCount;
+  }
+
+  m_rgN_cm[iItem] = iN_cm;
+  m_rgE_cm[iItem] = iE_cm;
+  m_iAltMax_cm    = iAltMax_cm;
+  m_iRecvd       |= 1 << iItem;
+
+  // Replacing a vertex of a complete polygon changes the edges as well
+  m_bTracking     = false;
+  m_bValid        = m_iRecvd == (1 << m_iCount) - 1 && precompute();
+  return true;
+}
+
+void Geofence::shift(const int32_t iN_cm, const int32_t iE_cm) {
+  for(uint_fast8_t i = 0; i < m_iCount; i++) {
+    m_rgN_cm[i] -= iN_cm;
+    m_rgE_cm[i] -= iE_cm;
+  }
+  m_bTracking = false;
+}
+
+bool Geofence::precompute() {
+  // Shoelace formula: The sign of the area gives the inner side of the edges
+  float fArea = 0.f;
+  for(uint_fast8_t i = 0; i < m_iCount; i++) {
+    uint_fast8_t j = (i + 1) % m_iCount;
+    float fDN = static_cast<float>(m_rgN_cm[j] - m_rgN_cm[i]);
+    float fDE = static_cast<float>(m_rgE_cm[j] - m_rgE_cm[i]);
+    float fLen = sqrt(fDN * fDN + fDE * fDE);
+    if(fLen < 1.f) {
+      return false;
+    }
+    m_rgInvLen[i] = 1.f / fLen;
+    fArea += static_cast<float>(m_rgN_cm[i]) * m_rgE_cm[j] - static_cast<float>(m_rgN_cm[j]) * m_rgE_cm[i];
+  }
+  if(fArea == 0.f) {
+    return false;
+  }
+  m_iOrient = fArea > 0.f ? 1 : -1;
+  return true;
+}
+
+/*
+ * Distance to edge iEdge and the position of the foot point along the edge (0: first vertex, 1: second vertex)
+ */
+float Geofence::distance(const uint_fast8_t iEdge, const float fN_cm, const float fE_cm, float &fT) const {
+  uint_fast8_t j = (iEdge + 1) % m_iCount;
+  float fDN = static_cast<float>(m_rgN_cm[j] - m_rgN_cm[iEdge]);
+  float fDE = static_cast<float>(m_rgE_cm[j] - m_rgE_cm[iEdge]);
+  float fPN = fN_cm - m_rgN_cm[iEdge];
+  float fPE = fE_cm - m_rgE_cm[iEdge];
+
+  fT = (fPN * fDN + fPE * fDE) * m_rgInvLen[iEdge] * m_rgInvLen[iEdge];
+  if(fT <= 0.f) {
+    return sqrt(fPN * fPN + fPE * fPE);
+  }
+  if(fT >= 1.f) {
+    fPN -= fDN;
+    fPE -= fDE;
+    return sqrt(fPN * fPN + fPE * fPE);
+  }
+  return fabs(fDN * fPE - fDE * fPN) * m_rgInvLen[iEdge];
+}
+
+bool Geofence::inner_side(const uint_fast8_t iEdge, const float fN_cm, const float fE_cm) const {
+  uint_fast8_t j = (iEdge + 1) % m_iCount;
+  float fDN = static_cast<float>(m_rgN_cm[j] - m_rgN_cm[iEdge]);
+  float fDE = static_cast<float>(m_rgE_cm[j] - m_rgE_cm[iEdge]);
+  float fCross = fDN * (fE_cm - m_rgE_cm[iEdge]) - fDE * (fN_cm - m_rgN_cm[iEdge]);
+  return fCross * m_iOrient > 0.f;
+}
+
+/*
+ * Inside or outside by the nearest feature of the polygon:
+ * The side of the edge, or at a vertex the sides of both adjacent edges
+ * (inside of both at a convex vertex, inside of one at a reflex vertex).
+ */
+bool Geofence::inner_side_near(const uint_fast8_t iEdge, const float fT, const float fN_cm, const float fE_cm) const {
+  if(fT > 0.f && fT < 1.f) {
+    return inner_side(iEdge, fN_cm, fE_cm);
+  }
+
+  // Edges before and after the vertex
+  uint_fast8_t iA = fT <= 0.f ? (iEdge + m_iCount - 1) % m_iCount : iEdge;
+  uint_fast8_t iB = (iA + 1) % m_iCount;
+  uint_fast8_t iV = iB;
+  uint_fast8_t iW = (iB + 1) % m_iCount;
+  float fAN = static_cast<float>(m_rgN_cm[iV] - m_rgN_cm[iA]);
+  float fAE = static_cast<float>(m_rgE_cm[iV] - m_rgE_cm[iA]);
+  float fBN = static_cast<float>(m_rgN_cm[iW] - m_rgN_cm[iV]);
+  float fBE = static_cast<float>(m_rgE_cm[iW] - m_rgE_cm[iV]);
+  bool bConvex = (fAN * fBE - fAE * fBN) * m_iOrient > 0.f;
+
+  bool bA = inner_side(iA, fN_cm, fE_cm);
+  bool bB = inner_side(iB, fN_cm, fE_cm);
+  return bConvex ? bA && bB : bA || bB;
+}
+
+bool Geofence::crossing_test(const int32_t iN_cm, const int32_t iE_cm) const {
+  bool bInside = false;
+  for(uint_fast8_t i = 0; i < m_iCount; i++) {
+    uint_fast8_t j = (i + 1) % m_iCount;
+    if( (m_rgN_cm[i] > iN_cm) == (m_rgN_cm[j] > iN_cm) ) {
+      continue;
+    }
+    float fE_cm = m_rgE_cm[i] + static_cast<float>(iN_cm - m_rgN_cm[i]) * (m_rgE_cm[j] - m_rgE_cm[i]) / (m_rgN_cm[j] - m_rgN_cm[i]);
+    if(iE_cm < fE_cm) {
+      bInside = !bInside;
+    }
+  }
+  return bInside;
+}
+
+void Geofence::update_near(const int32_t iN_cm, const int32_t iE_cm) {
+  const float fN_cm = static_cast<float>(iN_cm);
+  const float fE_cm = static_cast<float>(iE_cm);
+
+  float fNearest = FLT_MAX;
+  float fNearestT = 0.f;
+  uint_fast8_t iNearest = 0;
+
+  m_iNext_cm = FENCE_BOUND_MAX;
+  for(uint_fast8_t i = 0; i < m_iCount; i++) {
+    // The bound of a distant edge stays valid
+    if(m_rgBound_cm[i] <= m_iPath_cm + FENCE_NEAR_CM) {
+      float fT;
+      float fDist = distance(i, fN_cm, fE_cm, fT);
+      m_rgBound_cm[i] = m_iPath_cm + static_cast<int32_t>(fDist);
+      if(fDist < fNearest) {
+        fNearest  = fDist;
+        fNearestT = fT;
+        iNearest  = i;
+      }
+    }
+    m_iNext_cm = m_rgBound_cm[i] < m_iNext_cm ? m_rgBound_cm[i] : m_iNext_cm;
+  }
+
+  // All other edges are further away than FENCE_NEAR_CM, so this is the nearest feature of the polygon.
+  // The position can only pass an edge within this distance, so the side is updated in time.
+  if(fNearest <= FENCE_NEAR_CM) {
+    m_bInside = inner_side_near(iNearest, fNearestT, fN_cm, fE_cm);
+  }
+}
+
+bool Geofence::check(const int32_t iN_cm, const int32_t iE_cm, const int32_t iAlt_cm, const bool bAltValid) {
+  if(!m_bValid) {
+    return false;
+  }
+
+  // A jump further than FENCE_NEAR_CM (e.g. a GPS glitch) could pass an edge unseen: Start over
+  int32_t iStep_cm = labs(iN_cm - m_iLastN_cm) + labs(iE_cm - m_iLastE_cm);
+  if(m_bTracking && iStep_cm >= FENCE_NEAR_CM) {
+    m_bTracking = false;
+  }
+
+  if(!m_bTracking) {
+    // Start: Evaluate all edges once
+    m_iPath_cm = 0;
+    for(uint_fast8_t i = 0; i < m_iCount; i++) {
+      m_rgBound_cm[i] = 0;
+    }
+    update_near(iN_cm, iE_cm);
+    m_bInside   = crossing_test(iN_cm, iE_cm);
+    m_bTracking = true;
+  } else {
+    // |dN| + |dE| is never shorter than the flown distance
+    m_iPath_cm += iStep_cm;
+    if(m_iPath_cm + FENCE_NEAR_CM >= m_iNext_cm) {
+      update_near(iN_cm, iE_cm);
+    }
+  }
+  m_iLastN_cm = iN_cm;
+  m_iLastE_cm = iE_cm;
+
+  bool bCeiling = bAltValid && iAlt_cm > m_iAltMax_cm;
+  return !m_bInside || bCeiling;
+}
@@ -0,0 +1,69 @@
+#ifndef FENCE_h
+#define FENCE_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+
+
+///////////////////////////////////////////////////////////
+// Polygon with a ceiling, stored in the local tangent plane of the navigation origin (cm).
+// The containment check is incremental:
+// Each edge keeps a lower bound of its distance, indexed by the travelled path.
+// As long as the path is shorter than the smallest bound nothing can have changed (O(1)).
+// Otherwise only the edges near the current position are evaluated again
+// and the side of the nearest edge (or vertex) decides about inside and outside.
+///////////////////////////////////////////////////////////
+class Geofence {
+private:
+  int32_t      m_rgN_cm[FENCE_MAX_PTS];       // Vertices relative to the navigation origin
+  int32_t      m_rgE_cm[FENCE_MAX_PTS];
+  float        m_rgInvLen[FENCE_MAX_PTS];     // 1 / length of the edge from vertex i to vertex i+1
+  int32_t      m_rgBound_cm[FENCE_MAX_PTS];   // Edge i is at least (bound - path) away
+  uint_fast8_t m_iCount;                      // Nr. of vertices of the upload
+  uint16_t     m_iRecvd;                      // Bit mask of the uploaded vertices
+  int32_t      m_iAltMax_cm;                  // Ceiling
+  int8_t       m_iOrient;                     // Sign of the cross product of an edge with a point on its inner side
+  bool         m_bValid;                      // All vertices uploaded and the edges precomputed
+
+  // Incremental state
+  int32_t      m_iLastN_cm;
+  int32_t      m_iLastE_cm;
+  int32_t      m_iPath_cm;                    // Upper bound of the distance flown since the start of the tracking
+  int32_t      m_iNext_cm;                    // Smallest bound of all edges
+  bool         m_bInside;
+  bool         m_bTracking;
+
+  bool  precompute();                         // Orientation and edge lengths; False if the polygon is degenerated
+  float distance(const uint_fast8_t iEdge, const float fN_cm, const float fE_cm, float &fT) const;
+  bool  inner_side(const uint_fast8_t iEdge, const float fN_cm, const float fE_cm) const;
+  bool  inner_side_near(const uint_fast8_t iEdge, const float fT, const float fN_cm, const float fE_cm) const;
+  bool  crossing_test(const int32_t iN_cm, const int32_t iE_cm) const;  // Full even-odd test (start of the tracking)
+  void  update_near(const int32_t iN_cm, const int32_t iE_cm);
+
+public:
+  Geofence();
+
+  /*
+   * Upload: Sets vertex iItem of a polygon with iCount vertices.
+   * The fence is enabled as soon as all vertices arrived.
+   * Vertex 0 or a new vertex count restarts the upload (the fence is disabled until it is complete).
+   * Returns false if the index is invalid.
+   */
+  bool set_vertex(const uint_fast8_t iItem, const uint_fast8_t iCount, const int32_t iN_cm, const int32_t iE_cm, const int32_t iAltMax_cm);
+  void clear();
+  void shift(const int32_t iN_cm, const int32_t iE_cm);  // The navigation origin moved by (N, E)
+
+  bool is_enabled() const;
+  uint_fast8_t get_count() const;             // Nr. of vertices of the upload (0: no fence)
+  uint16_t     get_received() const;          // Bit mask of the uploaded vertices
+
+  /*
+   * Must be called at the navigation rate with the current position.
+   * Returns true if the position is outside of the polygon or above the ceiling.
+   */
+  bool check(const int32_t iN_cm, const int32_t iE_cm, const int32_t iAlt_cm, const bool bAltValid);
+};
+
+#endif /*FENCE_h*/
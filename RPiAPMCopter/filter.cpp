@@ -1,3 +1,5 @@
+#include <AP_RangeFinder_MaxsonarI2CXL.h>
+
 #include "filter.h"
 #include "arithmetics.h"
 
@@ -41,3 +43,122 @@ Vector3f SFilter::low_pass_filt_V3f(const Vector3f &fCurSmple, const Vector3f &f
 float SFilter::round_half_f(float fVal) {
   return floorf(fabs(fVal)*2.f) / 2.f * sign_f(fVal);
 }
+
+///////////////////////////////////////////////////////////
+// AltitudeKF
+///////////////////////////////////////////////////////////
+AltitudeKF::AltitudeKF() {
+  m_fBaroOffs_cm = 0.f;
+  m_fBaroLast_cm = 0.f;
+  m_bBaro        = false;
+  reset(0.f);
+}
+
+void AltitudeKF::reset(const float fAlt_cm) {
+  m_fAlt_cm      = fAlt_cm;
+  m_fClimb_cms   = 0.f;
+  m_fBias_cmss   = 0.f;
+  m_iBaroRejects = 0;
+  m_iRFRejects   = 0;
+
+  memset(m_rgP, 0, sizeof(m_rgP) );
+  m_rgP[0][0] = pow2_f(ALT_KF_BARO_SIGMA);
+  m_rgP[1][1] = pow2_f(ALT_KF_ACC_SIGMA);
+  m_rgP[2][2] = pow2_f(ALT_KF_ACC_SIGMA);
+}
+
+void AltitudeKF::predict(const float fAccZ_cmss, const float fDT_s) {
+  if(!m_bBaro || fDT_s <= 0.f || fDT_s > ALT_KF_MAX_DT_S) {
+    return;
+  }
+
+  const float fDT2_s = 0.5f * pow2_f(fDT_s);
+  const float fAcc   = fAccZ_cmss - m_fBias_cmss;
+  m_fAlt_cm    += m_fClimb_cms * fDT_s + fAcc * fDT2_s;
+  m_fClimb_cms += fAcc * fDT_s;
+
+  // P = F * P * F^T with F = [1, dt, -dt²/2; 0, 1, -dt; 0, 0, 1]
+  float rgFP[3][3];
+  for(uint_fast8_t j = 0; j < 3; j++) {
+    rgFP[0][j] = m_rgP[0][j] + fDT_s * m_rgP[1][j] - fDT2_s * m_rgP[2][j];
+    rgFP[1][j] = m_rgP[1][j] - fDT_s * m_rgP[2][j];
+    rgFP[2][j] = m_rgP[2][j];
+  }
+  for(uint_fast8_t i = 0; i < 3; i++) {
+    m_rgP[i][0] = rgFP[i][0] + fDT_s * rgFP[i][1] - fDT2_s * rgFP[i][2];
+    m_rgP[i][1] = rgFP[i][1] - fDT_s * rgFP[i][2];
+    m_rgP[i][2] = rgFP[i][2];
+  }
+
+  // Process noise: Acceleration noise on altitude and climb rate, random walk of the bias
+  const float fVarAcc = pow2_f(ALT_KF_ACC_SIGMA);
+  m_rgP[0][0] += pow2_f(fDT2_s) * fVarAcc;
+  m_rgP[0][1] += fDT2_s * fDT_s * fVarAcc;
+  m_rgP[1][0] += fDT2_s * fDT_s * fVarAcc;
+  m_rgP[1][1] += pow2_f(fDT_s) * fVarAcc;
+  m_rgP[2][2] += pow2_f(ALT_KF_BIAS_SIGMA) * fDT_s;
+}
+
+bool AltitudeKF::correct(const float fMeas_cm, const float fVar, uint8_t &iRejects) {
+  const float fInnov = fMeas_cm - m_fAlt_cm;
+  const float fS     = m_rgP[0][0] + fVar;
+
+  // Outlier gating: A persistent offset means that the estimate is wrong, not the sensor
+  if(pow2_f(fInnov) > pow2_f(ALT_KF_GATE) * fS) {
+    if(++iRejects < ALT_KF_REJECT_MAX) {
+      return false;
+    }
+    float fClimb_cms = m_fClimb_cms;
+    reset(fMeas_cm);
+    m_fClimb_cms = fClimb_cms;
+    return true;
+  }
+  iRejects = 0;
+
+  // The measurement is the altitude only: H = [1, 0, 0]
+  const float rgK[3]  = { m_rgP[0][0] / fS, m_rgP[1][0] / fS, m_rgP[2][0] / fS };
+  const float rgP0[3] = { m_rgP[0][0], m_rgP[0][1], m_rgP[0][2] };
+
+  m_fAlt_cm    += rgK[0] * fInnov;
+  m_fClimb_cms += rgK[1] * fInnov;
+  m_fBias_cmss += rgK[2] * fInnov;
+
+  for(uint_fast8_t i = 0; i < 3; i++) {
+    for(uint_fast8_t j = 0; j < 3; j++) {
+      m_rgP[i][j] -= rgK[i] * rgP0[j];
+    }
+  }
+  return true;
+}
+
+bool AltitudeKF::update_baro(const float fAlt_cm) {
+  m_fBaroLast_cm = fAlt_cm;
+  if(!m_bBaro) {
+    m_bBaro = true;
+    reset(fAlt_cm);
+    return true;
+  }
+  return correct(fAlt_cm - m_fBaroOffs_cm, pow2_f(ALT_KF_BARO_SIGMA), m_iBaroRejects);
+}
+
+bool AltitudeKF::update_rf(const float fDist_cm) {
+  if(!m_bBaro || fDist_cm < 0.f) {
+    return false;
+  }
+
+  // Fade-out: The variance grows to infinity at the maximum distance
+  float fWeight = 1.f;
+  if(fDist_cm > ALT_KF_RF_FADE_CM) {
+    fWeight = 1.f - (fDist_cm - ALT_KF_RF_FADE_CM) / (AP_RANGE_FINDER_MAXSONARI2CXL_MAX_DISTANCE - ALT_KF_RF_FADE_CM);
+  }
+  if(fWeight < 0.05f) {
+    return false;
+  }
+
+  if(!correct(fDist_cm, pow2_f(ALT_KF_RF_SIGMA / fWeight), m_iRFRejects) ) {
+    return false;
+  }
+  // Ground level of the barometer: No step if the range finder gets unusable
+  m_fBaroOffs_cm = SFilter::low_pass_filt_f(m_fBaroLast_cm - m_fAlt_cm, m_fBaroOffs_cm, ALT_KF_OFFS_FILT_f * fWeight);
+  return true;
+}
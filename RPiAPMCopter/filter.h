@@ -6,6 +6,8 @@
 
 #include <AP_Math.h>
 
+#include "config.h"
+
 
 class Functor_f {
 public:
@@ -60,4 +62,42 @@ public:
   static float round_half_f(float);
 };
 
+/*
+ * Kalman filter for the altitude with three states:
+ * altitude (cm), climb rate (cm/s) and bias of the vertical acceleration (cm/s²)
+ * The earth frame acceleration drives the prediction, the barometer and the range finder correct it.
+ * The range finder is faded out smoothly near its maximum distance and the barometer is shifted by a learned offset,
+ * so there is no step if the range finder gets (un-)usable.
+ */
+class AltitudeKF {
+private:
+  float   m_fAlt_cm;
+  float   m_fClimb_cms;
+  float   m_fBias_cmss;
+  float   m_rgP[3][3];                // Covariance
+
+  float   m_fBaroOffs_cm;             // Barometer minus range finder (ground level)
+  float   m_fBaroLast_cm;
+  bool    m_bBaro;                    // Barometer read at least once
+  uint8_t m_iBaroRejects;             // Consecutive outliers
+  uint8_t m_iRFRejects;
+
+  // Returns false if the measurement was rejected as outlier
+  bool    correct(const float fMeas_cm, const float fVar, uint8_t &iRejects);
+
+public:
+  AltitudeKF();
+
+  void    reset(const float fAlt_cm);
+  // fAccZ_cmss: Upwards acceleration in the earth frame without G-const.
+  void    predict(const float fAccZ_cmss, const float fDT_s);
+  bool    update_baro(const float fAlt_cm);
+  bool    update_rf(const float fDist_cm);  // Tilt compensated distance to the ground
+
+  bool    is_initialized() const { return m_bBaro; }
+  float   get_altitude_cm() const { return m_fAlt_cm; }
+  float   get_climb_rate_cms() const { return m_fClimb_cms; }
+  float   get_accel_bias_cmss() const { return m_fBias_cmss; }
+};
+
 #endif
\ No newline at end of file
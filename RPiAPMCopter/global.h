@@ -6,9 +6,14 @@
 #include "scheduler.h"
 #include "device.h"
 #include "receiver.h"
+#if USE_MAVLINK
+#include "mavcom.h"
+#endif
 #include "exceptions.h"
 #include "rcframe.h"
 #include "navigation.h"
+#include "parameters.h"
+#include "boot.h"
 
 
 ///////////////////////////////////////////////////////////
@@ -39,8 +44,15 @@ AP_InertialNav                 _INERT_NAV (_AHRS, _BARO, _GPS_GLITCH);
 ///////////////////////////////////////////////////////////
 Scheduler                      _SCHED     (&hal);
 Device                         _HAL_BOARD (&hal, &_INERT, &_COMP, &_BARO, &_GPS, &_BAT, &_SON_RF, &_AHRS, &_INERT_NAV);
-Receiver                       _RECVR     (&_HAL_BOARD);
+#if USE_MAVLINK
+MAVCom                         _MAVCOM    (&_HAL_BOARD);
+Receiver                       _RECVR     (&_HAL_BOARD, &_MAVCOM);
+#else
+Receiver                       _RECVR     (&_HAL_BOARD, NULL);
+#endif
 Exception                      _EXCP      (&_HAL_BOARD, &_RECVR);
+Parameters                     _PARAM     (&_HAL_BOARD, &_RECVR);
+BootSeq                        _BOOT      (&_HAL_BOARD);
 
 // Currently just a quad-copter with X-frame is implemented
 UAVNav                         _UAV       (&_HAL_BOARD, &_RECVR, &_EXCP);
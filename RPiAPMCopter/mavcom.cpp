@@ -0,0 +1,260 @@
+#include "config.h"
+
+#if USE_MAVLINK
+#include <AP_Progmem.h>
+#include <math.h>
+
+#include "mavcom.h"
+#include "device.h"
+#include "arithmetics.h"
+
+// Parameters: PIDs with MAV_PID_GAINS gains each (order of the PID indices), then the trims
+static const char MAV_PID_NAMES[NR_OF_PIDS][9] PROGMEM = {
+  "PIT_RATE", "ROL_RATE", "PIT_STAB", "ROL_STAB", "YAW_RATE", "YAW_STAB",
+  "THR_RATE", "THR_STAB", "ACC_RATE", "ACC_STAB", "NAV_RATE", "NAV_STAB"
+};
+static const char MAV_GAIN_NAMES[MAV_PID_GAINS][6] PROGMEM = {
+  "_P", "_I", "_D", "_FF", "_FILT", "_IMAX"
+};
+static const char MAV_TRIM_NAMES[2][9] PROGMEM = {
+  "TRIM_ROL", "TRIM_PIT"
+};
+
+
+///////////////////////////////////////////////////////////
+// MAVCom
+///////////////////////////////////////////////////////////
+MAVCom::MAVCom(Device *pDev) {
+  m_pHalBoard = pDev;
+
+  memset(&m_Msg, 0, sizeof(m_Msg) );
+  for(uint_fast8_t i = 0; i < MAV_CHAN_CNT; i++) {
+    m_rgT32Msg[i]     = 0UL - MAV_LOCK_MS;  // Not active from the start
+    m_rgParamNext[i]  = MAV_PARAM_CNT;
+    m_rgParamReply[i] = MAV_PARAM_CNT;
+
+    m_rgRate_hz[i][STR_HEARTBEAT] = 1;
+    m_rgRate_hz[i][STR_STATUS]    = MAV_RATE_STATUS_HZ;
+    m_rgRate_hz[i][STR_RC]        = MAV_RATE_RC_HZ;
+    m_rgRate_hz[i][STR_ATTI]      = MAV_RATE_ATTI_HZ;
+    for(uint_fast8_t j = 0; j < STR_NR_OF_STREAMS; j++) {
+      m_rgT32Sent[i][j] = 0;
+    }
+  }
+}
+
+void MAVCom::init() {
+  mavlink_comm_port[MAVLINK_COMM_0] = m_pHalBoard->m_pHAL->uartA;
+  mavlink_comm_port[MAVLINK_COMM_1] = m_pHalBoard->m_pHAL->uartC;
+  mavlink_system.sysid  = MAV_SYSTEM_ID;
+  mavlink_system.compid = MAV_COMP_ID;
+}
+
+bool MAVCom::is_active(const mavlink_channel_t chan) const {
+  return m_pHalBoard->m_pHAL->scheduler->millis() - m_rgT32Msg[chan] < MAV_LOCK_MS;
+}
+
+const mavlink_message_t *MAVCom::parse(const mavlink_channel_t chan, const uint8_t c, const bool bArmed) {
+  mavlink_status_t status;
+  if(!mavlink_parse_char(chan, c, &m_Msg, &status) ) {
+    return NULL;
+  }
+
+  // Only a HEARTBEAT of a ground station switches the port into the MAVLink mode:
+  // The stop byte of the radio frames v1 is the start byte of MAVLink
+  if(!is_active(chan) && m_Msg.msgid != MAVLINK_MSG_ID_HEARTBEAT) {
+    return NULL;
+  }
+  m_rgT32Msg[chan] = m_pHalBoard->m_pHAL->scheduler->millis();
+
+  handle_message(chan, bArmed);
+  return &m_Msg;
+}
+
+void MAVCom::handle_message(const mavlink_channel_t chan, const bool bArmed) {
+  switch(m_Msg.msgid) {
+    case MAVLINK_MSG_ID_REQUEST_DATA_STREAM: {
+      mavlink_request_data_stream_t req;
+      mavlink_msg_request_data_stream_decode(&m_Msg, &req);
+      if(req.target_system == MAV_SYSTEM_ID) {
+        set_rate(chan, req.req_stream_id, req.start_stop ? req.req_message_rate : 0);
+      }
+    } break;
+
+    case MAVLINK_MSG_ID_PARAM_REQUEST_LIST: {
+      mavlink_param_request_list_t req;
+      mavlink_msg_param_request_list_decode(&m_Msg, &req);
+      if(req.target_system == MAV_SYSTEM_ID) {
+        m_rgParamNext[chan] = 0;
+      }
+    } break;
+
+    case MAVLINK_MSG_ID_PARAM_REQUEST_READ: {
+      mavlink_param_request_read_t req;
+      mavlink_msg_param_request_read_decode(&m_Msg, &req);
+      if(req.target_system != MAV_SYSTEM_ID) {
+        break;
+      }
+      if(req.param_index >= 0) {
+        m_rgParamReply[chan] = req.param_index < MAV_PARAM_CNT ? req.param_index : MAV_PARAM_CNT;
+      } else {
+        // The name is not null terminated if it has 16 characters
+        char cName[17];
+        strncpy(cName, req.param_id, 16);
+        cName[16] = '\0';
+        m_rgParamReply[chan] = find_param(cName);
+      }
+    } break;
+
+    case MAVLINK_MSG_ID_PARAM_SET: {
+      mavlink_param_set_t req;
+      mavlink_msg_param_set_decode(&m_Msg, &req);
+      if(req.target_system != MAV_SYSTEM_ID) {
+        break;
+      }
+      char cName[17];
+      strncpy(cName, req.param_id, 16);
+      cName[16] = '\0';
+      uint_fast8_t iParam = find_param(cName);
+      if(iParam == MAV_PARAM_CNT) {
+        break;
+      }
+      // Invalid values and changes while the motors run are refused, but the current value is still sent back
+      if(!bArmed && !isnan(req.param_value) && !isinf(req.param_value) ) {
+        set_param(iParam, req.param_value);
+      }
+      m_rgParamReply[chan] = iParam;
+    } break;
+
+    default:
+      break;
+  }
+}
+
+void MAVCom::set_rate(const mavlink_channel_t chan, const uint8_t iStreamID, const uint8_t iRate_hz) {
+  uint8_t iRate = iRate_hz > MAV_RATE_MAX_HZ ? MAV_RATE_MAX_HZ : iRate_hz;
+  switch(iStreamID) {
+    case MAV_DATA_STREAM_ALL:
+      m_rgRate_hz[chan][STR_STATUS] = iRate;
+      m_rgRate_hz[chan][STR_RC]     = iRate;
+      m_rgRate_hz[chan][STR_ATTI]   = iRate;
+      break;
+    case MAV_DATA_STREAM_EXTENDED_STATUS:
+      m_rgRate_hz[chan][STR_STATUS] = iRate;
+      break;
+    case MAV_DATA_STREAM_RC_CHANNELS:
+      m_rgRate_hz[chan][STR_RC]     = iRate;
+      break;
+    case MAV_DATA_STREAM_EXTRA1:
+      m_rgRate_hz[chan][STR_ATTI]   = iRate;
+      break;
+    default:
+      break;
+  }
+}
+
+bool MAVCom::stream_due(const mavlink_channel_t chan, const uint_fast8_t iStream, const uint_fast8_t iLen) {
+  uint8_t iRate = m_rgRate_hz[chan][iStream];
+  if(iRate == 0) {
+    return false;
+  }
+  uint_fast32_t t32CurTime = m_pHalBoard->m_pHAL->scheduler->millis();
+  if(t32CurTime - m_rgT32Sent[chan][iStream] < 1000U / iRate) {
+    return false;
+  }
+  // The UART would block if the buffer is full, so the message waits for the next call
+  if(comm_get_txspace(chan) < MAVLINK_NUM_NON_PAYLOAD_BYTES + iLen) {
+    return false;
+  }
+  m_rgT32Sent[chan][iStream] = t32CurTime;
+  return true;
+}
+
+void MAVCom::get_param_name(const uint_fast8_t iParam, char *pName) const {
+  if(iParam < NR_OF_PIDS * MAV_PID_GAINS) {
+    strcpy_P(pName, MAV_PID_NAMES[iParam / MAV_PID_GAINS]);
+    strcat_P(pName, MAV_GAIN_NAMES[iParam % MAV_PID_GAINS]);
+    return;
+  }
+  strcpy_P(pName, MAV_TRIM_NAMES[iParam - NR_OF_PIDS * MAV_PID_GAINS]);
+}
+
+uint_fast8_t MAVCom::find_param(const char *pName) const {
+  char cName[17];
+  for(uint_fast8_t i = 0; i < MAV_PARAM_CNT; i++) {
+    get_param_name(i, cName);
+    if(strcmp(cName, pName) == 0) {
+      return i;
+    }
+  }
+  return MAV_PARAM_CNT;
+}
+
+float MAVCom::get_param(const uint_fast8_t iParam) const {
+  if(iParam >= NR_OF_PIDS * MAV_PID_GAINS) {
+    return iParam == NR_OF_PIDS * MAV_PID_GAINS ? m_pHalBoard->get_trim_rol_deg() : m_pHalBoard->get_trim_pit_deg();
+  }
+
+  const PIDCtrl &pid = m_pHalBoard->get_pid(iParam / MAV_PID_GAINS);
+  switch(iParam % MAV_PID_GAINS) {
+    case 0:  return pid.kP();
+    case 1:  return pid.kI();
+    case 2:  return pid.kD();
+    case 3:  return pid.kFF();
+    case 4:  return pid.filt_hz();
+    default: return pid.imax();
+  }
+}
+
+/*
+ * The changes are written back into the EEPROM by Parameters::update()
+ */
+void MAVCom::set_param(const uint_fast8_t iParam, const float fVal) {
+  if(iParam >= NR_OF_PIDS * MAV_PID_GAINS) {
+    float fRol_deg = m_pHalBoard->get_trim_rol_deg();
+    float fPit_deg = m_pHalBoard->get_trim_pit_deg();
+    if(iParam == NR_OF_PIDS * MAV_PID_GAINS) {
+      fRol_deg = fVal;
+    } else {
+      fPit_deg = fVal;
+    }
+    m_pHalBoard->set_trims(fRol_deg, fPit_deg);
+    return;
+  }
+
+  PIDCtrl &pid = m_pHalBoard->get_pid(iParam / MAV_PID_GAINS);
+  switch(iParam % MAV_PID_GAINS) {
+    case 0:  pid.kP(fVal);      break;
+    case 1:  pid.kI(fVal);      break;
+    case 2:  pid.kD(fVal);      break;
+    case 3:  pid.kFF(fVal);     break;
+    case 4:  pid.filt_hz(fVal); break;
+    default: pid.imax(static_cast<int16_t>(constrain_float(fVal, -32767.f, 32767.f) ) ); break;
+  }
+}
+
+bool MAVCom::send_param(const mavlink_channel_t chan, const uint_fast8_t iParam) {
+  if(comm_get_txspace(chan) < MAVLINK_NUM_NON_PAYLOAD_BYTES + MAVLINK_MSG_ID_PARAM_VALUE_LEN) {
+    return false;
+  }
+  char cName[17];
+  get_param_name(iParam, cName);
+  mavlink_msg_param_value_send(chan, cName, get_param(iParam), MAV_PARAM_TYPE_REAL32, MAV_PARAM_CNT, iParam);
+  return true;
+}
+
+void MAVCom::send_params(const mavlink_channel_t chan) {
+  // Answers first, so a PARAM_SET is confirmed during a long list
+  if(m_rgParamReply[chan] < MAV_PARAM_CNT) {
+    if(send_param(chan, m_rgParamReply[chan]) ) {
+      m_rgParamReply[chan] = MAV_PARAM_CNT;
+    }
+    return;
+  }
+  if(m_rgParamNext[chan] < MAV_PARAM_CNT) {
+    if(send_param(chan, m_rgParamNext[chan]) ) {
+      m_rgParamNext[chan]++;
+    }
+  }
+}
+#endif /*USE_MAVLINK*/
@@ -0,0 +1,95 @@
+#ifndef MAVCOM_h
+#define MAVCOM_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <GCS_MAVLink.h>
+
+#include "config.h"
+
+class Device;
+
+
+/*
+ * Stick positions as PWM (1000-2000 us, centered at 1500) for RC_CHANNELS_RAW and RC_CHANNELS_OVERRIDE
+ */
+inline uint16_t mav_deg_to_pwm(const int_fast32_t iDeg, const int_fast16_t iMax_deg) {
+  return static_cast<uint16_t>(1500 + iDeg * 500 / iMax_deg);
+}
+
+inline int_fast16_t mav_pwm_to_deg(const uint16_t iPWM, const int_fast16_t iMax_deg) {
+  return static_cast<int_fast16_t>( (static_cast<int_fast32_t>(iPWM) - 1500) * iMax_deg / 500);
+}
+
+///////////////////////////////////////////////////////////
+// MAVLink v1 on uartA (MAVLINK_COMM_0) and uartC (MAVLINK_COMM_1)
+// A port switches into the MAVLink mode with the first HEARTBEAT of a ground station
+// and falls back to the text and radio commands after MAV_LOCK_MS without any message.
+// The messages of the streams are sent by output.h, the RC overrides are applied by the receiver.
+///////////////////////////////////////////////////////////
+class MAVCom {
+public:
+  // Streams with their own rate
+  enum MAV_STREAMS {
+    STR_HEARTBEAT = 0,                      // HEARTBEAT (always 1 Hz)
+    STR_STATUS,                             // SYS_STATUS, GPS_RAW_INT (MAV_DATA_STREAM_EXTENDED_STATUS)
+    STR_RC,                                 // RC_CHANNELS_RAW (MAV_DATA_STREAM_RC_CHANNELS)
+    STR_ATTI,                               // ATTITUDE (MAV_DATA_STREAM_EXTRA1)
+    STR_NR_OF_STREAMS
+  };
+
+private:
+  Device           *m_pHalBoard;
+
+  mavlink_message_t m_Msg;                  // Last complete message (too large for the stack)
+  uint_fast32_t     m_rgT32Msg[MAV_CHAN_CNT];                     // Last valid message of a ground station (in ms)
+  uint8_t           m_rgRate_hz[MAV_CHAN_CNT][STR_NR_OF_STREAMS]; // Zero if the stream is off
+  uint_fast32_t     m_rgT32Sent[MAV_CHAN_CNT][STR_NR_OF_STREAMS];
+  uint_fast8_t      m_rgParamNext[MAV_CHAN_CNT];                  // Next parameter of a PARAM_REQUEST_LIST; MAV_PARAM_CNT if there is none
+  uint_fast8_t      m_rgParamReply[MAV_CHAN_CNT];                 // Answer to a PARAM_SET or PARAM_REQUEST_READ; MAV_PARAM_CNT if there is none
+
+  void          set_rate(const mavlink_channel_t chan, const uint8_t iStreamID, const uint8_t iRate_hz);
+  void          get_param_name(const uint_fast8_t iParam, char *pName) const; // Name with a null terminator (at most 16 characters)
+  uint_fast8_t  find_param(const char *pName) const;                          // MAV_PARAM_CNT if unknown
+  float         get_param(const uint_fast8_t iParam) const;
+  void          set_param(const uint_fast8_t iParam, const float fVal);
+  bool          send_param(const mavlink_channel_t chan, const uint_fast8_t iParam);
+
+  // Parameter and stream requests
+  void          handle_message(const mavlink_channel_t chan, const bool bArmed);
+
+public:
+  MAVCom(Device *);
+
+  /*
+   * Assigns the ports to the MAVLink channels.
+   * Must be called after the serial ports were started.
+   */
+  void init();
+
+  /*
+   * Feeds one received byte into the parser of the port.
+   * Returns the message if it is complete and has a valid checksum, otherwise NULL.
+   * Parameter and stream requests are answered here, all other messages are left to the caller (e.g. RC_CHANNELS_OVERRIDE).
+   * A PARAM_SET is refused while bArmed is set (like the PID# command while the motors run), the unchanged value is sent back.
+   */
+  const mavlink_message_t *parse(const mavlink_channel_t chan, const uint8_t c, const bool bArmed);
+
+  // True if the port is in the MAVLink mode
+  bool is_active(const mavlink_channel_t chan) const;
+
+  /*
+   * True if the stream is due on the port and the transmit buffer has room for a message with iLen bytes payload.
+   * Restarts the interval of the stream, so the message must be sent afterwards.
+   */
+  bool stream_due(const mavlink_channel_t chan, const uint_fast8_t iStream, const uint_fast8_t iLen);
+
+  /*
+   * Sends at most one pending parameter per call (requested list or the answer to a request).
+   * Must be called periodically while the port is active.
+   */
+  void send_params(const mavlink_channel_t chan);
+};
+
+#endif /*MAVCOM_h*/
@@ -0,0 +1,165 @@
+#include <AP_Math.h>
+#include <math.h>
+
+#include "mission.h"
+#include "arithmetics.h"
+
+#define LATLON_TO_CM        1.113195f   // cm per 1e-7 degree latitude
+#define Q14                 16384.f
+
+
+///////////////////////////////////////////////////////////
+// NavOrigin
+///////////////////////////////////////////////////////////
+NavOrigin::NavOrigin() {
+  m_iLat    = 0;
+  m_iLon    = 0;
+  m_fScaleN = LATLON_TO_CM;
+  m_fScaleE = LATLON_TO_CM;
+  m_bSet    = false;
+}
+
+void NavOrigin::set(const int32_t iLat, const int32_t iLon) {
+  m_iLat    = iLat;
+  m_iLon    = iLon;
+  m_fScaleN = LATLON_TO_CM;
+  m_fScaleE = LATLON_TO_CM * cos(ToRad(iLat / 10000000.f) );
+  m_bSet    = true;
+}
+
+bool NavOrigin::is_set() const {
+  return m_bSet;
+}
+
+void NavOrigin::to_cm(const int32_t iLat, const int32_t iLon, int32_t &iN_cm, int32_t &iE_cm) const {
+  iN_cm = static_cast<int32_t>( (iLat - m_iLat) * m_fScaleN);
+  iE_cm = static_cast<int32_t>( (iLon - m_iLon) * m_fScaleE);
+}
+
+///////////////////////////////////////////////////////////
+// Mission
+///////////////////////////////////////////////////////////
+Mission::Mission() {
+  clear();
+}
+
+void Mission::clear() {
+  memset(m_rgItems, 0, sizeof(m_rgItems) );
+  m_iCount    = 0;
+  m_iCurrent  = 0;
+  m_iStartLat = 0;
+  m_iStartLon = 0;
+}
+
+void Mission::project(const uint_fast8_t iItem) {
+  MissionItem &item = m_rgItems[iItem];
+  m_Origin.to_cm(item.latitude, item.longitude, item.north_cm, item.east_cm);
+}
+
+void Mission::calc_leg(const uint_fast8_t iItem) {
+  MissionItem &item = m_rgItems[iItem];
+  int32_t iFromN_cm = 0;
+  int32_t iFromE_cm = 0;
+  if(iItem > 0) {
+    iFromN_cm = m_rgItems[iItem-1].north_cm;
+    iFromE_cm = m_rgItems[iItem-1].east_cm;
+  } else {
+    m_Origin.to_cm(m_iStartLat, m_iStartLon, iFromN_cm, iFromE_cm);
+  }
+
+  float fN_cm = static_cast<float>(item.north_cm - iFromN_cm);
+  float fE_cm = static_cast<float>(item.east_cm  - iFromE_cm);
+  float fDist = sqrt(fN_cm * fN_cm + fE_cm * fE_cm);
+
+  item.dist_cm    = static_cast<int32_t>(fDist);
+  // A leg without length: Head north
+  item.unitN_q14  = fDist > 0.f ? static_cast<int16_t>(fN_cm / fDist * Q14) : static_cast<int16_t>(Q14);
+  item.unitE_q14  = fDist > 0.f ? static_cast<int16_t>(fE_cm / fDist * Q14) : 0;
+  item.bearing_cd = static_cast<uint16_t>(wrap360_f(ToDeg(atan2(fE_cm, fN_cm) ) ) * 100.f) % 36000;
+}
+
+void Mission::set_origin(const int32_t iLat, const int32_t iLon) {
+  m_Origin.set(iLat, iLon);
+  for(uint_fast8_t i = 0; i < m_iCount; i++) {
+    project(i);
+  }
+  for(uint_fast8_t i = 0; i < m_iCount; i++) {
+    calc_leg(i);
+  }
+}
+
+const NavOrigin &Mission::get_origin() const {
+  return m_Origin;
+}
+
+bool Mission::set_item(const uint_fast8_t iItem, const uint_fast8_t iCount, const int32_t iLat, const int32_t iLon, const int32_t iAlt_cm) {
+  if(iItem >= iCount || iCount > MISSION_MAX_WP || iItem > m_iCount) {
+    return false;
+  }
+
+  MissionItem &item = m_rgItems[iItem];
+  item.latitude     = iLat;
+  item.longitude    = iLon;
+  item.altitude_cm  = iAlt_cm;
+  if(!m_Origin.is_set() ) {
+    m_Origin.set(iLat, iLon);
+  }
+  project(iItem);
+
+  m_iCount = iItem == m_iCount ? iItem + 1 : m_iCount;
+  m_iCount = iCount < m_iCount ? iCount : m_iCount;
+  m_iCurrent = m_iCurrent < m_iCount ? m_iCurrent : m_iCount - 1;
+
+  // The leg to this item and the leg to the next one changed
+  calc_leg(iItem);
+  if(iItem + 1 < m_iCount) {
+    calc_leg(iItem + 1);
+  }
+  return true;
+}
+
+void Mission::start(const int32_t iLat, const int32_t iLon) {
+  m_iCurrent  = 0;
+  m_iStartLat = iLat;
+  m_iStartLon = iLon;
+  if(m_iCount > 0) {
+    calc_leg(0);
+  }
+}
+
+bool Mission::advance() {
+  if(m_iCurrent + 1 >= m_iCount) {
+    return false;
+  }
+  m_iCurrent++;
+  return true;
+}
+
+void Mission::track(const int32_t iLat, const int32_t iLon, int32_t &iAlong_cm, int32_t &iCross_cm) const {
+  iAlong_cm = iCross_cm = 0;
+  if(m_iCount == 0) {
+    return;
+  }
+
+  const MissionItem &item = m_rgItems[m_iCurrent];
+  int32_t iN_cm, iE_cm;
+  m_Origin.to_cm(iLat, iLon, iN_cm, iE_cm);
+  // Vector to the target
+  float fN_cm = static_cast<float>(item.north_cm - iN_cm);
+  float fE_cm = static_cast<float>(item.east_cm  - iE_cm);
+
+  iAlong_cm = static_cast<int32_t>( (fN_cm * item.unitN_q14 + fE_cm * item.unitE_q14) / Q14);
+  iCross_cm = static_cast<int32_t>( (fN_cm * item.unitE_q14 - fE_cm * item.unitN_q14) / Q14);
+}
+
+const MissionItem *Mission::get_target() const {
+  return m_iCount > 0 ? &m_rgItems[m_iCurrent] : NULL;
+}
+
+uint_fast8_t Mission::get_current() const {
+  return m_iCurrent;
+}
+
+uint_fast8_t Mission::get_count() const {
+  return m_iCount;
+}
@@ -0,0 +1,101 @@
+#ifndef MISSION_h
+#define MISSION_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+
+
+///////////////////////////////////////////////////////////
+// Local tangent plane at the navigation origin:
+// The scale factors are computed once, afterwards a position is
+// the int32 delta to the origin in cm (north, east).
+// The flat earth error is below 0.1 % of the distance to the origin
+// for missions within a few km (not valid across the antimeridian).
+///////////////////////////////////////////////////////////
+class NavOrigin {
+private:
+  int32_t m_iLat;                     // in degrees * 10,000,000
+  int32_t m_iLon;
+  float   m_fScaleN;                  // cm per 1e-7 degree latitude
+  float   m_fScaleE;                  // cm per 1e-7 degree longitude at the latitude of the origin
+  bool    m_bSet;
+
+public:
+  NavOrigin();
+
+  void set(const int32_t iLat, const int32_t iLon);
+  bool is_set() const;
+  // The integer delta is exact, so no precision is lost by large coordinates
+  void to_cm(const int32_t iLat, const int32_t iLon, int32_t &iN_cm, int32_t &iE_cm) const;
+};
+
+///////////////////////////////////////////////////////////
+// One way point with the geometry of the leg
+// from the previous way point (precomputed on upload)
+///////////////////////////////////////////////////////////
+struct MissionItem {
+  int32_t  latitude;                  // in degrees * 10,000,000
+  int32_t  longitude;                 // in degrees * 10,000,000
+  int32_t  altitude_cm;
+
+  int32_t  north_cm;                  // Position relative to the navigation origin
+  int32_t  east_cm;
+  int32_t  dist_cm;                   // Length of the leg
+  int16_t  unitN_q14;                 // Unit vector of the leg (north, east) in Q14
+  int16_t  unitE_q14;
+  uint16_t bearing_cd;                // Course of the leg (0 - 35999 centi degrees)
+};
+
+///////////////////////////////////////////////////////////
+// Bounded table of way points
+// The mission is advanced on arrival and can be replaced incrementally,
+// so no trigonometric function is needed during the flight
+///////////////////////////////////////////////////////////
+class Mission {
+private:
+  MissionItem  m_rgItems[MISSION_MAX_WP];
+  uint_fast8_t m_iCount;              // Nr. of valid items
+  uint_fast8_t m_iCurrent;            // Index of the target
+  NavOrigin    m_Origin;
+  int32_t      m_iStartLat;           // Start of the first leg (position on activation)
+  int32_t      m_iStartLon;
+
+  void project(const uint_fast8_t iItem);   // Position of the item relative to the origin
+  void calc_leg(const uint_fast8_t iItem);
+
+public:
+  Mission();
+
+  /*
+   * Upload: Replaces the item iItem and sets the length of the mission to iCount.
+   * Items can be appended or replaced, but without gaps.
+   * Returns false if the index is invalid.
+   */
+  bool set_item(const uint_fast8_t iItem, const uint_fast8_t iCount, const int32_t iLat, const int32_t iLon, const int32_t iAlt_cm);
+  void clear();
+
+  /*
+   * Sets the origin of the local tangent plane (e.g. at arming) and projects all items again.
+   * Until then the first uploaded item is the origin.
+   */
+  void set_origin(const int32_t iLat, const int32_t iLon);
+  const NavOrigin &get_origin() const;
+
+  void start(const int32_t iLat, const int32_t iLon); // First leg from the current position
+  bool advance();                                     // Returns false if the last way point is reached
+
+  /*
+   * Position relative to the current leg:
+   * iAlong_cm: Remaining distance along the leg (negative if the target was passed)
+   * iCross_cm: Distance to the right of the leg
+   */
+  void track(const int32_t iLat, const int32_t iLon, int32_t &iAlong_cm, int32_t &iCross_cm) const;
+
+  const MissionItem *get_target() const;              // NULL if the mission is empty
+  uint_fast8_t get_current() const;
+  uint_fast8_t get_count() const;
+};
+
+#endif /*MISSION_h*/
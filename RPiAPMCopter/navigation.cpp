@@ -7,106 +7,183 @@
 #include "receiver.h"
 #include "exceptions.h"
 #include "arithmetics.h"
-#include "filter.h"
 
-#define M_2PI               (2.f * M_PI)
-#define M_PERIMETER_EARTH_M (40074000.f)
-#define M_RADIUS_EARTH_M    (M_PERIMETER_EARTH_M / M_2PI)
-#define M_AP_INT2FLOAT_DEG  (10000000.f)
 
+#define GRAVITY_CMSS        980.665f
+#define Q14                 16384.f
 
-/*
- * Sigmoid transfer function
- */
-inline float uav_yaw_f(float x, float mod){
-  float val = sign_f(x) * smaller_f(fabs(mod * x), 180.f) / 180.f;
-  return val / sqrt(1 + pow2_f(val) );
-}
-
-inline float uav_zero_f(float x, float mod){
-  float val = (180.0 - smaller_f(fabs(mod * x), 179.9f)) / 180.f;
-  return val / sqrt(1 + pow2_f(val) );
-}
 
-UAVNav::UAVNav(Device *pDev, Receiver *pRecv, Exception *pExcp) {
+UAVNav::UAVNav(Device *pDev, Receiver *pRecv, Exception *pExcp) :
+  m_YawCurve(MAX_YAW, YAW_ACC_MAX, YAW_JERK_MAX, true),
+  m_AlongCurve(NAV_VEL_MAX_CMS, NAV_ACC_MAX_CMSS, NAV_JERK_MAX_CMSSS)
+{
   m_pHalBoard      = pDev;
   m_pReceiver      = pRecv;
   m_pExeption      = pExcp;
 
-  m_t32YawTimer    = m_pHalBoard->m_pHAL->scheduler->millis();
+  m_t32YawTimer    = m_pHalBoard->m_pHAL->scheduler->micros();
+  m_t32PosTimer    = m_t32YawTimer;
+  m_bPosCtrl       = false;
+  m_iLeg           = 0;
 
   m_fTargetYaw_deg = 0.f;
   m_fTargetPit_deg = 0.f;
-}
-
-/*
- * Geographic calculations
- */
-float UAVNav::width_of_merid_m(const float fLat_deg) const {
-  return (M_2PI * M_RADIUS_EARTH_M * cos(ToRad(fLat_deg) ) ) / 360.f;
-}
-
-float UAVNav::dist_2_equat_m(const float fLat_deg) const {
-  return (M_PERIMETER_EARTH_M / 360.f) * fLat_deg;
-}
-
-float UAVNav::dist_2_greenw_m(const float fLat_deg, const float fLon_deg) const {
-  return width_of_merid_m(fLat_deg) * fLon_deg;
+  m_fTargetRol_deg = 0.f;
+  m_fError_deg     = 0.f;
+  m_iAlong_cm      = 0;
+  m_iCross_cm      = 0;
 }
 
 float UAVNav::calc_error_deg() {
-  float fLatHome_deg = static_cast<float>(m_pHalBoard->m_pInertNav->get_latitude() ) / M_AP_INT2FLOAT_DEG;
-  float fLonHome_deg = static_cast<float>(m_pHalBoard->m_pInertNav->get_longitude() ) / M_AP_INT2FLOAT_DEG;
-
-  float fLatTarg_deg = static_cast<float>(m_pReceiver->get_waypoint()->latitude) / M_AP_INT2FLOAT_DEG;
-  float fLonTarg_deg = static_cast<float>(m_pReceiver->get_waypoint()->longitude) / M_AP_INT2FLOAT_DEG;
-
-  float fXHome = dist_2_greenw_m(fLatHome_deg, fLonHome_deg);
-  float fYHome = dist_2_equat_m(fLatHome_deg);
-
-  float fXTarg = dist_2_greenw_m(fLatTarg_deg, fLonTarg_deg);
-  float fYTarg = dist_2_equat_m(fLatTarg_deg);
+  const Mission *pMission = m_pReceiver->get_mission();
+  int32_t iLat = m_pHalBoard->m_pInertNav->get_latitude();
+  int32_t iLon = m_pHalBoard->m_pInertNav->get_longitude();
+
+  pMission->track(iLat, iLon, m_iAlong_cm, m_iCross_cm);
+  // Way point reached (or passed): Continue with the next leg
+  if(m_iAlong_cm < MISSION_ARRIVE_CM && m_pReceiver->advance_mission() ) {
+    pMission->track(iLat, iLon, m_iAlong_cm, m_iCross_cm);
+  }
 
-  return delta180_f(atan2(fXTarg - fXHome, fYTarg - fYHome) , m_pHalBoard->get_comp_deg() );
+  const MissionItem *pTarget = pMission->get_target();
+  if(pTarget == NULL) {
+    return 0.f;
+  }
+  // Steer back to the leg: Right of the leg means turning left
+  float fCorr_deg   = constrain_float(-m_iCross_cm / 100.f * MISSION_XTRACK_DEG_M, -MISSION_XTRACK_MAX, MISSION_XTRACK_MAX);
+  float fCourse_deg = pTarget->bearing_cd / 100.f + fCorr_deg;
+  return delta180_f(fCourse_deg, m_pHalBoard->get_frame().heading_deg);
 }
 
 int_fast16_t UAVNav::calc_yaw() {
   // Calculate the time since last call
-  uint_fast32_t t32CurTimer = m_pHalBoard->m_pHAL->scheduler->millis();
-  float dT = static_cast<float>((t32CurTimer - m_t32YawTimer) ) / 1000.f;
+  uint32_t t32CurTimer = m_pHalBoard->m_pHAL->scheduler->micros();
+  float dT = dt_s(t32CurTimer, m_t32YawTimer);
   m_t32YawTimer = t32CurTimer;
 
   // Update position data and calculate the errors
-  float fError_deg = calc_error_deg();
-  // Change the yaw of the copter if error to target is high
-  float fCtrl = YAW_ERROR_RATE * dT * YAW_CTRL_MOD;
-  float fZero = YAW_ERROR_RATE * dT * sign_f(-m_fTargetYaw_deg) * YAW_ZERO_MOD;
-  m_fTargetYaw_deg = SFilter::transff_filt_f( m_fTargetYaw_deg, 
-                                              uav_yaw_f(fError_deg, YAW_CTRL_SLOPE),  fCtrl, 
-                                              uav_zero_f(fError_deg, YAW_ZERO_SLOPE), fZero);
+  float fError_deg   = m_fError_deg = calc_error_deg();
+  float fHeading_deg = m_pHalBoard->get_frame().heading_deg;
+  // Start from the current heading after a pause of the navigation
+  if(dT > PID_MAX_DT_S) {
+    m_YawCurve.reset(fHeading_deg);
+  }
+  // The heading set point turns towards the course with limited rate, acceleration and jerk
+  m_YawCurve.update(fHeading_deg + fError_deg, dT);
 
-  // Cap the maximum yaw change
-  m_fTargetYaw_deg  = fabs(m_fTargetYaw_deg) > MAX_YAW ? sign_f(m_fTargetYaw_deg) * MAX_YAW : m_fTargetYaw_deg;
+  // Yaw rate: Feed forward of the set point plus the correction of the remaining difference
+  float fCorr_deg  = wrap180_f(m_YawCurve.get_pos() - fHeading_deg);
+  m_fTargetYaw_deg = constrain_float(m_YawCurve.get_vel() + m_pHalBoard->get_pid(PID_YAW_STAB).kP() * fCorr_deg, -MAX_YAW, MAX_YAW);
 
   #if DEBUG_OUT
-  m_pHalBoard->m_pHAL->console->printf("Navigation - Comp: %.3f, Err: %.3f, CTRL: %.3f, ZERO: %.3f, Yaw: %d\n", 
-                                       m_pHalBoard->get_comp_deg(), 
+  m_pHalBoard->m_pHAL->console->printf_P(PSTR("Navigation - Comp: %.3f, Err: %.3f, Setp: %.3f, Rate: %.3f, Yaw: %d\n"), 
+                                       fHeading_deg, 
                                        fError_deg, 
-                                       fCtrl, 
-                                       fZero, 
+                                       m_YawCurve.get_pos(), 
+                                       m_YawCurve.get_vel(), 
                                        static_cast<int_fast16_t>(m_fTargetYaw_deg) );
   #endif
 
-  if(fError_deg > 1.f) {
-    // Set pitch zero if orientation wrong
-    m_pReceiver->set_channel(RC_PIT, 0);
-  }
-  // Anneal to correct yaw
   return static_cast<int_fast16_t>(m_fTargetYaw_deg);
 }
 
+void UAVNav::update_pos_ctrl() {
+  uint32_t t32CurTimer = m_pHalBoard->get_frame().timestamp_us;
+  uint32_t t32DT_us    = dt_us(t32CurTimer, m_t32PosTimer);
+  if(t32DT_us < INAV_T_MS * 1000UL) {
+    return;
+  }
+  m_t32PosTimer = t32CurTimer;
+  float fDT_s   = t32DT_us / 1000000.f;
+
+  // Follow the current gains; A pause of the navigation resets the integrators (PID_MAX_DT_S)
+  const PIDCtrl &pid = m_pHalBoard->get_pid(PID_NAV_RATE);
+  for(uint_fast8_t i = 0; i < 2; i++) {
+    m_rgVelPID[i].kP(pid.kP() );
+    m_rgVelPID[i].kI(pid.kI() );
+    m_rgVelPID[i].kD(pid.kD() );
+    m_rgVelPID[i].filt_hz(pid.filt_hz() );
+    m_rgVelPID[i].imax(pid.imax() );
+  }
+
+  const Mission *pMission    = m_pReceiver->get_mission();
+  const MissionItem *pTarget = pMission->get_target();
+  AP_InertialNav *pInertNav  = m_pHalBoard->m_pInertNav;
+  // Level and without integrators on the ground or without a position
+  if( pTarget == NULL || !pInertNav->position_ok() ||
+      m_pReceiver->get_channel(RC_THR) <= RC_THR_ACRO )
+  {
+    m_fTargetPit_deg = 0.f;
+    m_fTargetRol_deg = 0.f;
+    m_rgVelPID[0].reset_I();
+    m_rgVelPID[1].reset_I();
+    m_bPosCtrl       = false;
+    return;
+  }
+
+  const float fKP       = m_pHalBoard->get_pid(PID_NAV_STAB).kP();
+  const float fAlong_cm = static_cast<float>(m_iAlong_cm);
+  const float fUnitN    = pTarget->unitN_q14 / Q14;
+  const float fUnitE    = pTarget->unitE_q14 / Q14;
+  const Vector3f &vVel_cms = pInertNav->get_velocity();
+
+  // The along track set point starts at the current state on engagement and on a new leg
+  if(!m_bPosCtrl || pMission->get_current() != m_iLeg) {
+    float fSpeed_cms = vVel_cms.x * fUnitN + vVel_cms.y * fUnitE;
+    m_AlongCurve.reset(fAlong_cm, -fSpeed_cms);
+    m_iLeg     = pMission->get_current();
+    m_bPosCtrl = true;
+  }
+  // Brake towards the last way point, otherwise aim behind the way point to fly through with full speed
+  float fTarget_cm = 0.f;
+  if(pMission->get_current() + 1 < pMission->get_count() ) {
+    fTarget_cm = -NAV_VEL_MAX_CMS * NAV_VEL_MAX_CMS / NAV_ACC_MAX_CMSS;
+  }
+  // Turn first if the orientation is wrong: Stop smoothly
+  if(fabs(m_fError_deg) > MISSION_MAX_ERR_DEG) {
+    fTarget_cm = m_AlongCurve.get_pos();
+  }
+  m_AlongCurve.update(fTarget_cm, fDT_s);
+
+  // Position -> velocity (leg frame)
+  // Along: The remaining distance shrinks, so the speed is the negative rate of the set point
+  float fAlong_cms = constrain_float(-m_AlongCurve.get_vel() + fKP * (fAlong_cm - m_AlongCurve.get_pos() ), -NAV_VEL_MAX_CMS, NAV_VEL_MAX_CMS);
+  // Right of the leg means a velocity to the left
+  float fCross_cms = constrain_float(-fKP * m_iCross_cm, -NAV_VEL_MAX_CMS, NAV_VEL_MAX_CMS);
+
+  // Leg frame -> north/east: The right hand normal of the leg is (-E, N)
+  float fVelN_cms = fAlong_cms * fUnitN - fCross_cms * fUnitE;
+  float fVelE_cms = fAlong_cms * fUnitE + fCross_cms * fUnitN;
+
+  // Velocity -> acceleration
+  // The integrators only shrink while the tilt is at its limit
+  bool bSaturated = fabs(m_fTargetPit_deg) >= MAX_PIT || fabs(m_fTargetRol_deg) >= MAX_PIT;
+  float fAccN_cmss = m_rgVelPID[0].get_pid(fVelN_cms - vVel_cms.x, fDT_s, 0.f, bSaturated);
+  float fAccE_cmss = m_rgVelPID[1].get_pid(fVelE_cms - vVel_cms.y, fDT_s, 0.f, bSaturated);
+
+  // Acceleration -> tilt of the frame (forward and to the right)
+  // A positive pitch is nose up, so the frame pitches down to accelerate forward
+  float fYaw_rad    = ToRad(m_pHalBoard->get_frame().heading_deg);
+  float fCos        = cos(fYaw_rad);
+  float fSin        = sin(fYaw_rad);
+  float fFwd_cmss   =  fAccN_cmss * fCos + fAccE_cmss * fSin;
+  float fRight_cmss = -fAccN_cmss * fSin + fAccE_cmss * fCos;
+  m_fTargetPit_deg  = constrain_float(-ToDeg(atan(fFwd_cmss  / GRAVITY_CMSS) ), -MAX_PIT, MAX_PIT);
+  m_fTargetRol_deg  = constrain_float(ToDeg(atan(fRight_cmss / GRAVITY_CMSS) ), -MAX_PIT, MAX_PIT);
+
+  #if DEBUG_OUT
+  m_pHalBoard->m_pHAL->console->printf_P(PSTR("Navigation - Vel set: %.1f, %.1f, Vel: %.1f, %.1f, Pit: %.1f, Rol: %.1f\n"),
+                                       fVelN_cms, fVelE_cms,
+                                       vVel_cms.x, vVel_cms.y,
+                                       m_fTargetPit_deg, m_fTargetRol_deg);
+  #endif
+}
+
 int_fast16_t UAVNav::calc_pitch() {
-  // TODO Implement me
+  update_pos_ctrl();
+  return static_cast<int_fast16_t>(m_fTargetPit_deg);
+}
 
-  return m_fTargetPit_deg;
+int_fast16_t UAVNav::calc_roll() {
+  return static_cast<int_fast16_t>(m_fTargetRol_deg);
 }
@@ -2,6 +2,7 @@
 #include <stddef.h>
 
 #include "config.h"
+#include "controller.h"
 
 class Device;
 class Receiver;
@@ -10,10 +11,23 @@ class Exception;
 
 class UAVNav {
 private:
-  uint_fast32_t m_t32YawTimer;
+  uint32_t m_t32YawTimer;         // in us
+  uint32_t m_t32PosTimer;         // in us; Time of the last position controller update
+  bool     m_bPosCtrl;            // Position controller engaged
+  uint_fast8_t m_iLeg;            // Leg of the along track set point
 
   float  m_fTargetYaw_deg;
   float  m_fTargetPit_deg;
+  float  m_fTargetRol_deg;
+  float  m_fError_deg;            // Heading error of the last calc_yaw() call
+  int32_t m_iAlong_cm;            // Remaining distance along the current leg
+  int32_t m_iCross_cm;            // Distance to the right of the current leg
+
+  // Velocity controllers (north, east) with the gains of PID_NAV_RATE
+  PIDCtrl m_rgVelPID[2];
+  // Set points: Heading (deg) and remaining distance along the leg (cm)
+  SCurve  m_YawCurve;
+  SCurve  m_AlongCurve;
 
   Device*       m_pHalBoard;
   Receiver*     m_pReceiver;
@@ -21,13 +35,20 @@ private:
 
   /*
    * Calculate the change in degrees
-   * necessary to head with the front of the frame to the target way point
+   * necessary to head with the front of the frame along the current leg of the mission.
+   * Uses the precomputed leg geometry: The course is the bearing of the leg
+   * corrected by the distance to the leg. Advances the mission on arrival.
    */
   float calc_error_deg();
 
-  float width_of_merid_m(const float fLat_deg) const;
-  float dist_2_equat_m  (const float fLat_deg) const;
-  float dist_2_greenw_m (const float fLat_deg, const float fLon_deg) const;
+  /*
+   * Cascaded horizontal position controller running at INAV_T_MS:
+   * Position error along (to the S-curve set point) and across the leg (cm, local frame) -> velocity set point (cm/s),
+   * velocity error of the inertial navigation -> acceleration (cm/s^2),
+   * acceleration rotated into the frame -> pitch and roll set point (degrees).
+   * Between the updates the last set points are kept.
+   */
+  void update_pos_ctrl();
 
 public:
   UAVNav(Device *, Receiver *, Exception *);
@@ -35,5 +56,7 @@ public:
   // This function is overriding the remote control
   // and implementing the way the copter has to move to the defined target way-point
   int_fast16_t calc_yaw();
+  // Updates the position controller, so call before calc_roll()
   int_fast16_t calc_pitch();
+  int_fast16_t calc_roll();
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "global.h"
 #include "containers.h"
 #include "scheduler.h"
+#include "arithmetics.h"
 
 
 void send_comp();
@@ -14,6 +15,12 @@ void send_bat();
 void send_rc();
 void send_pids_attitude();
 void send_pids_altitude();
+void send_health();
+void send_fence();
+void send_loop();
+#if USE_MAVLINK
+void send_mavlink();
+#endif
 
 // function, delay, multiplier of the delay
 Task outAtti   (&send_atti,          3,   1);
@@ -24,6 +31,19 @@ Task outGPS    (&send_gps,           66,  2);
 Task outBat    (&send_bat,           75,  1);
 Task outPIDAtt (&send_pids_attitude, 133, 1);
 Task outPIDAlt (&send_pids_altitude, 133, 2);
+Task outLoop   (&send_loop,          LOOP_STATS_T_MS, 1);
+#if USE_MAVLINK
+Task outMAV    (&send_mavlink,       MAV_T_MS, 1);
+#endif
+
+// The JSON strings are only sent while the console is not in the MAVLink mode
+inline bool json_out() {
+#if USE_MAVLINK
+  return !_MAVCOM.is_active(MAVLINK_COMM_0);
+#else
+  return true;
+#endif
+}
 
 ///////////////////////////////////////////////////////////
 // LED OUT
@@ -46,32 +66,43 @@ void leds_on() {
 // compass
 ///////////////////////////////////////////////////////////
 void send_comp() {
-  if(!_HAL_BOARD.m_pComp->healthy() ) {
+  if(!json_out() ) {
+    return;
+  }
+  const SensorFrame &frame = _HAL_BOARD.get_frame();
+  if(!(frame.valid & SensorFrame::COMPASS_F) ) {
     return;
   }
 
-  hal.console->printf("{\"type\":\"s_cmp\",\"h\":%.1f}\n",
-  static_cast<double>(_HAL_BOARD.read_comp_deg() ) );
+  hal.console->printf_P(PSTR("{\"type\":\"s_cmp\",\"h\":%.1f}\n"),
+  static_cast<double>(frame.heading_deg) );
 }
 ///////////////////////////////////////////////////////////
 // attitude in degrees
 ///////////////////////////////////////////////////////////
 void send_atti() {
-  hal.console->printf("{\"type\":\"s_att\",\"r\":%.1f,\"p\":%.1f,\"y\":%.1f}\n",
-  static_cast<double>(_HAL_BOARD.get_atti_cor_deg().y), 
-  static_cast<double>(_HAL_BOARD.get_atti_cor_deg().x), 
-  static_cast<double>(_HAL_BOARD.get_atti_cor_deg().z) );
+  if(!json_out() ) {
+    return;
+  }
+  const Vector3f &vAtti = _HAL_BOARD.get_frame().atti_deg;
+  hal.console->printf_P(PSTR("{\"type\":\"s_att\",\"r\":%.1f,\"p\":%.1f,\"y\":%.1f}\n"),
+  static_cast<double>(vAtti.y), 
+  static_cast<double>(vAtti.x), 
+  static_cast<double>(vAtti.z) );
 }
 ///////////////////////////////////////////////////////////
 // barometer
 ///////////////////////////////////////////////////////////
 void send_baro() {
+  if(!json_out() ) {
+    return;
+  }
   if(!_HAL_BOARD.m_pBaro->healthy) {
     return;
   }
 
-  BaroData baro = _HAL_BOARD.read_baro();
-  hal.console->printf("{\"type\":\"s_bar\",\"p\":%.1f,\"a\":%ld,\"t\":%.1f,\"c\":%.1f,\"s\":%d}\n",
+  BaroData baro = _HAL_BOARD.get_baro();
+  hal.console->printf_P(PSTR("{\"type\":\"s_bar\",\"p\":%.1f,\"a\":%ld,\"t\":%.1f,\"c\":%.1f,\"s\":%d}\n"),
   static_cast<double>(baro.pressure_pa), 
   baro.altitude_cm, 
   static_cast<double>(baro.temperature_deg), 
@@ -82,13 +113,16 @@ void send_baro() {
 // gps
 ///////////////////////////////////////////////////////////
 void send_gps() {
+  if(!json_out() ) {
+    return;
+  }
   // Has fix?
   if(!_HAL_BOARD.m_pGPS->status() > 1) {
     return;
   }
 
   GPSData gps = _HAL_BOARD.get_gps();
-  hal.console->printf("{\"type\":\"s_gps\",\"lat_dege7\":%ld,\"lon_dege7\":%ld,\"a_cm\":%ld,\"g_cms\":%ld,\"g_cd\":%ld,\"sat\":%d,\"tw\":%d,\"tw_s\":%.2f}\n",
+  hal.console->printf_P(PSTR("{\"type\":\"s_gps\",\"lat_dege7\":%ld,\"lon_dege7\":%ld,\"a_cm\":%ld,\"g_cms\":%ld,\"g_cd\":%ld,\"sat\":%d,\"tw\":%d,\"tw_s\":%.2f}\n"),
                       gps.latitude,
                       gps.longitude,
                       gps.altitude_cm,
@@ -104,30 +138,83 @@ void send_gps() {
 // battery monitor
 ///////////////////////////////////////////////////////////
 void send_bat() {
-  BattData bat = _HAL_BOARD.read_bat();
-  hal.console->printf("{\"type\":\"s_bat\",\"R\":%.1f,\"V\":%.1f,\"A\":%.1f,\"P\":%.1f,\"c_mAh\":%.1f}\n",
+  if(!json_out() ) {
+    return;
+  }
+  BattData bat = _HAL_BOARD.get_bat();
+  hal.console->printf_P(PSTR("{\"type\":\"s_bat\",\"R\":%.1f,\"V\":%.1f,\"A\":%.1f,\"P\":%.1f,\"c_mAh\":%.1f,\"Vr\":%.2f,\"Ri\":%.3f,\"soc\":%.1f,\"t_s\":%.0f}\n"),
                       static_cast<double>(bat.refVoltage_V),
                       static_cast<double>(bat.voltage_V), 
                       static_cast<double>(bat.current_A),
                       static_cast<double>(bat.power_W), 
-                      static_cast<double>(bat.consumpt_mAh) );
+                      static_cast<double>(bat.consumpt_mAh),
+                      static_cast<double>(bat.rest_V),
+                      static_cast<double>(bat.resist_Ohm),
+                      static_cast<double>(bat.soc_pct),
+                      static_cast<double>(bat.remain_s) );
+}
+///////////////////////////////////////////////////////////
+// timing of the main loop and sensor health
+///////////////////////////////////////////////////////////
+void send_health() {
+  // Order of the rates: Device::HEALTH_SENSORS
+  const SensorHealth &inert = _HAL_BOARD.get_health(Device::HLT_INERTIAL);
+  const SensorHealth &baro  = _HAL_BOARD.get_health(Device::HLT_BAROMETER);
+  const SensorHealth &comp  = _HAL_BOARD.get_health(Device::HLT_COMPASS);
+  const SensorHealth &gps   = _HAL_BOARD.get_health(Device::HLT_GPS);
+  const SensorHealth &bat   = _HAL_BOARD.get_health(Device::HLT_BATTMON);
+  const SensorHealth &rf    = _HAL_BOARD.get_health(Device::HLT_RANGEFNDR);
+  hal.console->printf_P(PSTR("{\"type\":\"s_hlt\",\"map\":%u,\"hz\":[%u,%u,%u,%u,%u,%u],\"chg\":[%u,%u,%u,%u,%u,%u]}\n"),
+                      static_cast<unsigned int>(_HAL_BOARD.get_health() ),
+                      inert.update_hz, baro.update_hz, comp.update_hz, gps.update_hz, bat.update_hz, rf.update_hz,
+                      inert.change_hz, baro.change_hz, comp.change_hz, gps.change_hz, bat.change_hz, rf.change_hz);
+}
+
+// Echo of the fence upload: The ground control resends the missing vertices until the mask is complete
+void send_fence() {
+  const Geofence *pFence = _RECVR.get_fence();
+  hal.console->printf_P(PSTR("{\"type\":\"s_fnc\",\"cnt\":%u,\"rcv\":%u,\"on\":%u}\n"),
+                      static_cast<unsigned int>(pFence->get_count() ),
+                      static_cast<unsigned int>(pFence->get_received() ),
+                      static_cast<unsigned int>(pFence->is_enabled() ) );
+}
+
+void send_loop() {
+  if(!json_out() ) {
+    return;
+  }
+  LoopStats loop = _HAL_BOARD.get_loop_stats();
+  hal.console->printf_P(PSTR("{\"type\":\"s_lop\",\"min_us\":%lu,\"max_us\":%lu,\"avg_us\":%lu,\"n\":%u}\n"),
+                      static_cast<unsigned long>(loop.min_us),
+                      static_cast<unsigned long>(loop.max_us),
+                      static_cast<unsigned long>(loop.avg_us),
+                      static_cast<unsigned int>(loop.iterations) );
+  // Same interval, so no extra task is needed
+  send_health();
+  send_fence();
 }
 ///////////////////////////////////////////////////////////
 // remote control
 ///////////////////////////////////////////////////////////
 void send_rc() {
+  if(!json_out() ) {
+    return;
+  }
   int_fast16_t rcthr = _RECVR.get_channel(RC_THR);
   int_fast16_t rcyaw = _RECVR.get_channel(RC_YAW);
   int_fast16_t rcpit = _RECVR.get_channel(RC_PIT);
   int_fast16_t rcrol = _RECVR.get_channel(RC_ROL);
 
-  hal.console->printf("{\"type\":\"rc_in\",\"r\":%d,\"p\":%d,\"t\":%d,\"y\":%d}\n",
+  hal.console->printf_P(PSTR("{\"type\":\"rc_in\",\"r\":%d,\"p\":%d,\"t\":%d,\"y\":%d}\n"),
                       rcrol, rcpit, rcthr, rcyaw);
 }
 ///////////////////////////////////////////////////////////
 // PID configuration
 ///////////////////////////////////////////////////////////
 void send_pids_attitude() {
+  if(!json_out() ) {
+    return;
+  }
   // Capture values
   float pit_rkp   = _HAL_BOARD.get_pid(PID_PIT_RATE).kP();
   float pit_rki   = _HAL_BOARD.get_pid(PID_PIT_RATE).kI();
@@ -148,11 +235,11 @@ void send_pids_attitude() {
   float rol_skp   = _HAL_BOARD.get_pid(PID_ROL_STAB).kP();
   float yaw_skp   = _HAL_BOARD.get_pid(PID_YAW_STAB).kP();
 
-  hal.console->printf("{\"type\":\"pid_cnf\","
+  hal.console->printf_P(PSTR("{\"type\":\"pid_cnf\","
                       "\"p_rkp\":%.2f,\"p_rki\":%.2f,\"p_rkd\":%.4f,\"p_rimax\":%.2f,"
                       "\"r_rkp\":%.2f,\"r_rki\":%.2f,\"r_rkd\":%.4f,\"r_rimax\":%.2f,"
                       "\"y_rkp\":%.2f,\"y_rki\":%.2f,\"y_rkd\":%.4f,\"y_rimax\":%.2f,"
-                      "\"p_skp\":%.2f,\"r_skp\":%.2f,\"y_skp\":%.4f}\n",
+                      "\"p_skp\":%.2f,\"r_skp\":%.2f,\"y_skp\":%.4f}\n"),
                       static_cast<double>(pit_rkp), static_cast<double>(pit_rki), static_cast<double>(pit_rkd), static_cast<double>(pit_rimax),
                       static_cast<double>(rol_rkp), static_cast<double>(rol_rki), static_cast<double>(rol_rkd), static_cast<double>(rol_rimax),
                       static_cast<double>(yaw_rkp), static_cast<double>(yaw_rki), static_cast<double>(yaw_rkd), static_cast<double>(yaw_rimax),
@@ -160,6 +247,9 @@ void send_pids_attitude() {
 }
 
 void send_pids_altitude() {
+  if(!json_out() ) {
+    return;
+  }
   // Capture values
   float thr_rkp   = _HAL_BOARD.get_pid(PID_THR_RATE).kP();
   float thr_rki   = _HAL_BOARD.get_pid(PID_THR_RATE).kI();
@@ -171,17 +261,141 @@ void send_pids_altitude() {
   float acc_rkd   = _HAL_BOARD.get_pid(PID_ACC_RATE).kD();
   float acc_rimax = _HAL_BOARD.get_pid(PID_ACC_RATE).imax();
 
+  float nav_rkp   = _HAL_BOARD.get_pid(PID_NAV_RATE).kP();
+  float nav_rki   = _HAL_BOARD.get_pid(PID_NAV_RATE).kI();
+  float nav_rkd   = _HAL_BOARD.get_pid(PID_NAV_RATE).kD();
+  float nav_rimax = _HAL_BOARD.get_pid(PID_NAV_RATE).imax();
+
   float thr_skp   = _HAL_BOARD.get_pid(PID_THR_STAB).kP();
   float acc_skp   = _HAL_BOARD.get_pid(PID_ACC_STAB).kP();
+  float nav_skp   = _HAL_BOARD.get_pid(PID_NAV_STAB).kP();
 
-  hal.console->printf("{\"type\":\"pid_cnf\","
+  hal.console->printf_P(PSTR("{\"type\":\"pid_cnf\","
                       "\"t_rkp\":%.2f,\"t_rki\":%.2f,\"t_rkd\":%.4f,\"t_rimax\":%.2f,"
                       "\"a_rkp\":%.2f,\"a_rki\":%.2f,\"a_rkd\":%.4f,\"a_rimax\":%.2f,"
-                      "\"t_skp\":%.2f,\"a_skp\":%.2f}\n",
+                      "\"n_rkp\":%.2f,\"n_rki\":%.2f,\"n_rkd\":%.4f,\"n_rimax\":%.2f,"
+                      "\"t_skp\":%.2f,\"a_skp\":%.2f,\"n_skp\":%.2f}\n"),
                       static_cast<double>(thr_rkp), static_cast<double>(thr_rki), static_cast<double>(thr_rkd), static_cast<double>(thr_rimax),
                       static_cast<double>(acc_rkp), static_cast<double>(acc_rki), static_cast<double>(acc_rkd), static_cast<double>(acc_rimax),
-                      static_cast<double>(thr_skp), static_cast<double>(acc_skp) );
+                      static_cast<double>(nav_rkp), static_cast<double>(nav_rki), static_cast<double>(nav_rkd), static_cast<double>(nav_rimax),
+                      static_cast<double>(thr_skp), static_cast<double>(acc_skp), static_cast<double>(nav_skp) );
 }
 
+///////////////////////////////////////////////////////////
+// MAVLink streams
+///////////////////////////////////////////////////////////
+#if USE_MAVLINK
+void send_mav_heartbeat(const mavlink_channel_t chan) {
+  bool bArmed   = _RECVR.get_channel(RC_THR) > RC_THR_OFF;
+  uint8_t iMode = MAV_MODE_FLAG_MANUAL_INPUT_ENABLED | MAV_MODE_FLAG_STABILIZE_ENABLED;
+  if(bArmed) {
+    iMode |= MAV_MODE_FLAG_SAFETY_ARMED;
+  }
+  if(chk_fset(_RECVR.get_waypoint()->mode, GPSPosition::GPS_NAVIGATN_F) ) {
+    iMode |= MAV_MODE_FLAG_GUIDED_ENABLED | MAV_MODE_FLAG_AUTO_ENABLED;
+  }
+
+  uint8_t iState = bArmed ? MAV_STATE_ACTIVE : MAV_STATE_STANDBY;
+  if(_BOOT.get_state() != BootSeq::READY_S) {
+    iState = MAV_STATE_BOOT;
+  } else {
+    switch(_EXCP.get_state() ) {
+      case Exception::FS_FENCE_S:
+      case Exception::FS_RCVR_DOWN_S:
+        iState = MAV_STATE_CRITICAL;
+        break;
+      case Exception::FS_DEVICE_DOWN_S:
+        iState = MAV_STATE_EMERGENCY;
+        break;
+      default:
+        break;
+    }
+  }
+  mavlink_msg_heartbeat_send(chan, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_GENERIC, iMode, 0, iState);
+}
+
+void send_mav_status(const mavlink_channel_t chan) {
+  const uint32_t iSensors = MAV_SYS_STATUS_SENSOR_3D_GYRO | MAV_SYS_STATUS_SENSOR_3D_ACCEL | MAV_SYS_STATUS_SENSOR_3D_MAG |
+                            MAV_SYS_STATUS_SENSOR_ABSOLUTE_PRESSURE | MAV_SYS_STATUS_SENSOR_GPS;
+  uint_fast8_t iHealth = _HAL_BOARD.get_health();
+  uint32_t iHealthy = 0;
+  if(iHealth & (1 << Device::HLT_INERTIAL) ) {
+    iHealthy |= MAV_SYS_STATUS_SENSOR_3D_GYRO | MAV_SYS_STATUS_SENSOR_3D_ACCEL;
+  }
+  if(iHealth & (1 << Device::HLT_COMPASS) ) {
+    iHealthy |= MAV_SYS_STATUS_SENSOR_3D_MAG;
+  }
+  if(iHealth & (1 << Device::HLT_BAROMETER) ) {
+    iHealthy |= MAV_SYS_STATUS_SENSOR_ABSOLUTE_PRESSURE;
+  }
+  if(iHealth & (1 << Device::HLT_GPS) ) {
+    iHealthy |= MAV_SYS_STATUS_SENSOR_GPS;
+  }
+
+  // Lost and corrected frames of the radio as communication errors
+  BattData bat = _HAL_BOARD.get_bat();
+  mavlink_msg_sys_status_send(chan, iSensors, iSensors, iHealthy, 0,
+                              static_cast<uint16_t>(bat.voltage_V * 1000.f),
+                              static_cast<int16_t>(bat.current_A * 100.f),
+                              static_cast<int8_t>(constrain_float(bat.soc_pct, 0.f, 100.f) ),
+                              0, _RECVR.get_radio_lost(), _RECVR.get_radio_fixed(), 0, 0, 0);
+}
+
+void send_mav_gps(const mavlink_channel_t chan) {
+  GPSData gps = _HAL_BOARD.get_gps();
+  mavlink_msg_gps_raw_int_send(chan,
+                               static_cast<uint64_t>(gps.timestamp_ms) * 1000ULL,
+                               static_cast<uint8_t>(_HAL_BOARD.m_pGPS->status() ),
+                               gps.latitude,
+                               gps.longitude,
+                               gps.altitude_cm * 10,
+                               UINT16_MAX, UINT16_MAX,          // Dilution of precision unknown
+                               static_cast<uint16_t>(gps.gspeed_cms),
+                               static_cast<uint16_t>( (gps.gcourse_cd % 36000 + 36000) % 36000),
+                               gps.satelites);
+}
+
+void send_mav_atti(const mavlink_channel_t chan) {
+  // x = pitch, y = roll, z = yaw
+  const SensorFrame &frame = _HAL_BOARD.get_frame();
+  mavlink_msg_attitude_send(chan, hal.scheduler->millis(),
+                            ToRad(frame.atti_deg.y), ToRad(frame.atti_deg.x), ToRad(frame.atti_deg.z),
+                            ToRad(frame.gyro_deg.y), ToRad(frame.gyro_deg.x), ToRad(frame.gyro_deg.z) );
+}
+
+void send_mav_rc(const mavlink_channel_t chan) {
+  mavlink_msg_rc_channels_raw_send(chan, hal.scheduler->millis(), 0,
+                                   mav_deg_to_pwm(_RECVR.get_channel(RC_ROL), RC_ROL_MAX),
+                                   mav_deg_to_pwm(_RECVR.get_channel(RC_PIT), RC_PIT_MAX),
+                                   static_cast<uint16_t>(_RECVR.get_channel(RC_THR) ),
+                                   mav_deg_to_pwm(_RECVR.get_channel(RC_YAW), RC_YAW_MAX),
+                                   0, 0, 0, 0, 255);
+}
+
+void send_mavlink() {
+  for(uint_fast8_t i = 0; i < MAV_CHAN_CNT; i++) {
+    const mavlink_channel_t chan = static_cast<mavlink_channel_t>(i);
+    if(!_MAVCOM.is_active(chan) ) {
+      continue;
+    }
+
+    if(_MAVCOM.stream_due(chan, MAVCom::STR_HEARTBEAT, MAVLINK_MSG_ID_HEARTBEAT_LEN) ) {
+      send_mav_heartbeat(chan);
+    }
+    if(_MAVCOM.stream_due(chan, MAVCom::STR_STATUS, MAVLINK_MSG_ID_SYS_STATUS_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES + MAVLINK_MSG_ID_GPS_RAW_INT_LEN) ) {
+      send_mav_status(chan);
+      send_mav_gps(chan);
+    }
+    if(_MAVCOM.stream_due(chan, MAVCom::STR_RC, MAVLINK_MSG_ID_RC_CHANNELS_RAW_LEN) ) {
+      send_mav_rc(chan);
+    }
+    if(_MAVCOM.stream_due(chan, MAVCom::STR_ATTI, MAVLINK_MSG_ID_ATTITUDE_LEN) ) {
+      send_mav_atti(chan);
+    }
+    _MAVCOM.send_params(chan);
+  }
+}
+#endif
+
 #endif
 
@@ -0,0 +1,166 @@
+#include <AP_Compass.h>
+#include <AP_InertialSensor.h>
+
+#include "parameters.h"
+#include "device.h"
+#include "receiver.h"
+#include "BattMonitor.h"
+#include "arithmetics.h"
+
+
+///////////////////////////////////////////////////////////
+// Parameters
+///////////////////////////////////////////////////////////
+Parameters::Parameters(Device *pDev, Receiver *pRecv) {
+  m_pHalBoard  = pDev;
+  m_pReceiver  = pRecv;
+
+  memset(&m_Block, 0, sizeof(m_Block) );
+  m_iWriteOffs = sizeof(m_Block);
+  m_t32Check   = m_pHalBoard->m_pHAL->scheduler->millis();
+}
+
+bool Parameters::load() {
+  m_pHalBoard->m_pHAL->storage->read_block(&m_Block, PARAM_EEPROM_OFFS, sizeof(m_Block) );
+
+  const ParamHeader &header = m_Block.header;
+  bool bResetID = header.version == PARAM_VERSION_PID_ID;
+  if( header.magic   != PARAM_MAGIC   ||
+      (header.version != PARAM_VERSION && !bResetID) ||
+      header.size    != sizeof(ParamData) ||
+      header.crc     != crc16_ccitt(reinterpret_cast<const uint8_t *>(&m_Block.data), sizeof(ParamData) ) )
+  {
+    // Keep the defaults and replace the invalid block
+    memset(&m_Block.header, 0, sizeof(m_Block.header) );
+    capture();
+    return false;
+  }
+
+  apply();
+  // The ArduPilot PID copies never applied the I and D terms, but the blocks before PIDCtrl saved them:
+  // Keep the P-only tuning and write the block back with the new version
+  if(bResetID) {
+    for(uint_fast8_t i = 0; i < PID_NAV_RATE; i++) {
+      m_pHalBoard->get_pid(i).kI(0.f);
+      m_pHalBoard->get_pid(i).kD(0.f);
+    }
+    capture();
+  }
+  return true;
+}
+
+void Parameters::apply() {
+  const ParamData &data = m_Block.data;
+
+  for(uint_fast8_t i = 0; i < NR_OF_PIDS; i++) {
+    PIDCtrl &pid = m_pHalBoard->get_pid(i);
+    pid.kP(data.pids[i].kP);
+    pid.kI(data.pids[i].kI);
+    pid.kD(data.pids[i].kD);
+    pid.kFF(data.pids[i].kFF);
+    pid.filt_hz(data.pids[i].filt_hz);
+    pid.imax(data.pids[i].imax);
+  }
+
+  m_pHalBoard->set_trims(data.trim_rol_deg, data.trim_pit_deg);
+  m_pHalBoard->m_pBat->set_type(data.batt_type);
+  m_pHalBoard->m_pBat->set_cells_cfg(data.batt_cells);
+
+  m_pHalBoard->m_pComp->set_offsets(Vector3f(data.comp_offs[0], data.comp_offs[1], data.comp_offs[2]) );
+  m_pHalBoard->m_pInert->set_accel_offsets(Vector3f(data.accel_offs[0], data.accel_offs[1], data.accel_offs[2]) );
+  m_pHalBoard->m_pInert->set_accel_scale(Vector3f(data.accel_scale[0], data.accel_scale[1], data.accel_scale[2]) );
+
+  for(uint_fast8_t i = 0; i < INERT_TCOMP_BINS; i++) {
+    Vector3f vOffs(data.gyro_tcomp[i][0], data.gyro_tcomp[i][1], data.gyro_tcomp[i][2]);
+    m_pHalBoard->set_gyro_tcomp(i, vOffs, data.gyro_tcomp_mask & (1 << i) );
+  }
+
+  for(uint_fast8_t i = 0; i < RC_EXPO_AXES; i++) {
+    m_pReceiver->set_expo(i, data.rc_expo[i], data.rc_super[i]);
+  }
+}
+
+void Parameters::capture() {
+  ParamData &data = m_Block.data;
+
+  for(uint_fast8_t i = 0; i < NR_OF_PIDS; i++) {
+    const PIDCtrl &pid = m_pHalBoard->get_pid(i);
+    data.pids[i].kP      = pid.kP();
+    data.pids[i].kI      = pid.kI();
+    data.pids[i].kD      = pid.kD();
+    data.pids[i].kFF     = pid.kFF();
+    data.pids[i].filt_hz = pid.filt_hz();
+    data.pids[i].imax    = pid.imax();
+  }
+
+  data.trim_rol_deg   = m_pHalBoard->get_trim_rol_deg();
+  data.trim_pit_deg   = m_pHalBoard->get_trim_pit_deg();
+  data.batt_type      = m_pHalBoard->m_pBat->get_type();
+  data.batt_cells     = m_pHalBoard->m_pBat->get_cells_cfg();
+
+  Vector3f vComp      = m_pHalBoard->m_pComp->get_offsets();
+  Vector3f vAccOffs   = m_pHalBoard->m_pInert->get_accel_offsets();
+  Vector3f vAccScale  = m_pHalBoard->m_pInert->get_accel_scale();
+  data.comp_offs[0]   = vComp.x;     data.comp_offs[1]   = vComp.y;     data.comp_offs[2]   = vComp.z;
+  data.accel_offs[0]  = vAccOffs.x;  data.accel_offs[1]  = vAccOffs.y;  data.accel_offs[2]  = vAccOffs.z;
+  data.accel_scale[0] = vAccScale.x; data.accel_scale[1] = vAccScale.y; data.accel_scale[2] = vAccScale.z;
+
+  data.gyro_tcomp_mask = 0;
+  for(uint_fast8_t i = 0; i < INERT_TCOMP_BINS; i++) {
+    Vector3f vOffs;
+    if(m_pHalBoard->get_gyro_tcomp(i, vOffs) ) {
+      data.gyro_tcomp_mask |= 1 << i;
+    }
+    data.gyro_tcomp[i][0] = vOffs.x; data.gyro_tcomp[i][1] = vOffs.y; data.gyro_tcomp[i][2] = vOffs.z;
+  }
+
+  for(uint_fast8_t i = 0; i < RC_EXPO_AXES; i++) {
+    data.rc_expo[i]  = m_pReceiver->get_expo(i);
+    data.rc_super[i] = m_pReceiver->get_super(i);
+  }
+
+  uint16_t iCRC = crc16_ccitt(reinterpret_cast<const uint8_t *>(&data), sizeof(ParamData) );
+  ParamHeader &header = m_Block.header;
+  if( header.magic   == PARAM_MAGIC   &&
+      header.version == PARAM_VERSION &&
+      header.size    == sizeof(ParamData) &&
+      header.crc     == iCRC )
+  {
+    return;
+  }
+
+  header.magic   = PARAM_MAGIC;
+  header.version = PARAM_VERSION;
+  header.size    = sizeof(ParamData);
+  header.crc     = iCRC;
+  // (Re-)start the write-back
+  m_iWriteOffs   = 0;
+}
+
+void Parameters::update() {
+  // Never touch the EEPROM in flight
+  if(m_pReceiver->get_channel(RC_THR) > RC_THR_ACRO) {
+    return;
+  }
+
+  uint_fast32_t t32CurTime = m_pHalBoard->m_pHAL->scheduler->millis();
+  if(t32CurTime - m_t32Check >= PARAM_CHECK_T_MS) {
+    capture();
+    m_t32Check = t32CurTime;
+  }
+
+  const uint8_t *pBlock = reinterpret_cast<const uint8_t *>(&m_Block);
+  for(uint_fast8_t i = 0; i < PARAM_CMP_PER_T && m_iWriteOffs < sizeof(m_Block); i++, m_iWriteOffs++) {
+    // The data is written before the header,
+    // so an interrupted write-back is always detected by the CRC check in load()
+    uint_fast16_t iByte = (m_iWriteOffs + sizeof(ParamHeader) ) % sizeof(m_Block);
+    uint_fast16_t iAddr = PARAM_EEPROM_OFFS + iByte;
+    if(m_pHalBoard->m_pHAL->storage->read_byte(iAddr) == pBlock[iByte]) {
+      continue;
+    }
+    // Only one (slow) write per call
+    m_pHalBoard->m_pHAL->storage->write_byte(iAddr, pBlock[iByte]);
+    m_iWriteOffs++;
+    return;
+  }
+}
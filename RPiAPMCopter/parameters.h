@@ -0,0 +1,89 @@
+#ifndef PARAM_h
+#define PARAM_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <AP_Math.h>
+
+#include "config.h"
+
+class Device;
+class Receiver;
+
+
+///////////////////////////////////////////////////////////
+// Layout of the parameter block in the EEPROM
+// Only fixed size types, because the block is copied byte-wise
+///////////////////////////////////////////////////////////
+struct ParamPID {
+  float    kP;
+  float    kI;
+  float    kD;
+  float    kFF;                       // Feed-forward of the set point
+  float    filt_hz;                   // Cut-off frequency of the derivative
+  int16_t  imax;
+};
+
+struct ParamData {
+  ParamPID pids[NR_OF_PIDS];
+  float    trim_rol_deg;              // Device::set_trims()
+  float    trim_pit_deg;
+  int8_t   batt_type;                 // BATT_SENSOR_TYPE
+  uint8_t  batt_cells;                // Nr. of cells; Zero: detection
+  float    comp_offs[3];              // Compass offsets
+  float    accel_offs[3];             // Accelerometer calibration
+  float    accel_scale[3];
+  float    gyro_tcomp[INERT_TCOMP_BINS][3]; // Gyrometer offsets per board temperature bin
+  uint8_t  gyro_tcomp_mask;                 // Learned bins
+  uint8_t  rc_expo[RC_EXPO_AXES];           // Stick curves in percent (roll/pitch, yaw)
+  uint8_t  rc_super[RC_EXPO_AXES];
+};
+
+struct ParamHeader {
+  uint16_t magic;                     // PARAM_MAGIC
+  uint8_t  version;                   // PARAM_VERSION
+  uint16_t size;                      // sizeof(ParamData)
+  uint16_t crc;                       // CRC-16 of ParamData
+};
+
+struct ParamBlock {
+  ParamHeader header;
+  ParamData   data;
+};
+
+///////////////////////////////////////////////////////////
+// Versioned and CRC protected settings in the EEPROM
+///////////////////////////////////////////////////////////
+class Parameters {
+private:
+  Device       *m_pHalBoard;
+  Receiver     *m_pReceiver;
+
+  ParamBlock    m_Block;              // RAM image of the block which should be in the EEPROM
+  uint_fast16_t m_iWriteOffs;         // Write-back cursor; sizeof(m_Block) if the EEPROM is in sync
+  uint_fast32_t m_t32Check;
+
+  void capture();                     // Copy the current settings of the device into m_Block and start the write-back if something changed
+  void apply();                       // Copy the settings from m_Block into the device
+
+public:
+  Parameters(Device *, Receiver *);
+
+  /*
+   * Reads the whole block with one bulk read.
+   * Returns false if the block is missing, from another version or corrupted.
+   * In this case the device keeps its defaults and the block is written back lazily.
+   */
+  bool load();
+
+  /*
+   * Must be called periodically (PARAM_T_MS).
+   * Looks up changed settings and writes at most one changed byte per call back into the EEPROM,
+   * so the busy wait of the EEPROM never stalls the main loop.
+   * Nothing happens while the motors are running.
+   */
+  void update();
+};
+
+#endif /*PARAM_h*/
@@ -1,5 +1,8 @@
 #include <AP_InertialSensor_MPU6000.h>
 #include <AP_InertialNav.h>
+#if CONFIG_HAL_BOARD == HAL_BOARD_APM2
+  #include <avr/io.h>
+#endif
 
 #include "rcframe.h"
 #include "device.h"
@@ -7,8 +10,121 @@
 #include "exceptions.h"
 #include "navigation.h"
 #include "arithmetics.h"
+#if MOTOR_THR_LIN
+  #include "thrustlut.h"
+#endif
 
 
+/*
+ * Limits the servo output to the range of the ESCs
+ * Returns true if the motor is saturated
+ */
+inline bool limit_motor(int_fast16_t &iServo) {
+  if(iServo > RC_THR_MAX) {
+    iServo = RC_THR_MAX;
+    return true;
+  }
+  if(iServo < RC_THR_OFF) {
+    iServo = RC_THR_OFF;
+    return true;
+  }
+  return false;
+}
+
+#if MOTOR_THR_LIN
+// Table position per us of the servo output in 1/65536 steps
+#define THRUST_LUT_SCALE     ((static_cast<uint32_t>(THRUST_LUT_SEGS) << 16) / (RC_THR_MAX - RC_THR_OFF))
+#endif
+
+/*
+ * The mixer treats the servo output as linear in thrust.
+ * Maps this output to the pulse width which produces the thrust on the thrust stand (thrustlut.h):
+ * One table lookup and a linear interpolation in fixed point per motor.
+ */
+inline uint16_t linearize_thrust(const uint_fast8_t iMotor, const int_fast16_t iServo) {
+#if MOTOR_THR_LIN
+  // Motors off stay off: The first entry is where the motor starts to produce thrust
+  if(iServo <= RC_THR_OFF) {
+    return RC_THR_OFF;
+  }
+  const uint16_t *pCurve = THRUST_LUT[iMotor];
+  if(iServo >= RC_THR_MAX) {
+    return pCurve[THRUST_LUT_SEGS];
+  }
+  // Position in the table in 1/256 steps
+  uint_fast32_t iPos  = (static_cast<uint_fast32_t>(iServo - RC_THR_OFF) * THRUST_LUT_SCALE) >> 8;
+  uint_fast8_t  iIdx  = iPos >> 8;
+  int_fast32_t  iFrac = iPos & 0xFF;
+  int_fast32_t  iStep = static_cast<int_fast32_t>(pCurve[iIdx + 1]) - pCurve[iIdx];
+  return pCurve[iIdx] + ((iStep * iFrac) >> 8);
+#else
+  return iServo;
+#endif
+}
+
+// 1/cos() for 0 .. 60 deg in steps of 4 deg (Q12)
+#define TILT_LUT_SEGS        15
+#define TILT_LUT_STEP        64     // 4 deg in 1/16 deg
+static const uint16_t SEC_LUT_Q12[TILT_LUT_SEGS + 1] = {
+  4096, 4106, 4136, 4188, 4261, 4359, 4484, 4639, 4830, 5063, 5347, 5694, 6121, 6653, 7325, 8192
+};
+
+/*
+ * 1/cos() of an angle in Q12: One table lookup and a linear interpolation.
+ * Larger angles than the table are clamped (the compensation is clamped anyway).
+ */
+inline uint_fast32_t sec_q12(const float fAngle_deg) {
+  uint_fast16_t iAng = static_cast<uint_fast16_t>(fabs(fAngle_deg) * 16.f);
+  iAng = iAng < TILT_LUT_SEGS * TILT_LUT_STEP ? iAng : TILT_LUT_SEGS * TILT_LUT_STEP - 1;
+  uint_fast8_t  iIdx  = iAng / TILT_LUT_STEP;
+  uint_fast32_t iFrac = iAng % TILT_LUT_STEP;
+  return SEC_LUT_Q12[iIdx] + ( (SEC_LUT_Q12[iIdx + 1] - SEC_LUT_Q12[iIdx]) * iFrac) / TILT_LUT_STEP;
+}
+
+#if CONFIG_HAL_BOARD == HAL_BOARD_APM2
+// Timer ticks are 0.5 us (prescaler 8 at 16 MHz)
+#define PWM_TICKS_PER_US     2
+
+/*
+ * APM2: Channel 0, 1 are driven by timer 1 (OCR1B, OCR1A) and channel 2, 3 by timer 4 (OCR4C, OCR4B) in fast PWM mode.
+ * Each pulse starts at the bottom of the period and ends at the compare match.
+ */
+inline uint16_t motor_ocr_max() {
+  uint16_t iMax = OCR1A > OCR1B ? OCR1A : OCR1B;
+  iMax = OCR4B > iMax ? OCR4B : iMax;
+  return OCR4C > iMax ? OCR4C : iMax;
+}
+
+/*
+ * The compare registers are double buffered and only loaded at the start of the next period,
+ * so a new pulse width waits up to one full period (~2 ms at 490 Hz) before it reaches the ESCs.
+ * If the pulses of the running period are over, both timers are moved to the end of their period:
+ * The new pulses start with the next tick and all four motors stay in phase.
+ * iRunning: motor_ocr_max() before the new pulse widths were written.
+ * If the last call did not sync, its widths may still be waiting in the buffer, while the older ones are running:
+ * The larger of both is used then.
+ * Must be called with interrupts disabled (16 bit timer registers).
+ */
+inline void sync_pwm_edge(const uint16_t iRunning) {
+  static uint16_t iPending = 0;
+  uint16_t iEnd = iRunning > iPending ? iRunning : iPending;
+  if(TCNT1 > iEnd && TCNT4 > iEnd) {
+    TCNT1 = ICR1 - 1;
+    TCNT4 = ICR4 - 1;
+    iPending = 0;
+  } else {
+    iPending = iRunning;
+  }
+}
+
+/*
+ * Time until the current pulse widths appear at the ESCs in us
+ */
+inline uint_fast16_t pwm_wait_us() {
+  return (ICR1 - TCNT1) / PWM_TICKS_PER_US;
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////
 // Abstract class implementation
 ////////////////////////////////////////////////////////////////////////
@@ -26,10 +142,13 @@ Frame::Frame(Device *pDev, Receiver *pRecv, Exception *pExcp, UAVNav* pUAV) {
 }
 
 void Frame::read_receiver() {
-  m_fRCRol = static_cast<float>(m_pReceiver->get_channel(RC_ROL) );
-  m_fRCPit = static_cast<float>(m_pReceiver->get_channel(RC_PIT) );
-  m_fRCThr = static_cast<float>(m_pReceiver->get_channel(RC_THR) > RC_THR_80P ? RC_THR_80P : m_pReceiver->get_channel(2) );
-  m_fRCYaw = static_cast<float>(m_pReceiver->get_channel(RC_YAW) );
+  // Continuous set points at the time of the sensor frame
+  uint32_t t32Frame_us = m_pHalBoard->get_frame().timestamp_us;
+  m_fRCRol = m_pReceiver->get_setpoint(RC_ROL, t32Frame_us);
+  m_fRCPit = m_pReceiver->get_setpoint(RC_PIT, t32Frame_us);
+  m_fRCThr = m_pReceiver->get_setpoint(RC_THR, t32Frame_us);
+  m_fRCThr = m_fRCThr > RC_THR_80P ? RC_THR_80P : m_fRCThr;
+  m_fRCYaw = m_pReceiver->get_setpoint(RC_YAW, t32Frame_us);
 }
 
 void Frame::run() {
@@ -37,6 +156,10 @@ void Frame::run() {
   while(!m_pHalBoard->m_pInert->wait_for_sample(MAIN_T_MS) );
   // .. and update inertial information
   m_pHalBoard->update_attitude();
+  // All following functions work with this snapshot of the sensors
+  m_pHalBoard->update_frame();
+  // Detect stale or frozen sensors before the exception handling
+  m_pHalBoard->update_health();
   
   // Handle all defined problems (time-outs, broken gyrometer, GPS signal ..)
   m_pExeption->handle();
@@ -56,18 +179,62 @@ void Frame::run() {
 ////////////////////////////////////////////////////////////////////////
 // Class implementation
 ////////////////////////////////////////////////////////////////////////
-M4XFrame::M4XFrame(Device *pDev, Receiver *pRecv, Exception *pExcp, UAVNav* pUAV) : Frame(pDev, pRecv, pExcp, pUAV)
+M4XFrame::M4XFrame(Device *pDev, Receiver *pRecv, Exception *pExcp, UAVNav* pUAV) : Frame(pDev, pRecv, pExcp, pUAV),
+  m_AltCurve(ALT_VEL_MAX_CMS, ALT_ACC_MAX_CMSS, ALT_JERK_MAX_CMSSS)
 {
   _FL = _BL = _FR = _BR = RC_THR_OFF;
   m_fBattComp   = 0.f;
   m_fTiltComp   = 0.f;
+  m_bSaturated  = false;
+  m_bAltHold    = false;
 }
 
 void M4XFrame::servo_out() {
-  m_pHalBoard->m_pHAL->rcout->write(MOTOR_FL, _FL);
-  m_pHalBoard->m_pHAL->rcout->write(MOTOR_BL, _BL);
-  m_pHalBoard->m_pHAL->rcout->write(MOTOR_FR, _FR);
-  m_pHalBoard->m_pHAL->rcout->write(MOTOR_BR, _BR);
+  // Use the non-short-circuit operator, because all motors must be limited
+  m_bSaturated = limit_motor(_FL) | limit_motor(_BL) | limit_motor(_FR) | limit_motor(_BR);
+
+  // The motors are on the channels 0 .. MOTOR_CNT-1, so one call updates all of them
+  uint16_t rgPulse_us[MOTOR_CNT];
+  rgPulse_us[MOTOR_FL] = linearize_thrust(MOTOR_FL, _FL);
+  rgPulse_us[MOTOR_BL] = linearize_thrust(MOTOR_BL, _BL);
+  rgPulse_us[MOTOR_FR] = linearize_thrust(MOTOR_FR, _FR);
+  rgPulse_us[MOTOR_BR] = linearize_thrust(MOTOR_BR, _BR);
+
+  // No interrupt between the channels: All motors get the new values in the same PWM period
+  m_pHalBoard->m_pHAL->scheduler->begin_atomic();
+#if CONFIG_HAL_BOARD == HAL_BOARD_APM2 && MOTOR_SYNC_EDGE
+  uint16_t iRunning = motor_ocr_max();
+#endif
+  m_pHalBoard->m_pHAL->rcout->write(0, rgPulse_us, MOTOR_CNT);
+#if CONFIG_HAL_BOARD == HAL_BOARD_APM2 && MOTOR_SYNC_EDGE
+  sync_pwm_edge(iRunning);
+#endif
+#if BENCH_OUT && CONFIG_HAL_BOARD == HAL_BOARD_APM2
+  uint_fast16_t iWait_us = pwm_wait_us();
+#endif
+  m_pHalBoard->m_pHAL->scheduler->end_atomic();
+
+#if BENCH_OUT
+  // Latency from the IMU sample to the start of the PWM pulse with the new values
+  static uint32_t iLatSum_us = 0;
+  static uint32_t iLatMax_us = 0;
+  static int iBCounter = 0;
+  static uint32_t iTimer = 0;
+  uint32_t iLat_us = m_pHalBoard->m_pHAL->scheduler->micros() - m_pHalBoard->get_frame().timestamp_us;
+  #if CONFIG_HAL_BOARD == HAL_BOARD_APM2
+  iLat_us += iWait_us;
+  #endif
+  iLatSum_us += iLat_us;
+  iLatMax_us  = iLat_us > iLatMax_us ? iLat_us : iLatMax_us;
+  ++iBCounter;
+  uint32_t iBCurTime = m_pHalBoard->m_pHAL->scheduler->millis();
+  if(iBCurTime - iTimer >= 1000) {
+    m_pHalBoard->m_pHAL->console->printf_P(PSTR("Benchmark - IMU to PWM latency: avg %lu us, max %lu us\n"), iLatSum_us / iBCounter, iLatMax_us);
+    iLatSum_us = iLatMax_us = 0;
+    iBCounter = 0;
+    iTimer = iBCurTime;
+  }
+#endif
 }
 
 void M4XFrame::clear() {
@@ -95,10 +262,12 @@ void M4XFrame::calc_tilt_comp() {
   // For safety, always reset the correction term
   m_fTiltComp = 1.f;
 
-  if( in_range(RC_ROL_MIN, RC_ROL_MAX, m_fRCRol) &&
-      in_range(RC_PIT_MIN, RC_PIT_MAX, m_fRCPit) ) 
-  {
-    m_fTiltComp = 1.f / (cos(ToRad(m_fRCRol) ) * cos(ToRad(m_fRCPit) ) );
+  // The thrust lost by the tilt depends on the real attitude, not on the set point of the pilot
+  const SensorFrame &frame = m_pHalBoard->get_frame();
+  if(frame.valid & SensorFrame::ATTITUDE_F) {
+    // 1/(cos(pitch) * cos(roll)) in Q24
+    uint_fast32_t iComp_q24 = sec_q12(frame.atti_deg.x) * sec_q12(frame.atti_deg.y);
+    m_fTiltComp = constrain_float(static_cast<float>(iComp_q24) / 16777216.f, 1.f, TILT_COMP_MAX);
   }
 }
 
@@ -106,11 +275,10 @@ void M4XFrame::calc_batt_comp() {
   // For safety, always reset the correction term
   m_fBattComp = 1.f;
 
-  float fCurVoltage = m_pHalBoard->get_bat().voltage_V;
-  if( m_pHalBoard->get_bat().refVoltage_V > 0.f && 
-      in_range(BATT_MIN_VOLTAGE, BATT_MAX_VOLTAGE, fCurVoltage) )
-  {
-    m_fBattComp = m_pHalBoard->get_bat().refVoltage_V / fCurVoltage;
+  const SensorFrame &frame = m_pHalBoard->get_frame();
+  // The expected voltage under the average load follows the sag, but not the noise of the current
+  if(frame.valid & SensorFrame::BATTERY_F && frame.loadVoltage_V > 0.f) {
+    m_fBattComp = constrain_float(frame.refVoltage_V / frame.loadVoltage_V, 1.f, BATT_COMP_MAX);
   }
 }
 
@@ -138,6 +306,9 @@ void M4XFrame::calc_gpsnavig_hold() {
   
   // Set yaw in remote control
   m_pReceiver->set_channel(RC_YAW, m_pNavigation->calc_yaw() );
+  // Position controller: Uses the heading error and the leg of calc_yaw()
+  m_pReceiver->set_channel(RC_PIT, m_pNavigation->calc_pitch() );
+  m_pReceiver->set_channel(RC_ROL, m_pNavigation->calc_roll() );
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -155,26 +326,38 @@ void M4XFrame::calc_altitude_hold() {
 
   // return if in standard remote control mode
   if(m_pReceiver->get_waypoint()->mode == GPSPosition::NOTHING_F) {
+    m_bAltHold = false;
     return;
   }
 
   // Return estimated altitude by GPS and barometer
-  bool bOK_H, bOK_G;
+  const SensorFrame &frame = m_pHalBoard->get_frame();
+  const float fDT_s   = frame.dt_s;
   float fTargAlti_cm  = static_cast<float>(m_pReceiver->get_waypoint()->altitude_cm);
-  float fCurrAlti_cm  = Device::get_altitude_cm(m_pHalBoard, bOK_H);
-  float fClmbRate_cms = m_pHalBoard->m_pInertNav->get_velocity_z();
+  float fCurrAlti_cm  = frame.altitude_cm;
+  float fClmbRate_cms = frame.climb_rate_cms;
   // Get the acceleration in g
-  float fAccel_g      = Device::get_accel_z_g(m_pHalBoard, bOK_G) * fScaleF_g;
+  float fAccel_g      = frame.accel_g.z * fScaleF_g;
 
-  if(!bOK_H || !bOK_G) {
+  if(!(frame.valid & SensorFrame::ALTITUDE_F) || !(frame.valid & SensorFrame::ACCEL_F) ) {
+    m_bAltHold = false;
     return;
   }
 
+  // A new target altitude is approached along the S-curve instead of a step
+  if(!m_bAltHold) {
+    m_AltCurve.reset(fCurrAlti_cm, fClmbRate_cms);
+    m_bAltHold = true;
+  }
+  m_AltCurve.update(fTargAlti_cm, fDT_s);
+  float fSetpAlti_cm  = m_AltCurve.get_pos();
+
   // Calculate the motor speed changes by the error from the height estimate and the current climb rates
   // If the quadro is going down, because of an device error, then this code is not used
   if(m_pReceiver->get_waypoint()->mode != GPSPosition::CONTRLD_DOWN_F) {
-    float fAltZStabOut = m_pHalBoard->get_pid(PID_THR_STAB).get_pid(fTargAlti_cm - fCurrAlti_cm, 1);
-    iAltZOutput        = m_pHalBoard->get_pid(PID_THR_RATE).get_pid(fAltZStabOut - fClmbRate_cms, 1);
+    // The climb rate of the set point is fed forward (an altitude is no feed-forward for a climb rate output)
+    float fAltZStabOut = m_pHalBoard->get_pid(PID_THR_STAB).get_pid(fSetpAlti_cm - fCurrAlti_cm, fDT_s, 0.f, m_bSaturated) + m_AltCurve.get_vel();
+    iAltZOutput        = m_pHalBoard->get_pid(PID_THR_RATE).get_pid(fAltZStabOut - fClmbRate_cms, fDT_s, fAltZStabOut, m_bSaturated);
   }
 
   if(m_pReceiver->get_channel(RC_ROL) > RC_THR_OFF) {
@@ -192,8 +375,8 @@ void M4XFrame::calc_altitude_hold() {
   // Don't change the throttle if acceleration is below a certain bias
   if(fabs(fAccel_g) >= fBias_g) {
     //fAccel_g         = sign_f(fAccel_g) * (abs(fAccel_g) - fBias_g) * fScaleF_g;
-    float fAccZStabOut = m_pHalBoard->get_pid(PID_ACC_STAB).get_pid(fAccel_g, 1);
-    iAccZOutput        = m_pHalBoard->get_pid(PID_ACC_RATE).get_pid(fAccZStabOut, 1);
+    float fAccZStabOut = m_pHalBoard->get_pid(PID_ACC_STAB).get_pid(fAccel_g, fDT_s, 0.f, m_bSaturated);
+    iAccZOutput        = m_pHalBoard->get_pid(PID_ACC_RATE).get_pid(fAccZStabOut, fDT_s, 0.f, m_bSaturated);
   }
 
   // Modify the speed of the motors to hold the altitude
@@ -215,15 +398,16 @@ void M4XFrame::calc_attitude_hold() {
   // additional filter or rc variables
   static float targ_yaw = 0.f; // Yaw target from RC
   
-  Vector3f vAtti = m_pHalBoard->get_atti_cor_deg(); // returns the fused sensor value (gyrometer and accelerometer)
-  Vector3f vGyro = m_pHalBoard->get_gyro_cor_deg(); // returns the sensor value from the gyrometer
+  const Vector3f &vAtti = m_pHalBoard->get_frame().atti_deg; // returns the fused sensor value (gyrometer and accelerometer)
+  const Vector3f &vGyro = m_pHalBoard->get_frame().gyro_deg; // returns the sensor value from the gyrometer
+  const float fDT_s     = m_pHalBoard->get_frame().dt_s;     // real time step of the main loop
 
   // Throttle raised, turn on stabilisation.
   if(m_fRCThr > RC_THR_ACRO) {
-    // Stabilise PIDS
-    float pit_stab_output = constrain_float(m_pHalBoard->get_pid(PID_PIT_STAB).get_pid(m_fRCPit - vAtti.x, 1), -250, 250);
-    float rol_stab_output = constrain_float(m_pHalBoard->get_pid(PID_ROL_STAB).get_pid(m_fRCRol - vAtti.y, 1), -250, 250);
-    float yaw_stab_output = constrain_float(m_pHalBoard->get_pid(PID_YAW_STAB).get_pid(wrap180_f(targ_yaw - vAtti.z), 1), -360, 360);
+    // Stabilise PIDS: The outputs are rates, so the angle set points are no feed-forward
+    float pit_stab_output = constrain_float(m_pHalBoard->get_pid(PID_PIT_STAB).get_pid(m_fRCPit - vAtti.x, fDT_s, 0.f, m_bSaturated), -250, 250);
+    float rol_stab_output = constrain_float(m_pHalBoard->get_pid(PID_ROL_STAB).get_pid(m_fRCRol - vAtti.y, fDT_s, 0.f, m_bSaturated), -250, 250);
+    float yaw_stab_output = constrain_float(m_pHalBoard->get_pid(PID_YAW_STAB).get_pid(wrap180_f(targ_yaw - vAtti.z), fDT_s, 0.f, m_bSaturated), -360, 360);
 
     // Is pilot asking for yaw change? - If so, feed directly to rate PID (overwriting yaw stab output)
     if(fabs(m_fRCYaw ) > 5.f) {
@@ -231,10 +415,10 @@ void M4XFrame::calc_attitude_hold() {
       targ_yaw = vAtti.z; // remember this yaw for when pilot stops
     }
 
-    // Rate PIDS
-    int_fast16_t pit_output = static_cast<int_fast16_t>(constrain_float(m_pHalBoard->get_pid(PID_PIT_RATE).get_pid(pit_stab_output - vGyro.x, 1), -500, 500) );
-    int_fast16_t rol_output = static_cast<int_fast16_t>(constrain_float(m_pHalBoard->get_pid(PID_ROL_RATE).get_pid(rol_stab_output - vGyro.y, 1), -500, 500) );
-    int_fast16_t yaw_output = static_cast<int_fast16_t>(constrain_float(m_pHalBoard->get_pid(PID_YAW_RATE).get_pid(yaw_stab_output - vGyro.z, 1), -500, 500) );
+    // Rate PIDS: The rate set point is fed forward
+    int_fast16_t pit_output = static_cast<int_fast16_t>(constrain_float(m_pHalBoard->get_pid(PID_PIT_RATE).get_pid(pit_stab_output - vGyro.x, fDT_s, pit_stab_output, m_bSaturated), -500, 500) );
+    int_fast16_t rol_output = static_cast<int_fast16_t>(constrain_float(m_pHalBoard->get_pid(PID_ROL_RATE).get_pid(rol_stab_output - vGyro.y, fDT_s, rol_stab_output, m_bSaturated), -500, 500) );
+    int_fast16_t yaw_output = static_cast<int_fast16_t>(constrain_float(m_pHalBoard->get_pid(PID_YAW_RATE).get_pid(yaw_stab_output - vGyro.z, fDT_s, yaw_stab_output, m_bSaturated), -500, 500) );
 
     // Apply: tilt- and battery-compensation algorithms
     apply_motor_compens();
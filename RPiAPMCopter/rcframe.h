@@ -2,6 +2,7 @@
 #include <stddef.h>
 
 #include "config.h"
+#include "controller.h"
 
 class Device;
 class Receiver;
@@ -68,6 +69,13 @@ private:
   // Motor compensation terms (if model is tilted or battery voltage drops)
   float m_fBattComp;
   float m_fTiltComp;
+
+  // A motor hit its limit in the last iteration: Stops the integrators from winding up
+  bool  m_bSaturated;
+
+  // Altitude set point: Moves to the target altitude with limited climb rate, acceleration and jerk
+  SCurve m_AltCurve;
+  bool   m_bAltHold;                      // Set point engaged (starts at the current altitude)
   
   // Calculate and apply the motor compensation terms
   void calc_batt_comp();                  // battery voltage drop compensation
@@ -1,8 +1,10 @@
 #include <AP_InertialSensor.h> // for user interactant
 #include <AP_AHRS.h>
+#include <AP_InertialNav.h>
 #include <RC_Channel.h>     // RC Channel Library
 
 #include <float.h>
+#include <AP_Progmem.h>
 
 #include "receiver.h"
 #include "device.h"
@@ -82,6 +84,19 @@ inline float *parse_pid_substr(char* buffer) {
   return rgfPIDS;
 }
 
+// Only the gains are changed, the state of the controller is kept
+inline void set_rate_pid(Device *pHalBoard, uint_fast8_t iPID, const float *pids) {
+  PIDCtrl &pid = pHalBoard->get_pid(iPID);
+  pid.kP(pids[0]);
+  pid.kI(pids[1]);
+  pid.kD(pids[2]);
+  pid.imax(pids[3]);
+}
+
+inline void set_stab_pid(Device *pHalBoard, uint_fast8_t iPID, float fKP) {
+  pHalBoard->get_pid(iPID).kP(fKP);
+}
+
 inline bool check_input(int_fast16_t iRol, int_fast16_t iPit, int_fast16_t iThr, int_fast16_t iYaw) {
   if(!in_range(RC_PIT_MIN, RC_PIT_MAX, iPit) ) {
     return false;
@@ -98,11 +113,101 @@ inline bool check_input(int_fast16_t iRol, int_fast16_t iPit, int_fast16_t iThr,
   return true;
 }
 
+/*
+ * Consistent overhead byte stuffing: Decodes iLen bytes (without the zero delimiter) into iLen - 1 bytes
+ * Returns false if the code bytes do not match the length
+ */
+inline bool cobs_decode(const uint8_t *pIn, const uint_fast8_t iLen, uint8_t *pOut) {
+  uint_fast8_t iOut = 0;
+  for(uint_fast8_t i = 0; i < iLen;) {
+    uint_fast8_t iCode = pIn[i++];
+    if(iCode == 0 || i + iCode - 1 > iLen) {
+      return false;
+    }
+    for(uint_fast8_t j = 1; j < iCode; j++) {
+      pOut[iOut++] = pIn[i++];
+    }
+    // A code of 0xFF is a full block without a zero
+    if(iCode < 0xFF && i < iLen) {
+      pOut[iOut++] = 0;
+    }
+  }
+  return iOut == iLen - 1;
+}
+
+#if RADIO_V2_FEC
+// Logarithm to the base 2 in GF(256) (polynomial 0x11D); Entry 0 is unused
+static const uint8_t GF256_LOG[256] PROGMEM = {
+    0,   0,   1,  25,   2,  50,  26, 198,   3, 223,  51, 238,  27, 104, 199,  75,
+    4, 100, 224,  14,  52, 141, 239, 129,  28, 193, 105, 248, 200,   8,  76, 113,
+    5, 138, 101,  47, 225,  36,  15,  33,  53, 147, 142, 218, 240,  18, 130,  69,
+   29, 181, 194, 125, 106,  39, 249, 185, 201, 154,   9, 120,  77, 228, 114, 166,
+    6, 191, 139,  98, 102, 221,  48, 253, 226, 152,  37, 179,  16, 145,  34, 136,
+   54, 208, 148, 206, 143, 150, 219, 189, 241, 210,  19,  92, 131,  56,  70,  64,
+   30,  66, 182, 163, 195,  72, 126, 110, 107,  58,  40,  84, 250, 133, 186,  61,
+  202,  94, 155, 159,  10,  21, 121,  43,  78, 212, 229, 172, 115, 243, 167,  87,
+    7, 112, 192, 247, 140, 128,  99,  13, 103,  74, 222, 237,  49, 197, 254,  24,
+  227, 165, 153, 119,  38, 184, 180, 124,  17,  68, 146, 217,  35,  32, 137,  46,
+   55,  63, 209,  91, 149, 188, 207, 205, 144, 135, 151, 178, 220, 252, 190,  97,
+  242,  86, 211, 171,  20,  42,  93, 158, 132,  60,  57,  83,  71, 109,  65, 162,
+   31,  45,  67, 216, 183, 123, 164, 118, 196,  23,  73, 236, 127,  12, 111, 246,
+  108, 161,  59,  82,  41, 157,  85, 170, 251,  96, 134, 177, 187, 204,  62,  90,
+  203,  89,  95, 176, 156, 169, 160,  81,  11, 245,  22, 235, 122, 117,  44, 215,
+   79, 174, 213, 233, 230, 231, 173, 232, 116, 214, 244, 234, 168,  80,  88, 175
+};
+
+/*
+ * Reed-Solomon code with two check bytes at the end of the block (roots 1 and 2 in GF(256)):
+ * Corrects one corrupted byte in place. Returns the nr. of corrected bytes or -1 if the block has more errors than that.
+ * The ratio of the syndromes is 2^(distance of the error from the end): One log table in flash, two lookups.
+ */
+inline int_fast8_t rs2_correct(uint8_t *pData, const uint_fast8_t iLen) {
+  uint8_t iS0 = 0;  // Sum of the bytes: The error value
+  uint8_t iS1 = 0;  // Horner sum with 2: The error value times 2^(iLen - 1 - position)
+  for(uint_fast8_t i = 0; i < iLen; i++) {
+    iS0 ^= pData[i];
+    iS1  = gf256_mul2(iS1) ^ pData[i];
+  }
+  if(iS0 == 0 && iS1 == 0) {
+    return 0;
+  }
+  if(iS0 == 0 || iS1 == 0) {
+    return -1;
+  }
+  uint_fast16_t iDist = (255 + pgm_read_byte(&GF256_LOG[iS1]) - pgm_read_byte(&GF256_LOG[iS0]) ) % 255;
+  if(iDist >= iLen) {
+    return -1;
+  }
+  pData[iLen - 1 - iDist] ^= iS0;
+  return 1;
+}
+#endif
+
+/*
+ * Unsigned field of iCnt bits at bit iBit (little endian, LSB first)
+ */
+inline uint_fast16_t get_bits(const uint8_t *pData, const uint_fast8_t iBit, const uint_fast8_t iCnt) {
+  uint_fast32_t iWord = 0;
+  for(uint_fast8_t i = 0; i < (iBit % 8 + iCnt + 7) / 8; i++) {
+    iWord |= static_cast<uint_fast32_t>(pData[iBit / 8 + i]) << (8 * i);
+  }
+  return (iWord >> (iBit % 8) ) & ((1UL << iCnt) - 1);
+}
+
+/*
+ * Channel of a frame v2 in degrees (rounded); The field of iCnt bits is centered at 2^(iCnt-1)
+ */
+inline int_fast16_t radio_v2_deg(const uint_fast16_t iRaw, const uint_fast8_t iCnt) {
+  int_fast16_t iVal = static_cast<int_fast16_t>(iRaw) - (1 << (iCnt - 1) );
+  return (iVal >= 0 ? iVal + RADIO_V2_DEG_SCALE / 2 : iVal - RADIO_V2_DEG_SCALE / 2) / RADIO_V2_DEG_SCALE;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 // Receiver
 ///////////////////////////////////////////////////////////////////////////////////////
-Receiver::Receiver(Device *pHalBoard) {
+Receiver::Receiver(Device *pHalBoard, MAVCom *pMAVCom) {
   m_pHalBoard = pHalBoard;
+  m_pMAVCom   = pMAVCom;
 
   memset(m_cBuffer, 0, sizeof(m_cBuffer) );
   memset(m_rgChannelsRC, 0, sizeof(m_rgChannelsRC) );
@@ -110,6 +215,26 @@ Receiver::Receiver(Device *pHalBoard) {
   m_iPPMTimer = m_iSParseTimer_A = m_iSParseTimer_C = m_iSParseTimer = m_pHalBoard->m_pHAL->scheduler->millis();
   m_iPPMTime  = m_iSParseTime_A  = m_iSParseTime_C  = m_iSParseTime  = 0;
   m_eErrors   = NOTHING_F;
+
+  memset(m_rgSetpoints, 0, sizeof(m_rgSetpoints) );
+  m_t32Packet  = m_pHalBoard->m_pHAL->scheduler->micros();
+  m_fInvPeriod = 0.f;
+  m_bArmed     = false;
+
+  memset(m_rgRadioV2, 0, sizeof(m_rgRadioV2) );
+  m_iRadioV2Offs = 0;
+  m_iRadioSeq    = 0;
+  m_iRadioLost   = 0;
+  m_iRadioFixed  = 0;
+  m_iRadioAux    = 0;
+  m_iRadioMode   = 0;
+  m_t32RadioV2   = 0UL - RADIO_V2_LOCK_MS;        // Frames v1 are accepted from the start
+  m_t32FenceOut  = 0;
+
+  // Linear curves as default
+  for(uint_fast8_t i = 0; i < RC_EXPO_AXES; i++) {
+    set_expo(i, 0, 0);
+  }
   
   m_pRCRol = new RC_Channel(RC_ROL);
   m_pRCPit = new RC_Channel(RC_PIT);
@@ -136,8 +261,175 @@ Receiver::Receiver(Device *pHalBoard) {
 void Receiver::set_channel(uint_fast8_t index, int_fast32_t value) {
   if(index >= APM_IOCHAN_CNT) {
     m_rgChannelsRC[APM_IOCHAN_CNT-1] = value;
+    return;
   }
   m_rgChannelsRC[index] = value;
+
+  // Overrides (e.g. by the exception handler) are not interpolated
+  if(index < RC_SETP_CNT) {
+    RCSetpoint &setp = m_rgSetpoints[index];
+    setp.prev = setp.cur = setp.out = static_cast<float>(value);
+  }
+}
+
+void Receiver::update_setpoints() {
+  uint32_t t32CurrentTime = m_pHalBoard->m_pHAL->scheduler->micros();
+  uint32_t iPeriod_us     = dt_us(t32CurrentTime, m_t32Packet);
+  m_t32Packet             = t32CurrentTime;
+
+  // After a gap the packets are not related anymore: Jump to the new value
+  bool bGap    = iPeriod_us == 0 || iPeriod_us > RC_SETP_MAX_GAP_MS * 1000UL;
+  m_fInvPeriod = bGap ? 0.f : 1.f / static_cast<float>(iPeriod_us);
+
+  for(uint_fast8_t i = 0; i < RC_SETP_CNT; i++) {
+    RCSetpoint &setp = m_rgSetpoints[i];
+    setp.prev = setp.cur;
+    setp.cur  = static_cast<float>(apply_expo(i, m_rgChannelsRC[i]) );
+    if(bGap) {
+      setp.prev = setp.cur;
+    }
+  }
+  // Motors off: The throttle cut is not delayed by the interpolation and the filter
+  if(m_rgChannelsRC[RC_THR] <= RC_THR_OFF) {
+    RCSetpoint &setp = m_rgSetpoints[RC_THR];
+    setp.prev = setp.cur = setp.out = static_cast<float>(m_rgChannelsRC[RC_THR]);
+  }
+
+  // Arming: The navigation origin is the position where the motors start
+  bool bArmed = m_rgChannelsRC[RC_THR] > RC_THR_OFF;
+  if(bArmed && !m_bArmed && m_pHalBoard->m_pInertNav->position_ok() ) {
+    set_nav_origin(m_pHalBoard->m_pInertNav->get_latitude(), m_pHalBoard->m_pInertNav->get_longitude() );
+  }
+  m_bArmed = bArmed;
+}
+
+void Receiver::set_nav_origin(int32_t iLat, int32_t iLon) {
+  const NavOrigin &origin = m_Mission.get_origin();
+  // The fence is stored relative to the origin, so move it with the origin
+  if(origin.is_set() ) {
+    int32_t iN_cm, iE_cm;
+    origin.to_cm(iLat, iLon, iN_cm, iE_cm);
+    m_Fence.shift(iN_cm, iE_cm);
+  }
+  m_Mission.set_origin(iLat, iLon);
+}
+
+void Receiver::update_fence() {
+  bool bActive = m_bArmed && m_Fence.is_enabled() && m_pHalBoard->m_pInertNav->position_ok();
+  bool bBreach = false;
+  if(bActive) {
+    int32_t iN_cm, iE_cm;
+    m_Mission.get_origin().to_cm(m_pHalBoard->m_pInertNav->get_latitude(), m_pHalBoard->m_pInertNav->get_longitude(), iN_cm, iE_cm);
+    const SensorFrame &frame = m_pHalBoard->get_frame();
+    bBreach = m_Fence.check(iN_cm, iE_cm, frame.altitude_cm, frame.valid & SensorFrame::ALTITUDE_F);
+  }
+
+  // Hysteresis: The flag stays until the model was inside for FENCE_HOLD_MS.
+  // Otherwise the failsafe would toggle at the edge (or the ceiling) and each new breach would restart the take down.
+  uint_fast32_t t32Now = m_pHalBoard->m_pHAL->scheduler->millis();
+  if(bBreach) {
+    m_t32FenceOut = t32Now;
+  }
+  bool bFlag = bBreach || (bActive && chk_fset(m_eErrors, GEOFENCE_F) && t32Now - m_t32FenceOut < FENCE_HOLD_MS);
+  m_eErrors = static_cast<DEVICE_ERROR_FLAGS>(bFlag ? add_flag(m_eErrors, GEOFENCE_F) : rem_flag(m_eErrors, GEOFENCE_F) );
+}
+
+void Receiver::set_expo(uint_fast8_t iAxis, uint8_t iExpo, uint8_t iSuper) {
+  if(iAxis >= RC_EXPO_AXES) {
+    return;
+  }
+  m_rgExpo[iAxis]  = iExpo  > 100 ? 100 : iExpo;
+  m_rgSuper[iAxis] = iSuper > RC_SUPER_MAX ? RC_SUPER_MAX : iSuper;
+  calc_expo_lut(iAxis);
+}
+
+uint8_t Receiver::get_expo(uint_fast8_t iAxis) const {
+  return iAxis < RC_EXPO_AXES ? m_rgExpo[iAxis] : 0;
+}
+
+uint8_t Receiver::get_super(uint_fast8_t iAxis) const {
+  return iAxis < RC_EXPO_AXES ? m_rgSuper[iAxis] : 0;
+}
+
+/*
+ * Expo:       y = (1 - e) * x + e * x^3
+ * Super rate: y = y * (1 - s) / (1 - s * x)
+ * The super rate is normalized, so the full deflection stays at the limits of the channel (RC_ROL_MAX, ..),
+ * but the curve becomes flatter around the center
+ */
+void Receiver::calc_expo_lut(uint_fast8_t iAxis) {
+  float fExpo  = m_rgExpo[iAxis]  / 100.f;
+  float fSuper = m_rgSuper[iAxis] / 100.f;
+
+  for(uint_fast8_t i = 0; i < RC_EXPO_LUT_S; i++) {
+    float fX = static_cast<float>(i) / (RC_EXPO_LUT_S - 1);
+    float fY = (1.f - fExpo) * fX + fExpo * fX * fX * fX;
+    fY       = fY * (1.f - fSuper) / (1.f - fSuper * fX);
+    m_rgExpoLUT[iAxis][i] = static_cast<int16_t>(fY * RC_EXPO_ONE + 0.5f);
+  }
+}
+
+int_fast32_t Receiver::apply_expo(uint_fast8_t iChannel, int_fast32_t iVal) const {
+  int_fast32_t iMax;
+  uint_fast8_t iAxis;
+  switch(iChannel) {
+    case RC_ROL:
+      iMax = RC_ROL_MAX; iAxis = 0;
+      break;
+    case RC_PIT:
+      iMax = RC_PIT_MAX; iAxis = 0;
+      break;
+    case RC_YAW:
+      iMax = RC_YAW_MAX; iAxis = 1;
+      break;
+    default:
+      return iVal;
+  }
+
+  int_fast32_t iAbs = iVal < 0 ? -iVal : iVal;
+  if(iAbs >= iMax) {
+    return iVal;
+  }
+
+  // Position in the table with 8 bit fraction
+  int_fast32_t iPos  = (iAbs * ((RC_EXPO_LUT_S - 1) << 8) ) / iMax;
+  int_fast32_t iInd  = iPos >> 8;
+  int_fast32_t iFrac = iPos & 0xFF;
+  const int16_t *pLUT = m_rgExpoLUT[iAxis];
+  int_fast32_t iY    = pLUT[iInd] + (((pLUT[iInd+1] - pLUT[iInd]) * iFrac) >> 8);
+
+  // Back into the unit of the channel (rounded)
+  iY = (iY * iMax + RC_EXPO_ONE / 2) / RC_EXPO_ONE;
+  return iVal < 0 ? -iY : iY;
+}
+
+float Receiver::get_setpoint(uint_fast8_t index, uint32_t t32Now_us) {
+#if RC_SETP_MODE == 0
+  (void)t32Now_us;                                  // The last packet applies immediately
+  return static_cast<float>(index < RC_SETP_CNT ? apply_expo(index, get_channel(index) ) : get_channel(index) );
+#else
+  if(index >= RC_SETP_CNT) {
+    return static_cast<float>(get_channel(index) );
+  }
+
+  RCSetpoint &setp = m_rgSetpoints[index];
+  // The frame may be a little older than the packet
+  int32_t iDT_us = static_cast<int32_t>(dt_us(t32Now_us, m_t32Packet) );
+  float   fDT_us = iDT_us > 0 ? static_cast<float>(iDT_us) : 0.f;
+
+  #if RC_SETP_MODE == 1
+  // Interpolation: Reaches the value of the last packet when the next one is expected
+  float fFrac = fDT_us * m_fInvPeriod;
+  float fVal  = m_fInvPeriod > 0.f && fFrac < 1.f ? setp.prev + (setp.cur - setp.prev) * fFrac : setp.cur;
+  #else
+  // Extrapolation: Prediction along the slope of the last two packets
+  fDT_us      = fDT_us < RC_SETP_HORIZON_MS * 1000.f ? fDT_us : RC_SETP_HORIZON_MS * 1000.f;
+  float fVal  = setp.cur + (setp.cur - setp.prev) * m_fInvPeriod * fDT_us;
+  #endif
+
+  setp.out += RC_SETP_SMOOTH_f * (fVal - setp.out);
+  return setp.out;
+#endif
 }
 
 int_fast32_t Receiver::get_channel(uint_fast8_t index) const {
@@ -155,6 +447,28 @@ GPSPosition *Receiver::get_waypoint() {
   return &m_Waypoint;
 }
 
+const Mission *Receiver::get_mission() const {
+  return &m_Mission;
+}
+
+const Geofence *Receiver::get_fence() const {
+  return &m_Fence;
+}
+
+bool Receiver::advance_mission() {
+  if(!m_Mission.advance() ) {
+    return false;
+  }
+  const MissionItem *pTarget = m_Mission.get_target();
+  m_Waypoint.latitude  = pTarget->latitude;
+  m_Waypoint.longitude = pTarget->longitude;
+  // The altitude of the hold mode stays
+  if(!chk_fset(m_Waypoint.mode, GPSPosition::HLD_ALTITUDE_F) ) {
+    m_Waypoint.altitude_cm = pTarget->altitude_cm;
+  }
+  return true;
+}
+
 uint_fast32_t Receiver::last_parse_t32() {
   m_iSParseTime = m_pHalBoard->m_pHAL->scheduler->millis() - m_iSParseTimer;
 
@@ -180,6 +494,22 @@ uint_fast32_t Receiver::last_rcin_t32() {
   return m_iPPMTime;
 }
 
+uint_fast16_t Receiver::get_radio_lost() const {
+  return m_iRadioLost;
+}
+
+uint_fast16_t Receiver::get_radio_fixed() const {
+  return m_iRadioFixed;
+}
+
+uint8_t Receiver::get_radio_aux() const {
+  return m_iRadioAux;
+}
+
+uint8_t Receiver::get_radio_mode() const {
+  return m_iRadioMode;
+}
+
 // remote control stuff
 bool Receiver::parse_ctrl_com(char* buffer) {
   if(m_rgChannelsRC == NULL) {
@@ -196,6 +526,7 @@ bool Receiver::parse_ctrl_com(char* buffer) {
       char *ch = strtok(NULL, ",");
       m_rgChannelsRC[i] = strtol(ch, NULL, 10);
     }
+    update_setpoints();
     m_iSParseTimer = m_pHalBoard->m_pHAL->scheduler->millis(); // update last valid packet
   }
   return true;
@@ -242,60 +573,116 @@ bool Receiver::parse_gyr_cor(char* buffer) {
   return bRet;
 }
 
+// UAV#lat,lon,alt,flag*chk: Single way point (replaces the mission)
+// UAV#lat,lon,alt,flag,idx,cnt*chk: Item idx of a mission with cnt way points (incremental upload)
 bool Receiver::parse_waypoint(char *buffer) {
-  char *str = strtok(buffer, "*");                  // str = roll, pit, thr, yaw
+  char *str = strtok(buffer, "*");                  // str = lat, lon, alt, flag[, idx, cnt]
   char *chk = strtok(NULL, "*");                    // chk = chksum
-  bool bRet = false;
+  uint_fast8_t iArgs = 0;
 
   int_fast32_t lat           = 0;
   int_fast32_t lon           = 0;
   int_fast32_t alt_cm        = 0;
   GPSPosition::UAV_TYPE flag = GPSPosition::NOTHING_F;
+  uint_fast8_t idx           = 0;
+  uint_fast8_t cnt           = 1;
 
-  if(verf_chksum(str, chk) ) {                      // if chksum OK
-    char *cstr;
+  if(!verf_chksum(str, chk) ) {                     // if chksum not OK
+    return false;
+  }
 
-    for(uint_fast8_t i = 0; i < GPSP_ARGS; i++) {   // loop through final 3 RC_CHANNELS
-      if(i == 0) {
-        cstr = strtok (buffer, ",");
-      } else {
-        cstr = strtok (NULL, ",");
-      }
+  for(char *cstr = strtok(buffer, ","); cstr != NULL && iArgs < MISN_ARGS; cstr = strtok(NULL, ","), iArgs++) {
+    switch(iArgs) {
+      case 0:
+        lat    = atol(cstr);
+        break;
+      case 1:
+        lon    = atol(cstr);
+        break;
+      case 2:
+        alt_cm = atol(cstr);
+        break;
+      case 3:
+        flag   = static_cast<GPSPosition::UAV_TYPE>(atoi(cstr) );
+        break;
+      case 4:
+        idx    = atoi(cstr);
+        break;
+      case 5:
+        cnt    = atoi(cstr);
+        break;
+    }
+  }
+  if(iArgs != GPSP_ARGS && iArgs != MISN_ARGS) {
+    return false;
+  }
 
-      switch(i) {
-        case 0:
-          lat    = atol(cstr);
-          break;
-        case 1:
-          lon    = atol(cstr);
-          break;
-        case 2:
-          alt_cm = atol(cstr);
-          break;
-        case 3:
-          // Parse the type flag
-          flag = static_cast<GPSPosition::UAV_TYPE>(atoi(cstr) );
-          // Override the height if the flag is HLD_ALTITUDE_F
-          if(flag == GPSPosition::HLD_ALTITUDE_F) {
-            bool bOK = false;
-            // Measure the current height
-            alt_cm = Device::get_altitude_cm(m_pHalBoard, bOK);
-            // If height measurement failed, then break it
-            if(!bOK) {
-              flag = GPSPosition::NOTHING_F;
-            }
-          }
-          // Indicate everything went well
-          bRet = true;
-          break;
-      }
+  // A single way point replaces the whole mission
+  if(iArgs == GPSP_ARGS) {
+    m_Mission.clear();
+  }
+  if(!m_Mission.set_item(idx, cnt, lat, lon, alt_cm) ) {
+    return false;
+  }
+
+  // Start the mission from the current position if the navigation was off
+  if( chk_fset(flag, GPSPosition::GPS_NAVIGATN_F) &&
+     (!chk_fset(m_Waypoint.mode, GPSPosition::GPS_NAVIGATN_F) || iArgs == GPSP_ARGS) )
+  {
+    m_Mission.start(m_pHalBoard->m_pInertNav->get_latitude(), m_pHalBoard->m_pInertNav->get_longitude() );
+  }
+
+  const MissionItem *pTarget = m_Mission.get_target();
+  lat    = pTarget->latitude;
+  lon    = pTarget->longitude;
+  alt_cm = pTarget->altitude_cm;
+
+  // Override the height if the flag is HLD_ALTITUDE_F
+  if(flag == GPSPosition::HLD_ALTITUDE_F) {
+    const SensorFrame &frame = m_pHalBoard->get_frame();
+    // Measure the current height
+    alt_cm = frame.altitude_cm;
+    // If height measurement failed, then break it
+    if(!(frame.valid & SensorFrame::ALTITUDE_F) ) {
+      flag = GPSPosition::NOTHING_F;
     }
   }
-  // Set new waypoint only if the everything worked out like expected
-  if(bRet == true) {
-    m_Waypoint = GPSPosition(lat, lon, alt_cm, flag);
+
+  m_Waypoint = GPSPosition(lat, lon, alt_cm, flag);
+  return true;
+}
+
+// FNC#lat,lon,alt,idx,cnt*chk: Vertex idx of a polygon with cnt vertices and the ceiling (in cm)
+// FNC#0,0,0,0,0*chk: Removes the fence
+bool Receiver::parse_fence(char *buffer) {
+  char *str = strtok(buffer, "*");                  // str = lat, lon, alt, idx, cnt
+  char *chk = strtok(NULL, "*");                    // chk = chksum
+
+  if(!verf_chksum(str, chk) ) {                     // if chksum not OK
+    return false;
   }
-  return bRet;
+
+  int_fast32_t rgArgs[FENC_ARGS];
+  for(uint_fast8_t i = 0; i < FENC_ARGS; i++) {
+    char *cstr = strtok(i == 0 ? str : NULL, ",");
+    if(cstr == NULL) {
+      return false;
+    }
+    rgArgs[i] = atol(cstr);
+  }
+
+  if(rgArgs[4] == 0) {
+    m_Fence.clear();
+    return true;
+  }
+
+  // The first vertex defines the local frame if there is none so far
+  if(!m_Mission.get_origin().is_set() ) {
+    m_Mission.set_origin(rgArgs[0], rgArgs[1]);
+  }
+  int32_t iN_cm, iE_cm;
+  m_Mission.get_origin().to_cm(rgArgs[0], rgArgs[1], iN_cm, iE_cm);
+  return m_Fence.set_vertex(rgArgs[3], rgArgs[4], iN_cm, iE_cm, rgArgs[2]);
 }
 
 bool Receiver::parse_gyr_cal(char* buffer) {
@@ -304,6 +691,8 @@ bool Receiver::parse_gyr_cal(char* buffer) {
     return false;
   } else if (m_rgChannelsRC[2] > RC_THR_ACRO) {
     return false;
+  } else if (!m_pHalBoard->is_initialized(Device::INIT_INERTIAL_F) ) {  // Still booting
+    return false;
   }
   // process cmd
   char *str = strtok(buffer, "*");                  // str = roll, pit, thr, yaw
@@ -324,6 +713,7 @@ bool Receiver::parse_gyr_cal(char* buffer) {
 
 /*
  * Changes the sensor type used for the battery monitor
+ * str = "type[, nr. of cells] * checksum"; Zero cells: Detection from the initial voltage
  */
 bool Receiver::parse_bat_type(char* buffer) {
   if(m_pHalBoard == NULL) {
@@ -334,12 +724,56 @@ bool Receiver::parse_bat_type(char* buffer) {
   char *chk = strtok(NULL, "*");                  // chk = chksum
 
   if(verf_chksum(str, chk) ) {                    // if chksum OK
-    int type = atoi(str);
+    int type = atoi(strtok(str, ",") );
     m_pHalBoard->m_pBat->setup_source(type);
+
+    // The estimation restarts with a new nr. of cells: Not while the motors run
+    char *cells = strtok(NULL, ",");
+    if(cells != NULL && m_rgChannelsRC[RC_THR] <= RC_THR_ACRO) {
+      int iCells = atoi(cells);
+      if(in_range(0, BATT_CELLS_MAX, iCells) ) {
+        m_pHalBoard->m_pBat->set_cells_cfg(iCells);
+      }
+    }
   }
   return true;
 }
 
+/*
+ * Expo and super rate of the sticks in percent
+ * str = "expo roll/pitch, super rate roll/pitch, expo yaw, super rate yaw * checksum"
+ */
+bool Receiver::parse_expo_conf(char* buffer) {
+  // process cmd
+  char *str = strtok(buffer, "*");                  // str
+  char *chk = strtok(NULL, "*");                    // chk = chksum
+
+  if(!verf_chksum(str, chk) ) {
+    return false;
+  }
+
+  int_fast16_t rgArgs[EXPO_ARGS];
+  for(uint_fast8_t i = 0; i < EXPO_ARGS; i++) {
+    char *cstr = strtok(i == 0 ? str : NULL, ",");
+    if(cstr == NULL) {
+      return false;
+    }
+    rgArgs[i] = atoi(cstr);
+    if(!in_range(0, 100, rgArgs[i]) ) {
+      return false;
+    }
+  }
+
+  set_expo(0, rgArgs[0], rgArgs[1]);
+  set_expo(1, rgArgs[2], rgArgs[3]);
+  return true;
+}
+
+/*
+ * Groups separated by ';': Rate PIDs of pitch, roll, yaw, throttle and acceleration (kP,kI,kD,imax),
+ * kP of the stabilize PIDs (pitch,roll,yaw,throttle,acceleration)
+ * and optionally the navigation (kP,kI,kD,imax of PID_NAV_RATE, kP of PID_NAV_STAB)
+ */
 bool Receiver::parse_pid_conf(char* buffer) {
   if(m_pHalBoard == NULL) {
     return false;
@@ -360,47 +794,40 @@ bool Receiver::parse_pid_conf(char* buffer) {
       if(i == 0)
         cstr = strtok (buffer, ";");
       else cstr = strtok (NULL, ";");
+      // The navigation group is optional: Older senders only transmit the first PID_ARGS - 1 groups
+      if(cstr == NULL) {
+        break;
+      }
 
       float *pids = parse_pid_substr(cstr);
       switch(i) {
       case 0:
-        m_pHalBoard->get_pid(PID_PIT_RATE).kP(pids[0]);
-        m_pHalBoard->get_pid(PID_PIT_RATE).kI(pids[1]);
-        m_pHalBoard->get_pid(PID_PIT_RATE).kD(pids[2]);
-        m_pHalBoard->get_pid(PID_PIT_RATE).imax(pids[3]);
+        set_rate_pid(m_pHalBoard, PID_PIT_RATE, pids);
         break;
       case 1:
-        m_pHalBoard->get_pid(PID_ROL_RATE).kP(pids[0]);
-        m_pHalBoard->get_pid(PID_ROL_RATE).kI(pids[1]);
-        m_pHalBoard->get_pid(PID_ROL_RATE).kD(pids[2]);
-        m_pHalBoard->get_pid(PID_ROL_RATE).imax(pids[3]);
+        set_rate_pid(m_pHalBoard, PID_ROL_RATE, pids);
         break;
       case 2:
-        m_pHalBoard->get_pid(PID_YAW_RATE).kP(pids[0]);
-        m_pHalBoard->get_pid(PID_YAW_RATE).kI(pids[1]);
-        m_pHalBoard->get_pid(PID_YAW_RATE).kD(pids[2]);
-        m_pHalBoard->get_pid(PID_YAW_RATE).imax(pids[3]);
+        set_rate_pid(m_pHalBoard, PID_YAW_RATE, pids);
         break;
       case 3:
-        m_pHalBoard->get_pid(PID_THR_RATE).kP(pids[0]);
-        m_pHalBoard->get_pid(PID_THR_RATE).kI(pids[1]);
-        m_pHalBoard->get_pid(PID_THR_RATE).kD(pids[2]);
-        m_pHalBoard->get_pid(PID_THR_RATE).imax(pids[3]);
+        set_rate_pid(m_pHalBoard, PID_THR_RATE, pids);
         break;
       case 4:
-        m_pHalBoard->get_pid(PID_ACC_RATE).kP(pids[0]);
-        m_pHalBoard->get_pid(PID_ACC_RATE).kI(pids[1]);
-        m_pHalBoard->get_pid(PID_ACC_RATE).kD(pids[2]);
-        m_pHalBoard->get_pid(PID_ACC_RATE).imax(pids[3]);
+        set_rate_pid(m_pHalBoard, PID_ACC_RATE, pids);
         break;
       case 5:
-        m_pHalBoard->get_pid(PID_PIT_STAB).kP(pids[0]);
-        m_pHalBoard->get_pid(PID_ROL_STAB).kP(pids[1]);
-        m_pHalBoard->get_pid(PID_YAW_STAB).kP(pids[2]);
-        m_pHalBoard->get_pid(PID_THR_STAB).kP(pids[3]);
-        m_pHalBoard->get_pid(PID_ACC_STAB).kP(pids[4]);
+        set_stab_pid(m_pHalBoard, PID_PIT_STAB, pids[0]);
+        set_stab_pid(m_pHalBoard, PID_ROL_STAB, pids[1]);
+        set_stab_pid(m_pHalBoard, PID_YAW_STAB, pids[2]);
+        set_stab_pid(m_pHalBoard, PID_THR_STAB, pids[3]);
+        set_stab_pid(m_pHalBoard, PID_ACC_STAB, pids[4]);
         bRet = true;
         break;
+      case 6:
+        set_rate_pid(m_pHalBoard, PID_NAV_RATE, pids);
+        set_stab_pid(m_pHalBoard, PID_NAV_STAB, pids[4]);
+        break;
       }
     }
   }
@@ -429,6 +856,47 @@ bool Receiver::parse_radio(char *buffer) {
   if(checksum != chk) {
     return false;
   }
+  return set_radio(rol, pit, thr, yaw);
+}
+
+/*
+ * Bit-packed radio frame v2 (LSB first):
+ * Bit 0-9 throttle (us above RC_THR_OFF), 10-17 pitch, 18-25 roll, 26-35 yaw (RADIO_V2_DEG_SCALE steps per degree, centered in the field),
+ * 36-39 aux switches, 40-41 mode, 42-47 sequence number; Followed by the CRC-8 of the payload.
+ * The angles are used in whole degrees, so half a degree steps lose nothing (+/- 64 deg pitch and roll, +/- 256 deg yaw).
+ * Other frame types would be told apart by their length.
+ */
+bool Receiver::parse_radio_v2(const uint8_t *pFrame) {
+  if(crc8(pFrame, RADIO_V2_PAYLOAD) != pFrame[RADIO_V2_PAYLOAD]) {
+    return false;
+  }
+  // A frame with check bytes is found twice if its first check byte is zero (see read_radio_v2() )
+  uint_fast8_t iSeq  = get_bits(pFrame, 42, RADIO_V2_SEQ_BITS);
+  bool         bLink = m_pHalBoard->m_pHAL->scheduler->millis() - m_t32RadioV2 < COM_PKT_TIMEOUT;
+  if(bLink && iSeq == m_iRadioSeq) {
+    return false;
+  }
+
+  int_fast16_t thr = RC_THR_OFF + get_bits(pFrame, 0, 10);
+  int_fast16_t pit = radio_v2_deg(get_bits(pFrame, 10, 8), 8);
+  int_fast16_t rol = radio_v2_deg(get_bits(pFrame, 18, 8), 8);
+  int_fast16_t yaw = radio_v2_deg(get_bits(pFrame, 26, 10), 10);
+  if(!set_radio(rol, pit, thr, yaw) ) {
+    return false;
+  }
+
+  // Frames lost since the last valid one; Not counted over a break of the link (the sequence number does not wrap within COM_PKT_TIMEOUT)
+  if(bLink) {
+    m_iRadioLost += (iSeq - m_iRadioSeq - 1) & ( (1 << RADIO_V2_SEQ_BITS) - 1);
+  }
+  m_iRadioSeq   = iSeq;
+  m_iRadioAux   = get_bits(pFrame, 36, 4);
+  m_iRadioMode  = get_bits(pFrame, 40, 2);
+  m_t32RadioV2  = m_iSParseTimer;
+  return true;
+}
+
+bool Receiver::set_radio(int_fast16_t rol, int_fast16_t pit, int_fast16_t thr, int_fast16_t yaw) {
   // Small validity check
   if(!check_input(rol, pit, thr, yaw) ) {
     return false;
@@ -439,6 +907,7 @@ bool Receiver::parse_radio(char *buffer) {
   m_rgChannelsRC[RC_PIT] = pit;
   m_rgChannelsRC[RC_THR] = thr;
   m_rgChannelsRC[RC_YAW] = yaw;
+  update_setpoints();
 
   m_iSParseTimer = m_pHalBoard->m_pHAL->scheduler->millis();           // update last valid packet
   return true;
@@ -471,9 +940,15 @@ bool Receiver::parse(char *buffer) {
   if(strcmp(ctype, "BAT") == 0) {
     return parse_bat_type(command);
   }
+  if(strcmp(ctype, "EXP") == 0) {
+    return parse_expo_conf(command);
+  }
   if(strcmp(ctype, "UAV") == 0) {
     return parse_waypoint(command);
   }
+  if(strcmp(ctype, "FNC") == 0) {
+    return parse_fence(command);
+  }
 
   return false;
 }
@@ -484,6 +959,16 @@ bool Receiver::read_uartA(uint_fast16_t bytesAvail) {
   bool bRet = false;
   for(; bytesAvail > 0; bytesAvail--) {
     char c = static_cast<char>(m_pHalBoard->m_pHAL->console->read() );// read next byte
+    #if USE_MAVLINK
+    if(read_mavlink(MAVLINK_COMM_0, static_cast<uint8_t>(c) ) ) {
+      m_iSParseTimer_A = m_iSParseTimer;
+      bRet = true;
+    }
+    if(m_pMAVCom->is_active(MAVLINK_COMM_0) ) {
+      offset = 0;
+      continue;
+    }
+    #endif
     if(c == '\n' /*|| c == 'z'*/) {                     // new line or special termination signature (z): Process cmd
       m_cBuffer[offset] = '\0';                         // null terminator
       bRet = parse(m_cBuffer);
@@ -500,30 +985,112 @@ bool Receiver::read_uartA(uint_fast16_t bytesAvail) {
   return bRet;
 }
 
+#if USE_MAVLINK
+bool Receiver::read_mavlink(mavlink_channel_t chan, uint8_t c) {
+  const mavlink_message_t *pMsg = m_pMAVCom->parse(chan, c, m_rgChannelsRC[RC_THR] > RC_THR_OFF);
+  if(pMsg == NULL || pMsg->msgid != MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE) {
+    return false;
+  }
+
+  mavlink_rc_channels_override_t rc;
+  mavlink_msg_rc_channels_override_decode(pMsg, &rc);
+  if(rc.target_system != MAV_SYSTEM_ID) {
+    return false;
+  }
+  // Channel 1-4: roll, pitch, throttle and yaw
+  // Released channels (0 or UINT16_MAX) fail the range check of set_radio()
+  return set_radio(mav_pwm_to_deg(rc.chan1_raw, RC_ROL_MAX),
+                   mav_pwm_to_deg(rc.chan2_raw, RC_PIT_MAX),
+                   rc.chan3_raw,
+                   mav_pwm_to_deg(rc.chan4_raw, RC_YAW_MAX) );
+}
+#endif
+
+/*
+ * Frame v2: COBS encoded payload and CRC-8, followed by the zero delimiter.
+ * With RADIO_V2_FEC two Reed-Solomon check bytes over the encoded bytes are inserted before the delimiter,
+ * so the correction comes before the COBS decoding: A corrupted code byte or a byte flipped to zero is correctable.
+ * Zeros inside of such a frame (corrupted or check bytes) end the frame early. So at each zero the last RADIO_V2_FEC_LEN bytes
+ * are tried as a frame with check bytes, and if no zero follows a complete one, its corrupted delimiter is assumed.
+ */
+bool Receiver::read_radio_v2(uint8_t c) {
+  bool bDelim = c == 0;
+#if RADIO_V2_FEC
+  bDelim = bDelim || m_iRadioV2Offs == RADIO_V2_FEC_LEN;
+#endif
+
+  bool bRet = false;
+  if(bDelim) {
+    uint8_t rgFrame[RADIO_V2_LEN - 1];
+    if(c == 0 && m_iRadioV2Offs == RADIO_V2_LEN) {
+      bRet = cobs_decode(&m_rgRadioV2[RADIO_V2_FEC_LEN - RADIO_V2_LEN], RADIO_V2_LEN, rgFrame) && parse_radio_v2(rgFrame);
+    }
+#if RADIO_V2_FEC
+    if(!bRet) {
+      uint8_t rgBlock[RADIO_V2_FEC_LEN];
+      memcpy(rgBlock, m_rgRadioV2, RADIO_V2_FEC_LEN);
+      int_fast8_t iFixed = rs2_correct(rgBlock, RADIO_V2_FEC_LEN);
+      // The CRC-8 in parse_radio_v2() rejects wrong corrections of frames with more errors
+      if(iFixed >= 0 && cobs_decode(rgBlock, RADIO_V2_LEN, rgFrame) && parse_radio_v2(rgFrame) ) {
+        m_iRadioFixed += iFixed;
+        bRet = true;
+      }
+    }
+#endif
+    m_iRadioV2Offs = 0;
+  } else {
+    m_iRadioV2Offs += m_iRadioV2Offs < RADIO_V2_FEC_LEN ? 1 : 0;
+  }
+
+  // Zeros are kept as well: They may be part of the next frame with check bytes
+  memmove(m_rgRadioV2, &m_rgRadioV2[1], RADIO_V2_FEC_LEN - 1);
+  m_rgRadioV2[RADIO_V2_FEC_LEN - 1] = c;
+  return bRet;
+}
+
 bool Receiver::read_uartC(uint_fast16_t bytesAvail) {
   static uint_fast16_t offset = 0;
 
+  // Both frame versions are decoded until frames v2 arrive
+  bool bV1 = m_pHalBoard->m_pHAL->scheduler->millis() - m_t32RadioV2 >= RADIO_V2_LOCK_MS;
   bool bRet = false;
   for(; bytesAvail > 0; bytesAvail--) {
-    // command must be exactly 8 bytes long
+    char c = static_cast<char>(m_pHalBoard->m_pHAL->uartC->read() );        // read next byte
+
+    #if USE_MAVLINK
+    if(read_mavlink(MAVLINK_COMM_1, static_cast<uint8_t>(c) ) ) {
+      m_iSParseTimer_C = m_iSParseTimer;
+      bRet = true;
+    }
+    if(m_pMAVCom->is_active(MAVLINK_COMM_1) ) {
+      m_iRadioV2Offs = 0;
+      offset = 0;
+      continue;
+    }
+    #endif
+
+    // Frame v2: zero delimited
+    if(read_radio_v2(static_cast<uint8_t>(c) ) ) {
+      m_iSParseTimer_C = m_iSParseTimer;
+      bRet = true;
+      bV1  = false;
+    }
+    if(!bV1) {
+      offset = 0;
+      continue;
+    }
+
+    // Frame v1: command must be exactly 8 bytes long
     if(offset > RADIO_MAX_OFFS) {                             // if message is longer than it should be
       memset(m_cBuffer, 0, sizeof(m_cBuffer) ); offset = 0;   // reset everything
-      return false;                                           // and break loop
     }
-    char c = static_cast<char>(m_pHalBoard->m_pHAL->uartC->read() );        // read next byte
     if(c == static_cast<char>(254) ) {                                      // this control char is not used for any other symbol
       m_cBuffer[offset] = '\0';                               // null terminator at 8th position
-      if(offset != RADIO_MAX_OFFS) {                          // theoretically a broken message can still be shorter than it should be
-        memset(m_cBuffer, 0, sizeof(m_cBuffer) ); offset = 0; //so break here if something was wrong
-        return false;
-      }
-      else {                                                  // message has perfect length and stop byte
-        bRet = parse_radio(m_cBuffer);
-        if(bRet) {
-          m_iSParseTimer_C = m_iSParseTimer;
-        }
-        memset(m_cBuffer, 0, sizeof(m_cBuffer) ); offset = 0;
+      if(offset == RADIO_MAX_OFFS && parse_radio(m_cBuffer) ) {   // message has perfect length, stop byte and checksum
+        m_iSParseTimer_C = m_iSParseTimer;
+        bRet = true;
       }
+      memset(m_cBuffer, 0, sizeof(m_cBuffer) ); offset = 0;
     }
     else if(offset < sizeof(m_cBuffer)-1) {
       m_cBuffer[offset++] = c;                                // store in buffer and continue until newline
@@ -600,6 +1167,7 @@ bool Receiver::read_rcin() {
   m_rgChannelsRC[RC_PIT] = pit;
   m_rgChannelsRC[RC_ROL] = rol;
   m_rgChannelsRC[RC_YAW] = yaw;
+  update_setpoints();
   
   // Update timers
   m_iSParseTimer = m_iPPMTimer = m_pHalBoard->m_pHAL->scheduler->millis();           // update last valid packet
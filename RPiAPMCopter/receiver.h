@@ -10,19 +10,36 @@
 #include "config.h"
 #include "absdevice.h"
 #include "containers.h"
+#include "mission.h"
+#include "fence.h"
+#if USE_MAVLINK
+#include "mavcom.h"
+#endif
 
 
 class Device;
 class RC_Channel;
+class MAVCom;
+
 
+// Set point of one stick between two RC packets
+struct RCSetpoint {
+  float         prev;                           // Value of the previous packet
+  float         cur;                            // Value of the last packet
+  float         out;                            // Last (smoothed) set point
+};
 
 class Receiver : public AbsErrorDevice {
 private /*variables*/:
   char          m_cBuffer[256];                 // Input buffer 
   int_fast32_t  m_rgChannelsRC[APM_IOCHAN_CNT]; // Eight channel remote control plus one for altitude hold (height in cm)
   GPSPosition   m_Waypoint;                     // Current position for autonomous flight
+  Mission       m_Mission;                      // Way points of the autonomous flight; The target is copied into m_Waypoint
+  Geofence      m_Fence;                        // Polygon and ceiling in the local frame of the mission
+  bool          m_bArmed;                       // Throttle above RC_THR_OFF: The navigation origin is set on arming
   
   Device       *m_pHalBoard;                    // Device module pointer
+  MAVCom       *m_pMAVCom;                      // MAVLink mode of uartA and uartC; NULL without USE_MAVLINK
   
   // Channels for the ppm radio
   RC_Channel   *m_pRCPit;
@@ -39,24 +56,81 @@ private /*variables*/:
   uint_fast32_t m_iSParseTime_A;                // Last successful read time of command string from wifi
   uint_fast32_t m_iSParseTime_C;                // Last successful read time of command string from radio
   uint_fast32_t m_iPPMTime;
+
+  // Radio frame v2 (zero delimited, COBS encoded, CRC-8)
+  uint8_t       m_rgRadioV2[RADIO_V2_FEC_LEN];  // The last received bytes (including zeros), the newest at the end
+  uint_fast8_t  m_iRadioV2Offs;                 // Bytes since the last delimiter (saturates at the buffer size)
+  uint_fast8_t  m_iRadioSeq;                    // Sequence number of the last frame
+  uint_fast16_t m_iRadioLost;                   // Frames missing in the sequence (only counted while the link is up)
+  uint_fast16_t m_iRadioFixed;                  // Frames with a corrected byte (RADIO_V2_FEC)
+  uint8_t       m_iRadioAux;                    // Aux switches (4 bits)
+  uint8_t       m_iRadioMode;                   // Mode bits (2 bits)
+  uint_fast32_t m_t32RadioV2;                   // Last valid frame v2 (in ms)
+  uint_fast32_t m_t32FenceOut;                  // Last check outside of the fence (in ms)
+
+  // Continuous set points for roll, pitch, throttle and yaw
+  RCSetpoint    m_rgSetpoints[RC_SETP_CNT];
+  uint32_t      m_t32Packet;                    // Arrival of the last RC packet (in us)
+  float         m_fInvPeriod;                   // 1 / time between the last two packets (in 1/us); Zero if the packets were too far apart
+
+  void    update_setpoints();                   // Must be called after each valid RC packet
+  bool    set_radio(int_fast16_t iRol, int_fast16_t iPit, int_fast16_t iThr, int_fast16_t iYaw); // Checks and applies the sticks of a radio frame
+  bool    read_radio_v2(uint8_t c);             // Collects the bytes of a frame v2 and parses it at the delimiter
+#if USE_MAVLINK
+  bool    read_mavlink(mavlink_channel_t chan, uint8_t c); // True for a valid RC_CHANNELS_OVERRIDE
+#endif
+  void    set_nav_origin(int32_t iLat, int32_t iLon); // Moves the local frame of the mission and the geofence
+
+  // Expo and super rate curves of the sticks: Index 0 for roll and pitch, 1 for yaw
+  int16_t       m_rgExpoLUT[RC_EXPO_AXES][RC_EXPO_LUT_S];  // Positive half of the curve; RC_EXPO_ONE is the full deflection
+  uint8_t       m_rgExpo[RC_EXPO_AXES];         // in percent
+  uint8_t       m_rgSuper[RC_EXPO_AXES];        // in percent
+
+  void    calc_expo_lut(uint_fast8_t iAxis);    // Regenerates the table (floating point, so only if the parameters change)
+  int_fast32_t apply_expo(uint_fast8_t iChannel, int_fast32_t iVal) const;  // Integer lookup with linear interpolation
   
 protected /*functions*/:
   bool    parse_ctrl_com  (char *);
   bool    parse_radio     (char *);             // Very compact to fit into 8 bytes, stop byte and checksum byte inclusive
+  bool    parse_radio_v2  (const uint8_t *);    // Bit-packed frame v2 after the COBS decoding: RADIO_V2_PAYLOAD bytes and the CRC-8
   bool    parse_gyr_cor   (char *);
   bool    parse_gyr_cal   (char *);
   bool    parse_bat_type  (char *);
   bool    parse_pid_conf  (char *);
+  bool    parse_expo_conf (char *);
   bool    parse_waypoint  (char *);
+  bool    parse_fence     (char *);
   bool    parse           (char *);             // Switch for all the different kind of commands to parse
   
 public /*functions*/:
-  Receiver(Device *);
+  Receiver(Device *, MAVCom *);
 
   void          set_channel(uint_fast8_t, int_fast32_t);
   int_fast32_t  get_channel(uint_fast8_t) const;
   int_fast32_t *get_channels();
   GPSPosition  *get_waypoint();
+  const Mission *get_mission() const;
+  bool          advance_mission();              // Next way point into m_Waypoint; False if the mission is complete
+  const Geofence *get_fence() const;
+
+  /*
+   * Must be called at the navigation rate (INAV_T_MS):
+   * Raises GEOFENCE_F while the armed model is outside of the polygon or above the ceiling.
+   */
+  void          update_fence();
+
+  /*
+   * Set point of a stick at the time t32Now_us (e.g. the time stamp of the sensor frame).
+   * Depending on RC_SETP_MODE interpolated between the last two packets (delayed by one packet)
+   * or extrapolated from them (limited to RC_SETP_HORIZON_MS) and low pass filtered.
+   * Overrides by set_channel() and a throttle at RC_THR_OFF are applied immediately.
+   */
+  float         get_setpoint(uint_fast8_t, uint32_t t32Now_us);
+
+  // Expo (0-100 %) and super rate (0-RC_SUPER_MAX %) of the stick curves
+  void          set_expo(uint_fast8_t iAxis, uint8_t iExpo, uint8_t iSuper);
+  uint8_t       get_expo(uint_fast8_t iAxis) const;
+  uint8_t       get_super(uint_fast8_t iAxis) const;
   
   // time since last command string was parsed successfully from:
   uint_fast32_t last_parse_t32();                     // general
@@ -64,6 +138,12 @@ public /*functions*/:
   uint_fast32_t last_parse_uartC_t32();               // UART C
   uint_fast32_t last_rcin_t32();                      // PPM input (radio)
 
+  // Frame v2 of the radio
+  uint_fast16_t get_radio_lost() const;               // Frames missing in the sequence
+  uint_fast16_t get_radio_fixed() const;              // Frames with a corrected byte
+  uint8_t       get_radio_aux() const;                // Aux switches
+  uint8_t       get_radio_mode() const;               // Mode bits
+
   // Read from serial bus
   bool          read_uartA(uint_fast16_t bytesAvail); // console in APM 2
   bool          read_uartC(uint_fast16_t bytesAvail); // radio in APM 2
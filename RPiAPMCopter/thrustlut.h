@@ -0,0 +1,25 @@
+#ifndef THRUSTLUT_h
+#define THRUSTLUT_h
+
+#include <stdint.h>
+
+#include "config.h"
+
+
+///////////////////////////////////////////////////////////
+// Generated by misc/thrust_stand/ThrustFit.py
+// Pulse width (us) of each motor for equally spaced thrust steps,
+// from zero thrust to the highest thrust all motors can produce.
+// Rows are indexed by the output channel (MOTOR_FR, MOTOR_BL, ..).
+// Default: Linear curves (no thrust stand data)
+///////////////////////////////////////////////////////////
+#define THRUST_LUT_SEGS      16
+
+static const uint16_t THRUST_LUT[MOTOR_CNT][THRUST_LUT_SEGS + 1] = {
+  { 1000, 1062, 1125, 1187, 1250, 1312, 1375, 1437, 1500, 1562, 1625, 1687, 1750, 1812, 1875, 1937, 2000 }, // MOTOR_FR
+  { 1000, 1062, 1125, 1187, 1250, 1312, 1375, 1437, 1500, 1562, 1625, 1687, 1750, 1812, 1875, 1937, 2000 }, // MOTOR_BL
+  { 1000, 1062, 1125, 1187, 1250, 1312, 1375, 1437, 1500, 1562, 1625, 1687, 1750, 1812, 1875, 1937, 2000 }, // MOTOR_FL
+  { 1000, 1062, 1125, 1187, 1250, 1312, 1375, 1437, 1500, 1562, 1625, 1687, 1750, 1812, 1875, 1937, 2000 }  // MOTOR_BR
+};
+
+#endif /*THRUSTLUT_h*/
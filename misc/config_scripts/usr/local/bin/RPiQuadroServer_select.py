@@ -86,8 +86,16 @@ def make_command(p):
   # Add a waypoint
   if type == 'uav':
     com = "%d,%d,%d,%d" % (p['lat_d'], p['lon_d'], p['alt_m'], p['flag_t'] )
+    # Mission item: index and length of the mission
+    if 'idx' in p and 'cnt' in p:
+      com += ",%d,%d" % (p['idx'], p['cnt'] )
     send_command("UAV#", com)
 
+  # Geofence vertex: index and number of vertices (cnt = 0 removes the fence), ceiling in cm
+  if type == 'fnc':
+    com = "%d,%d,%d,%d,%d" % (p['lat_d'], p['lon_d'], p['alt_cm'], p['idx'], p['cnt'] )
+    send_command("FNC#", com)
+
   # PID config is about to change the sensitivity of the model to changes in attitude
   if type == 'pid':
     com = "%.2f,%.2f,%.4f,%.2f;%.2f,%.2f,%.4f,%.2f;%.2f,%.2f,%.4f,%.2f;%.2f,%.2f,%.4f,%.2f;%.2f,%.2f,%.4f,%.2f;%.2f,%.2f,%.2f,%.2f,%.2f" % (
@@ -0,0 +1,148 @@
+/*
+ * Host benchmark of PIDCtrl (RPiAPMCopter/controller.cpp) against the ArduPilot PID class
+ * The ATmega2560 has no FPU: Every float operation is a call into the soft float library,
+ * so the float operations per call decide the run time on the board.
+ * Both controllers are compiled with a float type which counts its operations.
+ * The cycles per call on the board are printed by the firmware with BENCH_OUT.
+ *
+ * Build and run from this directory:
+ * g++ -std=gnu++98 -Wall -Istubs -I../../RPiAPMCopter PIDBench.cpp -o PIDBench
+ * ./PIDBench
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+enum OPS { OP_ADD = 0, OP_MUL, OP_DIV, OP_CMP, OP_CONV, OP_SQRT, OP_CNT };
+static const char *OP_NAMES[OP_CNT] = { "add/sub", "mul", "div", "compare", "int->float", "sqrt" };
+static unsigned long rgOps[OP_CNT];
+
+// Float which counts the operations of the soft float library
+struct CFloat {
+  float v;
+
+  CFloat() : v(0.f) {}
+  CFloat(float f) : v(f) {}
+  CFloat(double d) : v(static_cast<float>(d) ) {}       // Constants are folded by the compiler
+  CFloat(int i) : v(static_cast<float>(i) ) { rgOps[OP_CONV]++; }
+  CFloat(unsigned i) : v(static_cast<float>(i) ) { rgOps[OP_CONV]++; }
+  CFloat(long i) : v(static_cast<float>(i) ) { rgOps[OP_CONV]++; }
+  CFloat(unsigned long i) : v(static_cast<float>(i) ) { rgOps[OP_CONV]++; }
+
+  CFloat &operator+=(const CFloat &o) { rgOps[OP_ADD]++; v += o.v; return *this; }
+  CFloat &operator-=(const CFloat &o) { rgOps[OP_ADD]++; v -= o.v; return *this; }
+  CFloat &operator*=(const CFloat &o) { rgOps[OP_MUL]++; v *= o.v; return *this; }
+  CFloat operator-() const { return CFloat(-v); }       // Sign bit only
+};
+
+inline CFloat operator+(const CFloat &a, const CFloat &b) { rgOps[OP_ADD]++; return CFloat(a.v + b.v); }
+inline CFloat operator-(const CFloat &a, const CFloat &b) { rgOps[OP_ADD]++; return CFloat(a.v - b.v); }
+inline CFloat operator*(const CFloat &a, const CFloat &b) { rgOps[OP_MUL]++; return CFloat(a.v * b.v); }
+inline CFloat operator/(const CFloat &a, const CFloat &b) { rgOps[OP_DIV]++; return CFloat(a.v / b.v); }
+inline bool operator<(const CFloat &a, const CFloat &b)   { rgOps[OP_CMP]++; return a.v < b.v; }
+inline bool operator>(const CFloat &a, const CFloat &b)   { rgOps[OP_CMP]++; return a.v > b.v; }
+inline bool operator<=(const CFloat &a, const CFloat &b)  { rgOps[OP_CMP]++; return a.v <= b.v; }
+inline bool operator>=(const CFloat &a, const CFloat &b)  { rgOps[OP_CMP]++; return a.v >= b.v; }
+inline bool operator!=(const CFloat &a, const CFloat &b)  { rgOps[OP_CMP]++; return a.v != b.v; }
+inline bool isnan(const CFloat &a)                        { rgOps[OP_CMP]++; return a.v != a.v; }
+inline CFloat fabs(const CFloat &a)                       { return CFloat(a.v < 0.f ? -a.v : a.v); } // Sign bit only
+inline CFloat fabsf(const CFloat &a)                      { return fabs(a); }
+inline CFloat sqrt(const CFloat &a)                       { rgOps[OP_SQRT]++; return CFloat(sqrtf(a.v) ); }
+
+#define float CFloat
+#include "controller.cpp"
+
+/*
+ * ArduPilot PID::get_pid() (libraries/PID) as called by the former firmware:
+ * Time step from millis(), derivative low pass at 20 Hz, output scaled by the scaler
+ */
+class PID {
+private:
+  float    _kp, _ki, _kd, _imax;
+  float    _integrator, _last_error, _last_derivative;
+  uint32_t _last_t;
+
+public:
+  PID(float kp, float ki, float kd, float imax) : _kp(kp), _ki(ki), _kd(kd), _imax(imax),
+    _integrator(0.f), _last_error(0.f), _last_derivative(NAN), _last_t(0) {}
+
+  float get_pid(float error, float scaler, uint32_t tnow) {
+    uint32_t dt = tnow - _last_t;
+    float output = 0.f;
+    float delta_time;
+
+    if(_last_t == 0 || dt > 1000) {
+      dt = 0;
+      _integrator = 0.f;
+      _last_derivative = NAN;
+    }
+    _last_t = tnow;
+
+    delta_time = static_cast<int>(dt) / float(1000.0f);
+    output += error * _kp;
+
+    if(fabsf(_kd) > 0.f && dt > 0) {
+      float derivative;
+      if(isnan(_last_derivative) ) {
+        derivative = 0.f;
+        _last_derivative = 0.f;
+      } else {
+        derivative = (error - _last_error) / delta_time;
+      }
+      float RC = 1.f / (2.f * M_PI * 20.f);                 // Constant cut-off frequency: Folded by the compiler
+      derivative = _last_derivative + ( (delta_time / (RC + delta_time) ) * (derivative - _last_derivative) );
+      _last_error      = error;
+      _last_derivative = derivative;
+      output += _kd * derivative;
+    }
+
+    output *= scaler;
+
+    if(fabsf(_ki) > 0.f && dt > 0) {
+      _integrator += (error * _ki) * scaler * delta_time;
+      if(_integrator < -_imax) {
+        _integrator = -_imax;
+      } else if(_integrator > _imax) {
+        _integrator = _imax;
+      }
+      output += _integrator;
+    }
+    return output;
+  }
+};
+#undef float
+
+#define CALLS          1000
+#define STEP_MS        6
+
+static void print_ops(const char *pName) {
+  unsigned long iSum = 0;
+  printf("%-8s", pName);
+  for(int i = 0; i < OP_CNT; i++) {
+    printf(" %s %.1f,", OP_NAMES[i], static_cast<double>(rgOps[i]) / CALLS);
+    iSum += rgOps[i];
+    rgOps[i] = 0;
+  }
+  printf(" total %.1f float operations/call\n", static_cast<double>(iSum) / CALLS);
+}
+
+int main() {
+  // The default gains of the pitch rate PID of the former firmware
+  PID pidAP(0.65f, 0.35f, 0.015f, 50.f);
+  PIDCtrl pidCtrl(0.65f, 0.35f, 0.015f, 50);
+
+  for(int i = 0; i < OP_CNT; i++) {
+    rgOps[i] = 0;
+  }
+  for(uint32_t i = 0; i < CALLS; i++) {
+    pidAP.get_pid(static_cast<float>(i % 64) - 32.f, 1.f, 1 + i * STEP_MS);
+  }
+  print_ops("PID");
+
+  for(uint32_t i = 0; i < CALLS; i++) {
+    pidCtrl.get_pid(static_cast<float>(i % 64) - 32.f, STEP_MS / 1000.f, 0.f, i % 2);
+  }
+  print_ops("PIDCtrl");
+  return 0;
+}
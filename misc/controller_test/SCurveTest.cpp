@@ -0,0 +1,127 @@
+/*
+ * Host test of the jerk limited set point generator (SCurve in RPiAPMCopter/controller.cpp)
+ * Steps of different sizes with the limits of the heading, the altitude hold and the horizontal navigation,
+ * at a fixed and at a jittered time step. Each run checks:
+ * - velocity, acceleration and jerk of the set point stay within the limits,
+ *   also the velocity from the position differences and the acceleration from the velocity differences
+ * - the set point settles at the target without overshoot
+ *
+ * Build and run from this directory:
+ * g++ -std=gnu++98 -Wall -Istubs -I../../RPiAPMCopter SCurveTest.cpp ../../RPiAPMCopter/controller.cpp -o SCurveTest
+ * ./SCurveTest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <AP_Math.h>
+#include "controller.h"
+#include "arithmetics.h"
+
+#define DT_S           0.02f                                  // INAV_T_MS
+#define TOL            1.001f                                 // Rounding of the float integration
+#define SETTLE_f       0.001f                                 // Settled: Remaining error below 0.1 % of the step ..
+#define SETTLE_MIN     0.05f                                  // .. or this absolute error
+
+struct Limits {
+  const char *pName;
+  float       fVel;
+  float       fAcc;
+  float       fJerk;
+  bool        bWrap;
+};
+
+static int iFailed = 0;
+
+static void check(const bool bOK, const char *pMsg, const char *pName, const float fStep) {
+  if(bOK) {
+    return;
+  }
+  iFailed++;
+  if(iFailed <= 20) {
+    printf("FAILED: %s (%s, step %.1f)\n", pMsg, pName, fStep);
+  }
+}
+
+// Largest ratio of a quantity to its limit over all runs
+static float fMaxVel = 0.f, fMaxAcc = 0.f, fMaxJerk = 0.f, fMaxOver = 0.f;
+
+static void run_step(const Limits &lim, const float fStart, const float fStep, const bool bJitter) {
+  SCurve curve(lim.fVel, lim.fAcc, lim.fJerk, lim.bWrap);
+  curve.reset(fStart);
+  const float fTarget = lim.bWrap ? wrap180_f(fStart + fStep) : fStart + fStep;
+  const float fSettle = fabs(fStep) * SETTLE_f > SETTLE_MIN ? fabs(fStep) * SETTLE_f : SETTLE_MIN;
+
+  float fLastPos = curve.get_pos(), fLastVel = 0.f, fLastAcc = 0.f;
+  float fTravel  = 0.f;                                       // Signed distance along the step
+  float fSettled = -1.f;
+  // Cruise plus the ramps of the acceleration and the velocity with some margin
+  const float fMaxT_s = fabs(fStep) / lim.fVel + 4.f * (lim.fVel / lim.fAcc + lim.fAcc / lim.fJerk) + 10.f;
+  for(float t = 0.f; t < fMaxT_s; ) {
+    float fDT = bJitter ? DT_S * (0.5f + static_cast<float>(rand() ) / RAND_MAX) : DT_S;
+    curve.update(fTarget, fDT);
+    t += fDT;
+
+    float fDPos = lim.bWrap ? wrap180_f(curve.get_pos() - fLastPos) : curve.get_pos() - fLastPos;
+    float fVel  = fDPos / fDT;                                // What a follower of the position sees
+    float fAcc  = (curve.get_vel() - fLastVel) / fDT;
+    float fJerk = (curve.get_acc() - fLastAcc) / fDT;
+    fTravel    += fDPos;
+
+    fMaxVel  = fabs(curve.get_vel() ) / lim.fVel  > fMaxVel  ? fabs(curve.get_vel() ) / lim.fVel  : fMaxVel;
+    fMaxVel  = fabs(fVel) / lim.fVel              > fMaxVel  ? fabs(fVel) / lim.fVel              : fMaxVel;
+    fMaxAcc  = fabs(curve.get_acc() ) / lim.fAcc  > fMaxAcc  ? fabs(curve.get_acc() ) / lim.fAcc  : fMaxAcc;
+    fMaxAcc  = fabs(fAcc) / lim.fAcc              > fMaxAcc  ? fabs(fAcc) / lim.fAcc              : fMaxAcc;
+    fMaxJerk = fabs(fJerk) / lim.fJerk            > fMaxJerk ? fabs(fJerk) / lim.fJerk            : fMaxJerk;
+    check(fabs(curve.get_vel() ) <= lim.fVel * TOL && fabs(fVel) <= lim.fVel * TOL, "velocity limit", lim.pName, fStep);
+    check(fabs(curve.get_acc() ) <= lim.fAcc * TOL && fabs(fAcc) <= lim.fAcc * TOL, "acceleration limit", lim.pName, fStep);
+    check(fabs(fJerk) <= lim.fJerk * TOL, "jerk limit", lim.pName, fStep);
+
+    // Overshoot: Travelled further than the step
+    float fOver = fStep > 0.f ? fTravel - fStep : fStep - fTravel;
+    fMaxOver = fOver / fSettle > fMaxOver ? fOver / fSettle : fMaxOver;
+    check(fOver <= fSettle, "overshoot", lim.pName, fStep);
+
+    fLastPos = curve.get_pos();
+    fLastVel = curve.get_vel();
+    fLastAcc = curve.get_acc();
+    if(fSettled < 0.f && fabs(fStep - fTravel) <= fSettle && fabs(curve.get_vel() ) <= fSettle) {
+      fSettled = t;
+    }
+  }
+  check(fSettled >= 0.f, "not settled", lim.pName, fStep);
+  check(fabs(fStep - fTravel) <= fSettle, "end position", lim.pName, fStep);
+}
+
+int main() {
+  const Limits rgLimits[] = {
+    { "heading",    MAX_YAW,         YAW_ACC_MAX,      YAW_JERK_MAX,       true  },
+    { "altitude",   ALT_VEL_MAX_CMS, ALT_ACC_MAX_CMSS, ALT_JERK_MAX_CMSSS, false },
+    { "horizontal", NAV_VEL_MAX_CMS, NAV_ACC_MAX_CMSS, NAV_JERK_MAX_CMSSS, false }
+  };
+  const float rgSteps[]  = { 0.5f, 2.f, 10.f, 45.f, 90.f, 179.f, 500.f, 2000.f, 20000.f };
+  const int   iLimits    = sizeof(rgLimits) / sizeof(rgLimits[0]);
+  const int   iSteps     = sizeof(rgSteps) / sizeof(rgSteps[0]);
+
+  int iRuns = 0;
+  srand(1);
+  for(int l = 0; l < iLimits; l++) {
+    for(int s = 0; s < iSteps; s++) {
+      // The heading takes the shortest way: Steps up to 180 deg, also across +/-180
+      if(rgLimits[l].bWrap && rgSteps[s] >= 180.f) {
+        continue;
+      }
+      for(int iSign = -1; iSign <= 1; iSign += 2) {
+        for(int iJitter = 0; iJitter < 2; iJitter++) {
+          float fStart = rgLimits[l].bWrap ? 170.f * -iSign : 0.f;
+          run_step(rgLimits[l], fStart, rgSteps[s] * iSign, iJitter == 1);
+          iRuns++;
+        }
+      }
+    }
+  }
+
+  printf("%d runs, max. of the limits: velocity %.3f, acceleration %.3f, jerk %.3f, overshoot %.3f of the tolerance, %s\n",
+         iRuns, fMaxVel, fMaxAcc, fMaxJerk, fMaxOver, iFailed ? "FAILED" : "OK");
+  return iFailed ? 1 : 0;
+}
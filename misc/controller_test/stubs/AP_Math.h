@@ -0,0 +1,25 @@
+#ifndef AP_MATH_STUB_h
+#define AP_MATH_STUB_h
+
+#include <math.h>
+#include <string.h>
+
+// Host stub: The vector type, the limiter and the angle conversions of the ArduPilot math library
+#define ToRad(x) ( (x) * 0.01745329252f)
+#define ToDeg(x) ( (x) * 57.2957795131f)
+
+struct Vector3f {
+  float x, y, z;
+
+  Vector3f() : x(0.f), y(0.f), z(0.f) {}
+  Vector3f(float fX, float fY, float fZ) : x(fX), y(fY), z(fZ) {}
+};
+
+inline float constrain_float(float amt, float low, float high) {
+  if(isnan(amt) ) {
+    return (low + high) * 0.5f;
+  }
+  return amt < low ? low : (amt > high ? high : amt);
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Host test of the failsafe state machine (RPiAPMCopter/exceptions.cpp)
+ * - Every combination of the error flags is resolved by Exception::handle()
+ *   and compared with the expected state and the degraded actions.
+ * - Every change between the take down states must keep reducing the throttle.
+ *
+ * Build and run from this directory:
+ * g++ -std=gnu++98 -Wall -I. -Istubs -I../../RPiAPMCopter -include HostFakes.h FailsafeTest.cpp
+ *     ../../RPiAPMCopter/exceptions.cpp ../../RPiAPMCopter/containers.cpp ../../RPiAPMCopter/absdevice.cpp -o FailsafeTest
+ * ./FailsafeTest
+ */
+#include <stdio.h>
+
+#include "HostFakes.h"
+#include "exceptions.h"
+
+#define FLAG_CNT       12                                     // Flags of AbsErrorDevice::DEVICE_ERROR_FLAGS
+#define STEP_US        20000UL                                // One iteration of the main loop
+#define THR_START      1700
+
+static const uint_fast16_t RCVR_FLAGS  = AbsErrorDevice::UART_TIMEOUT_F | AbsErrorDevice::GEOFENCE_F;
+static const uint_fast16_t CRIT_FLAGS  = AbsErrorDevice::GYROMETER_F | AbsErrorDevice::ACCELEROMETR_F | AbsErrorDevice::CURRENT_LOW_F;
+static const uint_fast16_t NAV_FLAGS   = AbsErrorDevice::COMPASS_F | AbsErrorDevice::GPS_F;
+
+static int iFailed = 0;
+
+// The expected behaviour, written down independently of the fault table
+static Exception::FAILSAFE_STATE expected_state(const uint_fast16_t iMask) {
+  if(iMask & CRIT_FLAGS) {
+    return Exception::FS_DEVICE_DOWN_S;
+  }
+  if(iMask & AbsErrorDevice::UART_TIMEOUT_F) {
+    return Exception::FS_RCVR_DOWN_S;
+  }
+  if(iMask & AbsErrorDevice::GEOFENCE_F) {
+    return Exception::FS_FENCE_S;
+  }
+  if(iMask & (AbsErrorDevice::BAROMETER_F | NAV_FLAGS) ) {
+    return Exception::FS_DEGRADED_S;
+  }
+  return Exception::FS_NONE_S;
+}
+
+static void check(const bool bOK, const char *pMsg, const uint_fast16_t iMask) {
+  if(bOK) {
+    return;
+  }
+  iFailed++;
+  if(iFailed <= 20) {
+    printf("FAILED: %s (mask 0x%03x)\n", pMsg, static_cast<unsigned>(iMask) );
+  }
+}
+
+struct Setup {
+  AP_HAL::Scheduler scheduler;
+  AP_HAL::HAL       hal;
+  Device            device;
+  Receiver          receiver;
+
+  Setup() : device(&hal) {
+    scheduler.time_us = 1000000UL;
+    hal.scheduler     = &scheduler;
+    device.m_Frame.timestamp_us = scheduler.time_us;
+    receiver.set_channel(RC_THR, THR_START);
+    receiver.m_iLastParse_ms = COM_PKT_TIMEOUT + 1;           // The receiver take down doesn't end by itself
+  }
+
+  void set_mask(const uint_fast16_t iMask) {
+    device.set_errors(static_cast<AbsErrorDevice::DEVICE_ERROR_FLAGS>(iMask & ~RCVR_FLAGS) );
+    receiver.set_errors(static_cast<AbsErrorDevice::DEVICE_ERROR_FLAGS>(iMask & RCVR_FLAGS) );
+  }
+
+  void step() {
+    device.m_Frame.timestamp_us += STEP_US;
+    receiver.m_iLastParse_ms    += STEP_US / 1000UL;
+  }
+};
+
+// One iteration with the mask and the waypoint mode, returns the mode afterwards
+static GPSPosition::UAV_TYPE run_mask(const uint_fast16_t iMask, const GPSPosition::UAV_TYPE eMode) {
+  Setup setup;
+  Exception except(&setup.device, &setup.receiver);
+  setup.receiver.m_Waypoint.mode = eMode;
+  setup.set_mask(iMask);
+
+  Exception::FAILSAFE_STATE eExp = expected_state(iMask);
+  bool bDown = except.handle();
+  check(except.get_state() == eExp, "state", iMask);
+  check(bDown == (eExp >= Exception::FS_FENCE_S), "take down", iMask);
+  if(eExp >= Exception::FS_FENCE_S) {
+    check(setup.receiver.get_channel(RC_THR) <= THR_START, "throttle raised", iMask);
+  }
+  return setup.receiver.m_Waypoint.mode;
+}
+
+static void test_all_masks() {
+  for(uint_fast16_t iMask = 0; iMask < (1U << FLAG_CNT); iMask++) {
+    Exception::FAILSAFE_STATE eExp = expected_state(iMask);
+
+    GPSPosition::UAV_TYPE eAlti = run_mask(iMask, GPSPosition::HLD_ALTITUDE_F);
+    GPSPosition::UAV_TYPE eNavi = run_mask(iMask, GPSPosition::GPS_NAVIGATN_F);
+    switch(eExp) {
+      case Exception::FS_NONE_S:
+        check(eAlti == GPSPosition::HLD_ALTITUDE_F && eNavi == GPSPosition::GPS_NAVIGATN_F, "mode changed", iMask);
+        break;
+      case Exception::FS_DEGRADED_S:
+        check( (eAlti == GPSPosition::NOTHING_F) == ( (iMask & AbsErrorDevice::BAROMETER_F) != 0), "altitude hold action", iMask);
+        check( (eNavi == GPSPosition::NOTHING_F) == ( (iMask & NAV_FLAGS) != 0),                 "navigation action", iMask);
+        break;
+      default:
+        check(eAlti == GPSPosition::CONTRLD_DOWN_F && eNavi == GPSPosition::CONTRLD_DOWN_F, "controlled down mode", iMask);
+        break;
+    }
+  }
+}
+
+/*
+ * The throttle must not rise while the model is taken down,
+ * also not if the reason of the take down changes (e.g. receiver -> inertial sensor)
+ */
+static void test_transition(const uint_fast16_t iFrom, const uint_fast16_t iTo) {
+  Setup setup;
+  Exception except(&setup.device, &setup.receiver);
+
+  int_fast32_t iLast = THR_START;
+  for(uint_fast8_t iPhase = 0; iPhase < 2; iPhase++) {
+    setup.set_mask(iPhase == 0 ? iFrom : iTo);
+    for(uint_fast8_t i = 0; i < 50; i++) {
+      setup.step();
+      except.handle();
+      int_fast32_t iThr = setup.receiver.get_channel(RC_THR);
+      check(iThr <= iLast, "throttle raised after a transition", iTo);
+      iLast = iThr;
+    }
+    check(except.get_state() == expected_state(iPhase == 0 ? iFrom : iTo), "transition state", iTo);
+  }
+  check(iLast < THR_START, "throttle not reduced", iTo);
+}
+
+int main() {
+  test_all_masks();
+
+  const uint_fast16_t rgDown[] = {
+    AbsErrorDevice::GYROMETER_F, AbsErrorDevice::UART_TIMEOUT_F, AbsErrorDevice::GEOFENCE_F
+  };
+  for(uint_fast8_t i = 0; i < 3; i++) {
+    for(uint_fast8_t j = 0; j < 3; j++) {
+      if(i != j) {
+        test_transition(rgDown[i], rgDown[j]);
+      }
+    }
+  }
+
+  printf("%d masks, %s\n", 1 << FLAG_CNT, iFailed ? "FAILED" : "OK");
+  return iFailed ? 1 : 0;
+}
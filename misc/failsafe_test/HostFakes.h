@@ -0,0 +1,59 @@
+#ifndef HOSTFAKES_h
+#define HOSTFAKES_h
+
+/*
+ * Host replacements of the Device and the Receiver for the failsafe tests.
+ * Included before exceptions.cpp (g++ -include), so the guards of receiver.h and device.h
+ * skip the real classes with their HAL dependencies.
+ * Only the members used by exceptions.cpp are provided.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "containers.h"
+#include "absdevice.h"
+#include "config.h"
+
+#define RECVR_h
+#define DEVICE_h
+
+#define PSTR(s) s
+
+namespace AP_HAL {
+  struct Scheduler {
+    uint32_t time_us;
+    uint32_t micros() const { return time_us; }
+  };
+  struct HAL {
+    Scheduler *scheduler;
+  };
+}
+
+class Receiver : public AbsErrorDevice {
+public:
+  int_fast32_t  m_rgChannelsRC[APM_IOCHAN_CNT];
+  GPSPosition   m_Waypoint;
+  uint_fast32_t m_iLastParse_ms;                              // Returned by last_parse_t32()
+
+  Receiver() : m_iLastParse_ms(0) {
+    memset(m_rgChannelsRC, 0, sizeof(m_rgChannelsRC) );
+  }
+
+  void          set_channel(uint_fast8_t i, int_fast32_t iVal) { m_rgChannelsRC[i] = iVal; }
+  int_fast32_t  get_channel(uint_fast8_t i) const              { return m_rgChannelsRC[i]; }
+  int_fast32_t *get_channels()                                 { return m_rgChannelsRC; }
+  GPSPosition  *get_waypoint()                                 { return &m_Waypoint; }
+  uint_fast32_t last_parse_t32()                               { return m_iLastParse_ms; }
+};
+
+class Device : public AbsErrorDevice {
+public:
+  const AP_HAL::HAL *m_pHAL;
+  SensorFrame        m_Frame;
+
+  Device(const AP_HAL::HAL *pHAL) : m_pHAL(pHAL) {}
+
+  const SensorFrame &get_frame() const { return m_Frame; }
+};
+
+#endif /*HOSTFAKES_h*/
@@ -0,0 +1 @@
+// Host stub: Not needed by the failsafe state machine
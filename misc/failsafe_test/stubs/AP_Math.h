@@ -0,0 +1,12 @@
+#ifndef AP_MATH_STUB_h
+#define AP_MATH_STUB_h
+
+// Host stub: Only the vector type of the sensor frame
+struct Vector3f {
+  float x, y, z;
+
+  Vector3f() : x(0.f), y(0.f), z(0.f) {}
+  Vector3f(float fX, float fY, float fZ) : x(fX), y(fY), z(fZ) {}
+};
+
+#endif
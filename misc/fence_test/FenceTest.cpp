@@ -0,0 +1,140 @@
+/*
+ * Host simulation of the incremental geofence check (RPiAPMCopter/fence.cpp)
+ * - Random star shaped polygons (convex and non-convex, both orientations) with random walks:
+ *   At every step the incremental result is compared with a full even-odd test.
+ * - Re-uploads of a polygon with the same vertex count must not enable the fence
+ *   with vertices or the ceiling of the previous polygon.
+ *
+ * Build and run from this directory:
+ * g++ -std=gnu++98 -Wall -I../failsafe_test/stubs -I../../RPiAPMCopter FenceTest.cpp ../../RPiAPMCopter/fence.cpp -o FenceTest
+ * ./FenceTest [nr. of polygons] [steps per polygon]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+// The statistics read the incremental state
+#define private public
+#include "fence.h"
+#undef private
+
+#define STEP_CM        10                                     // Distance per navigation tick
+#define AREA_CM        12000                                  // The walk turns around at this distance from the origin
+#define CEILING_CM     10000
+
+static int iFailed = 0;
+
+static void check(const bool bOK, const char *pMsg) {
+  if(bOK) {
+    return;
+  }
+  iFailed++;
+  printf("FAILED: %s\n", pMsg);
+}
+
+// Reference: Even-odd test over all edges
+static bool outside(const int *pN, const int *pE, const int iCnt, const int iN, const int iE) {
+  bool bInside = false;
+  for(int i = 0; i < iCnt; i++) {
+    int j = (i + 1) % iCnt;
+    if( (pN[i] > iN) == (pN[j] > iN) ) {
+      continue;
+    }
+    double fE = pE[i] + static_cast<double>(iN - pN[i]) * (pE[j] - pE[i]) / (pN[j] - pN[i]);
+    if(iE < fE) {
+      bInside = !bInside;
+    }
+  }
+  return !bInside;
+}
+
+static void random_polygon(int *pN, int *pE, const int iCnt) {
+  bool bCW = rand() % 2;
+  for(int i = 0; i < iCnt; i++) {
+    double fA = 2 * M_PI * i / iCnt * (bCW ? -1 : 1);
+    double fR = 2000 + rand() % 6000;
+    pN[i] = static_cast<int>(fR * cos(fA) );
+    pE[i] = static_cast<int>(fR * sin(fA) );
+  }
+}
+
+static void test_random_walks(const int iPolys, const int iSteps) {
+  long iTotal = 0, iMismatch = 0, iEvals = 0;
+  for(int p = 0; p < iPolys; p++) {
+    int rgN[FENCE_MAX_PTS], rgE[FENCE_MAX_PTS];
+    int iCnt = 3 + rand() % (FENCE_MAX_PTS - 2);
+    random_polygon(rgN, rgE, iCnt);
+
+    Geofence fence;
+    for(int i = 0; i < iCnt; i++) {
+      fence.set_vertex(i, iCnt, rgN[i], rgE[i], CEILING_CM);
+    }
+    check(fence.is_enabled(), "polygon not enabled");
+
+    double fN = rand() % 4000 - 2000;
+    double fE = rand() % 4000 - 2000;
+    double fHdg = (rand() % 628) / 100.0;
+    for(int s = 0; s < iSteps; s++) {
+      fHdg += ( (rand() % 100) - 50) / 500.0;
+      fN += STEP_CM * cos(fHdg);
+      fE += STEP_CM * sin(fHdg);
+      if(fabs(fN) > AREA_CM || fabs(fE) > AREA_CM) {
+        fHdg += M_PI;
+      }
+
+      int32_t iNext = fence.m_iNext_cm;
+      bool bOut = fence.check(static_cast<int>(fN), static_cast<int>(fE), 0, true);
+      // update_near() ran if the path reached the smallest bound
+      if(fence.m_iPath_cm + FENCE_NEAR_CM >= iNext) {
+        iEvals++;
+      }
+      if(bOut != outside(rgN, rgE, iCnt, static_cast<int>(fN), static_cast<int>(fE) ) ) {
+        iMismatch++;
+      }
+      iTotal++;
+    }
+  }
+  printf("%d polygons, %ld steps, %ld mismatches, edges re-evaluated on %.1f %% of the steps\n",
+         iPolys, iTotal, iMismatch, 100.0 * iEvals / iTotal);
+  check(iMismatch == 0, "incremental check differs from the even-odd test");
+}
+
+static void test_reupload() {
+  Geofence fence;
+  // Square of 100 m with a ceiling of 100 m
+  const int rgN1[] = { -5000, -5000,  5000, 5000 };
+  const int rgE1[] = { -5000,  5000,  5000, -5000 };
+  for(int i = 0; i < 4; i++) {
+    fence.set_vertex(i, 4, rgN1[i], rgE1[i], CEILING_CM);
+  }
+  check(fence.is_enabled(), "first polygon not enabled");
+  check(!fence.check(0, 0, 5000, true), "inside of the first polygon");
+
+  // Second square far away, same vertex count and a lower ceiling
+  const int rgN2[] = { 20000, 20000, 30000, 30000 };
+  const int rgE2[] = { 20000, 30000, 30000, 20000 };
+  for(int i = 0; i < 4; i++) {
+    fence.set_vertex(i, 4, rgN2[i], rgE2[i], CEILING_CM / 2);
+    if(i < 3) {
+      // A mix of old and new vertices must not be enabled
+      check(!fence.is_enabled(), "partial upload enabled");
+      check(!fence.check(0, 0, 8000, true), "partial upload raised the fence");
+    }
+  }
+  check(fence.is_enabled(), "second polygon not enabled");
+  check(fence.check(0, 0, 1000, true), "outside of the second polygon");
+  check(!fence.check(25000, 25000, 1000, true), "inside of the second polygon");
+  check(fence.check(25000, 25000, 8000, true), "above the ceiling of the second polygon");
+}
+
+int main(int argc, char *argv[]) {
+  int iPolys = argc > 1 ? atoi(argv[1]) : 300;
+  int iSteps = argc > 2 ? atoi(argv[2]) : 5000;
+
+  srand(1);
+  test_random_walks(iPolys, iSteps);
+  test_reupload();
+
+  printf("%s\n", iFailed ? "FAILED" : "OK");
+  return iFailed ? 1 : 0;
+}
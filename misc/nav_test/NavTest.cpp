@@ -0,0 +1,96 @@
+/*
+ * Host check of the navigation projection (NavOrigin in RPiAPMCopter/mission.cpp)
+ * Grid of +/- 2 km (21 x 21 points, like bench_nav() of the firmware) around origins at several latitudes.
+ * The reference is the tangent plane of the sphere of the projection (east, north) in double precision.
+ * Reports the worst case deviation of NavOrigin::to_cm() and of the former float method
+ * and checks the bound of the projection: Below 0.1 % of the distance plus 1 cm of truncation.
+ *
+ * Build and run from this directory:
+ * g++ -std=gnu++98 -Wall -I../controller_test/stubs -I../../RPiAPMCopter NavTest.cpp ../../RPiAPMCopter/mission.cpp -o NavTest
+ * ./NavTest
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <AP_Math.h>
+#include "mission.h"
+
+#define GRID_N         10                                     // Points on each side of the origin
+#define STEP_LAT       18000                                  // ~200 m (in degrees * 10,000,000)
+#define STEP_N_CM      20000.                                 // East steps are scaled to the same distance
+#define CM_PER_E7      1.113195                               // LATLON_TO_CM of mission.cpp
+#define BOUND_REL      0.001
+#define BOUND_ABS_CM   1.
+
+static const double RAD_PER_E7 = M_PI / 180. / 10000000.;
+static const double R_CM       = CM_PER_E7 / RAD_PER_E7;
+
+// Tangent plane at the origin (north, east) in cm
+static void reference_cm(const int32_t iLat0, const int32_t iLon0, const int32_t iLat, const int32_t iLon, double &fN, double &fE) {
+  double fLat0 = iLat0 * RAD_PER_E7, fLat = iLat * RAD_PER_E7;
+  double fDLon = (static_cast<double>(iLon) - iLon0) * RAD_PER_E7;
+  fN = R_CM * (cos(fLat0) * sin(fLat) - sin(fLat0) * cos(fLat) * cos(fDLon) );
+  fE = R_CM * cos(fLat) * sin(fDLon);
+}
+
+// The former method: Both positions converted to metres (float) and subtracted
+static void former_cm(const int32_t iLat0, const int32_t iLon0, const int32_t iLat, const int32_t iLon, float &fN, float &fE) {
+  const float fPerimeter_m = 40074000.f;
+  float fLat0 = iLat0 / 10000000.f, fLon0 = iLon0 / 10000000.f;
+  float fLat  = iLat  / 10000000.f, fLon  = iLon  / 10000000.f;
+  float fX0   = fPerimeter_m * cosf(ToRad(fLat0) ) / 360.f * fLon0;
+  float fY0   = fPerimeter_m / 360.f * fLat0;
+  float fX    = fPerimeter_m * cosf(ToRad(fLat) ) / 360.f * fLon;
+  float fY    = fPerimeter_m / 360.f * fLat;
+  fN = (fY - fY0) * 100.f;
+  fE = (fX - fX0) * 100.f;
+}
+
+int main() {
+  const double rgLat_deg[] = { 0., 30., 48., 60., 70. };
+  const int    iLats       = sizeof(rgLat_deg) / sizeof(rgLat_deg[0]);
+  int iFailed = 0;
+
+  for(int l = 0; l < iLats; l++) {
+    const int32_t iLat0   = static_cast<int32_t>(rgLat_deg[l] * 10000000.);
+    const int32_t iLon0   = 110000000;                        // 11 deg east
+    const int32_t iStepE  = static_cast<int32_t>(STEP_LAT / cos(rgLat_deg[l] * M_PI / 180.) );
+
+    NavOrigin origin;
+    origin.set(iLat0, iLon0);
+
+    double fMaxNav_cm = 0., fMaxRel = 0., fMaxFormer_cm = 0.;
+    for(int i = -GRID_N; i <= GRID_N; i++) {
+      for(int j = -GRID_N; j <= GRID_N; j++) {
+        int32_t iLat = iLat0 + i * STEP_LAT;
+        int32_t iLon = iLon0 + j * iStepE;
+
+        double fN, fE;
+        reference_cm(iLat0, iLon0, iLat, iLon, fN, fE);
+        double fDist = sqrt(fN * fN + fE * fE);
+
+        int32_t iN_cm, iE_cm;
+        origin.to_cm(iLat, iLon, iN_cm, iE_cm);
+        double fErr = sqrt( (iN_cm - fN) * (iN_cm - fN) + (iE_cm - fE) * (iE_cm - fE) );
+        fMaxNav_cm  = fErr > fMaxNav_cm ? fErr : fMaxNav_cm;
+        if(fDist > 0.) {
+          fMaxRel = (fErr - BOUND_ABS_CM) / fDist > fMaxRel ? (fErr - BOUND_ABS_CM) / fDist : fMaxRel;
+        }
+        if(fErr > fDist * BOUND_REL + BOUND_ABS_CM) {
+          iFailed++;
+        }
+
+        float fFN, fFE;
+        former_cm(iLat0, iLon0, iLat, iLon, fFN, fFE);
+        fErr = sqrt( (fFN - fN) * (fFN - fN) + (fFE - fE) * (fFE - fE) );
+        fMaxFormer_cm = fErr > fMaxFormer_cm ? fErr : fMaxFormer_cm;
+      }
+    }
+    printf("lat %4.1f deg: NavOrigin max. %6.1f cm (%.4f %% of the distance + 1 cm), former float method max. %8.1f cm\n",
+           rgLat_deg[l], fMaxNav_cm, fMaxRel * 100., fMaxFormer_cm);
+  }
+
+  printf("bound %.1f %% of the distance + %.0f cm: %s\n", BOUND_REL * 100., BOUND_ABS_CM, iFailed ? "FAILED" : "OK");
+  return iFailed ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * Host simulation of the motor PWM edge sync (sync_pwm_edge() in RPiAPMCopter/rcframe.cpp)
+ * Models timer 1/4 of the APM2 in fast PWM mode (0.5 us ticks, TOP = ICR = 2,000,000 / MOTOR_PWM_HZ,
+ * compare registers loaded at the bottom of the period) and writes of random pulse widths at a jittered loop period.
+ * Measures the wait from rcout->write() to the start of the first pulse with the new widths
+ * - without sync,
+ * - with the former guard (TCNT > RC_THR_MAX), and
+ * - with the compare values of the running period (the firmware).
+ * A sync which would cut a running pulse is counted as a violation and fails the run.
+ *
+ * Build and run from this directory:
+ * g++ -std=gnu++98 -Wall -I../../RPiAPMCopter PwmSyncSim.cpp -o PwmSyncSim
+ * ./PwmSyncSim
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Values of RPiAPMCopter/config.h
+#define RC_THR_ACRO          1225
+#define RC_THR_MAX           2000
+#define MOTOR_PWM_HZ         490
+#define MOTOR_CNT            4
+#define PWM_TICKS_PER_US     2
+#define WRITES               200000
+
+enum SYNC_MODE {
+  SYNC_NONE = 0,
+  SYNC_FORMER,
+  SYNC_OCR
+};
+
+static const char *MODE_NAME[] = { "no sync", "TCNT > RC_THR_MAX", "TCNT > running OCR" };
+
+struct Timer {
+  uint32_t icr;
+  uint32_t tcnt;
+  uint16_t ocr_act[MOTOR_CNT];      // Compare values of the running period
+  uint16_t ocr_buf[MOTOR_CNT];      // Written values, loaded at the bottom
+
+  void advance(const uint32_t n) {
+    for(uint32_t iLeft = n; iLeft > 0; ) {
+      uint32_t iToBottom = icr + 1 - tcnt;
+      if(iLeft < iToBottom) {
+        tcnt += iLeft;
+        break;
+      }
+      iLeft -= iToBottom;
+      tcnt = 0;
+      for(int i = 0; i < MOTOR_CNT; i++) {
+        ocr_act[i] = ocr_buf[i];
+      }
+    }
+  }
+  uint32_t ticks_to_bottom() const {
+    return icr + 1 - tcnt;
+  }
+  uint16_t ocr_max() const {                 // motor_ocr_max(): Reads the buffered registers
+    uint16_t iMax = 0;
+    for(int i = 0; i < MOTOR_CNT; i++) {
+      iMax = ocr_buf[i] > iMax ? ocr_buf[i] : iMax;
+    }
+    return iMax;
+  }
+  uint16_t ocr_act_max() const {
+    uint16_t iMax = 0;
+    for(int i = 0; i < MOTOR_CNT; i++) {
+      iMax = ocr_act[i] > iMax ? ocr_act[i] : iMax;
+    }
+    return iMax;
+  }
+};
+
+struct Result {
+  double   avg_us;
+  double   max_us;
+  double   synced_pct;
+  double   saved_us;                  // Average wait saved by a sync
+  unsigned violations;
+};
+
+static uint32_t rand_range(const uint32_t iMin, const uint32_t iMax) {
+  return iMin + static_cast<uint32_t>(rand() % (iMax - iMin + 1) );
+}
+
+struct Scenario {
+  uint32_t loop_us;
+  uint32_t jitter_us;
+  uint32_t min_us;                    // Range of the pulse widths
+  uint32_t max_us;
+};
+
+static Result run(const SYNC_MODE eMode, const Scenario &s) {
+  srand(1);
+  Timer t;
+  t.icr  = 2000000UL / MOTOR_PWM_HZ;
+  t.tcnt = 0;
+  for(int i = 0; i < MOTOR_CNT; i++) {
+    t.ocr_act[i] = t.ocr_buf[i] = s.min_us * PWM_TICKS_PER_US;
+  }
+  uint16_t iPending = 0;
+
+  Result r = { 0., 0., 0., 0., 0 };
+  uint32_t iSynced = 0;
+  for(uint32_t w = 0; w < WRITES; w++) {
+    t.advance( (s.loop_us + rand_range(0, 2 * s.jitter_us) - s.jitter_us) * PWM_TICKS_PER_US);
+
+    // servo_out()
+    uint16_t iRunning = t.ocr_max();
+    for(int i = 0; i < MOTOR_CNT; i++) {
+      t.ocr_buf[i] = rand_range(s.min_us, s.max_us) * PWM_TICKS_PER_US;
+    }
+    bool bSync = false;
+    if(eMode == SYNC_FORMER) {
+      bSync = t.tcnt > RC_THR_MAX * PWM_TICKS_PER_US;
+    } else if(eMode == SYNC_OCR) {
+      uint16_t iEnd = iRunning > iPending ? iRunning : iPending;
+      bSync = t.tcnt > iEnd;
+      iPending = bSync ? 0 : iRunning;
+    }
+    if(bSync) {
+      if(t.tcnt <= t.ocr_act_max() ) {
+        r.violations++;
+      }
+      r.saved_us += static_cast<double>(t.ticks_to_bottom() - 2) / PWM_TICKS_PER_US;
+      t.tcnt = t.icr - 1;
+      iSynced++;
+    }
+
+    // The next bottom loads the new widths
+    double fWait_us = static_cast<double>(t.ticks_to_bottom() ) / PWM_TICKS_PER_US;
+    r.avg_us += fWait_us;
+    r.max_us  = fWait_us > r.max_us ? fWait_us : r.max_us;
+  }
+  r.avg_us    /= WRITES;
+  r.synced_pct = 100. * iSynced / WRITES;
+  r.saved_us   = iSynced > 0 ? r.saved_us / iSynced : 0.;
+  return r;
+}
+
+int main() {
+  // ~6 ms main loop (s_lop telemetry) and one faster than the PWM period (exercises the buffered widths),
+  // each with the whole throttle range and with widths around a hover point
+  const Scenario rgScen[] = {
+    { 6000, 500, RC_THR_ACRO, RC_THR_MAX },
+    { 6000, 500, 1400,        1600       },
+    { 1500, 250, RC_THR_ACRO, RC_THR_MAX },
+    { 1500, 250, 1400,        1600       }
+  };
+  bool bOK = true;
+
+  printf("Wait from rcout->write() to the first pulse with the new widths (%d Hz, %d writes)\n", MOTOR_PWM_HZ, WRITES);
+  for(unsigned l = 0; l < sizeof(rgScen) / sizeof(rgScen[0]); l++) {
+    const Scenario &s = rgScen[l];
+    printf("Loop %lu +/- %lu us, pulses %lu .. %lu us\n", (unsigned long)s.loop_us, (unsigned long)s.jitter_us,
+           (unsigned long)s.min_us, (unsigned long)s.max_us);
+    for(int m = SYNC_NONE; m <= SYNC_OCR; m++) {
+      Result r = run(static_cast<SYNC_MODE>(m), s);
+      printf("  %-20s avg %7.1f us, max %7.1f us, synced %5.1f %% (saved %5.1f us each), cut pulses %u\n",
+             MODE_NAME[m], r.avg_us, r.max_us, r.synced_pct, r.saved_us, r.violations);
+      bOK = bOK && r.violations == 0;
+    }
+  }
+  printf("%s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+# Reports the static RAM (.data, .bss and .noinit) of the linked firmware and of each translation unit
+# and fails if the total exceeds the budget. Run it after the build of RPiAPMCopter.
+# On AVR, string literals without PROGMEM sit in .rodata of the object files. The linker script places .rodata
+# into the .data output section, so they are copied from the flash into the SRAM at startup.
+# They are listed in their own column: A unit with many strings usually has format strings which should be moved into PSTR().
+#
+# The total is taken from the linked ELF (avr-size), so sections removed by --gc-sections are not counted.
+# The breakdown per unit is read from the linker map (-Wl,-Map, written by the ArduPilot make as <sketch>.map).
+#
+# Usage: python RamBudget.py <build dir> [budget] [unit budget]
+#
+# build dir is the directory with the linked firmware and its map (e.g. /tmp/RPiAPMCopter.build)
+# budget is the total in bytes (default 6144: 2 KB of the 8 KB SRAM are left for the stack and the heap)
+# unit budget is the limit for a single translation unit (default: no limit)
+import sys
+import os
+import re
+import io
+import subprocess
+
+SRAM_SIZE     = 8192  # ATmega2560
+BUDGET        = 6144
+SKETCH        = 'RPiAPMCopter'
+RAM_SECTIONS  = ['.data', '.bss', '.noinit']
+COLUMNS       = ['.data', 'strings', '.bss', '.noinit']
+AVR_SIZE      = os.environ.get('AVR_SIZE', 'avr-size')
+
+# Input section with its address, size and object file (the name may be on its own line if it is long)
+RE_INPUT      = re.compile(r'^ (\S+)\s+0x[0-9a-fA-F]+\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+RE_NAME       = re.compile(r'^ (\S+)$')
+RE_CONT       = re.compile(r'^\s+0x[0-9a-fA-F]+\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+
+def find_file(path, ext):
+  name = os.path.join(path, SKETCH + ext)
+  if os.path.isfile(name):
+    return name
+  for f in sorted(os.listdir(path) ):
+    if f.endswith(ext):
+      return os.path.join(path, f)
+  return None
+
+# Sizes of the RAM sections of the linked firmware from the SysV output of avr-size (name, size, address)
+def elf_usage(elf):
+  try:
+    out = subprocess.check_output([AVR_SIZE, '-A', elf]).decode('latin-1')
+  except OSError:
+    sys.exit("%s not found: Set AVR_SIZE to the avr-size of the toolchain" % AVR_SIZE)
+  sizes = dict( (s, 0) for s in RAM_SECTIONS)
+  for line in out.splitlines():
+    cols = line.split()
+    if len(cols) >= 2 and cols[0] in sizes:
+      sizes[cols[0]] += int(cols[1])
+  return sizes
+
+def unit_name(obj):
+  # e.g. /tmp/RPiAPMCopter.build/libraries/AP_GPS/AP_GPS.o or /usr/lib/avr/lib/avr6/libc.a(vfprintf_std.o)
+  return os.path.basename(obj.strip() )
+
+# RAM of each unit from the linker map: Input sections of the .data, .bss and .noinit output sections
+def map_usage(mapfile):
+  units   = {}
+  out_sec = None
+  pending = None
+  for line in io.open(mapfile, 'r', encoding = 'latin-1'):
+    line = line.rstrip('\r\n')
+    if not line:
+      continue
+    # Output section or a new part of the map (e.g. "Discarded input sections")
+    if not line[0].isspace():
+      name    = line.split()[0]
+      out_sec = name if name in RAM_SECTIONS else None
+      pending = None
+      continue
+    if out_sec is None:
+      continue
+
+    m = RE_INPUT.match(line)
+    if m:
+      in_sec, size, obj = m.group(1), int(m.group(2), 16), m.group(3)
+    elif pending and RE_CONT.match(line):
+      m = RE_CONT.match(line)
+      in_sec, size, obj = pending, int(m.group(1), 16), m.group(2)
+    else:
+      m = RE_NAME.match(line)
+      pending = m.group(1) if m and not m.group(1).startswith('*(') else None
+      continue
+    pending = None
+    if size == 0 or in_sec.startswith('*('):
+      continue
+
+    col = out_sec
+    if out_sec == '.data' and in_sec.startswith('.rodata'):
+      col = 'strings'
+    sizes = units.setdefault(unit_name(obj), dict( (c, 0) for c in COLUMNS) )
+    sizes[col] += size
+  return units
+
+if __name__ == '__main__':
+  if len(sys.argv) < 2:
+    sys.exit("Usage: python RamBudget.py <build dir> [budget] [unit budget]")
+  budget      = int(sys.argv[2]) if len(sys.argv) > 2 else BUDGET
+  unit_budget = int(sys.argv[3]) if len(sys.argv) > 3 else 0
+
+  elf = find_file(sys.argv[1], '.elf')
+  if elf is None:
+    sys.exit("No linked firmware (.elf) in %s" % sys.argv[1])
+  mapfile = find_file(sys.argv[1], '.map')
+
+  failed = []
+  if mapfile is None:
+    print("No linker map in %s: Link with -Wl,-Map,<file> for the units" % sys.argv[1])
+  else:
+    rows = []
+    for unit, sizes in map_usage(mapfile).items():
+      used = sum(sizes.values() )
+      rows.append( (used, unit, sizes) )
+      if unit_budget and used > unit_budget:
+        failed.append(unit)
+
+    print("%-48s %7s %7s %7s %7s %7s" % ('unit', '.data', 'strings', '.bss', '.noinit', 'total') )
+    for used, unit, sizes in sorted(rows, reverse = True):
+      print("%-48s %7d %7d %7d %7d %7d" % (unit, sizes['.data'], sizes['strings'], sizes['.bss'], sizes['.noinit'], used) )
+
+  sizes = elf_usage(elf)
+  total = sum(sizes.values() )
+  print("Static RAM of %s: %d of %d bytes budget (%d bytes SRAM; .data %d, .bss %d, .noinit %d)" %
+        (os.path.basename(elf), total, budget, SRAM_SIZE, sizes['.data'], sizes['.bss'], sizes['.noinit']) )
+
+  for unit in failed:
+    print("Unit budget of %d bytes exceeded: %s" % (unit_budget, unit) )
+  if total > budget or failed:
+    sys.exit(1)
@@ -0,0 +1,134 @@
+# Fits the thrust curves of the motors from static thrust stand data
+# and writes the lookup table for the motor output stage (RPiAPMCopter/thrustlut.h)
+#
+# Usage: python ThrustFit.py <data.csv> [degree] [thrustlut.h]
+#
+# CSV columns (header line optional): motor,pwm_us,thrust_g
+# motor is the output channel (0: FR, 1: BL, 2: FL, 3: BR, see MOTOR_* in config.h)
+import sys
+import csv
+
+RC_THR_OFF  = 1000  # config.h
+RC_THR_MAX  = 2000
+MOTOR_CNT   = 4
+LUT_SEGS    = 16    # THRUST_LUT_SEGS
+MOTOR_NAMES = ['MOTOR_FR', 'MOTOR_BL', 'MOTOR_FL', 'MOTOR_BR']
+
+def read_csv(path):
+  data = {}
+  for row in csv.reader(open(path) ):
+    try:
+      motor, pwm, thrust = int(row[0]), float(row[1]), float(row[2])
+    except (ValueError, IndexError):
+      continue # header or empty line
+    data.setdefault(motor, []).append( (pwm, thrust) )
+  return data
+
+# Least squares fit of a polynomial (normal equations, no numpy needed)
+def polyfit(points, degree):
+  n = degree + 1
+  A = [[0.0] * (n + 1) for i in range(n)]
+  for x, y in points:
+    x = (x - RC_THR_OFF) / float(RC_THR_MAX - RC_THR_OFF) # scaled for a well conditioned system
+    for i in range(n):
+      for j in range(n):
+        A[i][j] += x ** (i + j)
+      A[i][n] += y * x ** i
+  # Gaussian elimination with partial pivoting
+  for c in range(n):
+    p = max(range(c, n), key = lambda r: abs(A[r][c]) )
+    A[c], A[p] = A[p], A[c]
+    if A[c][c] == 0.0:
+      sys.exit("Not enough data points for a fit of degree %d" % degree)
+    for r in range(n):
+      if r != c:
+        f = A[r][c] / A[c][c]
+        A[r] = [a - f * b for a, b in zip(A[r], A[c])]
+  return [A[i][n] / A[i][i] for i in range(n)]
+
+def polyval(coeffs, pwm):
+  x = (pwm - RC_THR_OFF) / float(RC_THR_MAX - RC_THR_OFF)
+  return sum(c * x ** i for i, c in enumerate(coeffs) )
+
+# The fit is not valid below the start of the motor (no thrust): Its minimum is the lower end of the curve
+def start_pwm(coeffs):
+  return min(range(RC_THR_OFF, RC_THR_MAX + 1), key = lambda pwm: polyval(coeffs, pwm) )
+
+# Pulse width where the fitted thrust reaches thrust (the curve must rise)
+def invert(coeffs, thrust, start):
+  lo, hi = float(start), float(RC_THR_MAX)
+  for i in range(40):
+    mid = (lo + hi) / 2.0
+    if polyval(coeffs, mid) < thrust:
+      lo = mid
+    else:
+      hi = mid
+  return (lo + hi) / 2.0
+
+def check_monotonic(motor, coeffs, start):
+  last = polyval(coeffs, start)
+  for pwm in range(start + 1, RC_THR_MAX + 1):
+    cur = polyval(coeffs, pwm)
+    if cur < last:
+      sys.exit("Fit of motor %d falls at %d us: Use a lower degree or more data" % (motor, pwm) )
+    last = cur
+
+def make_table(data, degree):
+  fits, starts = {}, {}
+  for motor in range(MOTOR_CNT):
+    if motor not in data:
+      sys.exit("No data for motor %d" % motor)
+    fits[motor]   = polyfit(data[motor], degree)
+    starts[motor] = start_pwm(fits[motor])
+    check_monotonic(motor, fits[motor], starts[motor])
+
+  # Zero thrust is where the motor starts; The same maximum for all motors, so equal outputs give equal thrust
+  thr_max = min(polyval(fits[m], RC_THR_MAX) for m in range(MOTOR_CNT) )
+  table = []
+  for motor in range(MOTOR_CNT):
+    row = []
+    for i in range(LUT_SEGS + 1):
+      thrust = thr_max * i / float(LUT_SEGS)
+      row.append(int(round(invert(fits[motor], thrust, starts[motor]) ) ) )
+    table.append(row)
+  return fits, thr_max, table
+
+def write_header(path, table):
+  lines = []
+  lines.append('#ifndef THRUSTLUT_h')
+  lines.append('#define THRUSTLUT_h')
+  lines.append('')
+  lines.append('#include <stdint.h>')
+  lines.append('')
+  lines.append('#include "config.h"')
+  lines.append('')
+  lines.append('')
+  lines.append('///////////////////////////////////////////////////////////')
+  lines.append('// Generated by misc/thrust_stand/ThrustFit.py')
+  lines.append('// Pulse width (us) of each motor for equally spaced thrust steps,')
+  lines.append('// from zero thrust to the highest thrust all motors can produce.')
+  lines.append('// Rows are indexed by the output channel (MOTOR_FR, MOTOR_BL, ..).')
+  lines.append('///////////////////////////////////////////////////////////')
+  lines.append('#define THRUST_LUT_SEGS      %d' % LUT_SEGS)
+  lines.append('')
+  lines.append('static const uint16_t THRUST_LUT[MOTOR_CNT][THRUST_LUT_SEGS + 1] = {')
+  for motor, row in enumerate(table):
+    sep = ',' if motor < len(table) - 1 else ' '
+    lines.append('  { %s }%s // %s' % (', '.join('%d' % v for v in row), sep, MOTOR_NAMES[motor]) )
+  lines.append('};')
+  lines.append('')
+  lines.append('#endif /*THRUSTLUT_h*/')
+  open(path, 'w').write('\n'.join(lines) + '\n')
+
+if __name__ == '__main__':
+  if len(sys.argv) < 2:
+    sys.exit("Usage: python ThrustFit.py <data.csv> [degree] [thrustlut.h]")
+  degree = int(sys.argv[2]) if len(sys.argv) > 2 else 2
+  out    = sys.argv[3] if len(sys.argv) > 3 else 'thrustlut.h'
+
+  fits, thr_max, table = make_table(read_csv(sys.argv[1]), degree)
+  for motor in range(MOTOR_CNT):
+    print("%s: %s" % (MOTOR_NAMES[motor], ', '.join('%.2f' % c for c in fits[motor]) ) )
+  print("Common maximum thrust: %.1f g" % thr_max)
+  write_header(out, table)
+  print("Written to %s" % out)